@@ -7,7 +7,10 @@
 #ifndef FMNA_H_
 #define FMNA_H_
 
+#include <zephyr/bluetooth/bluetooth.h>
 #include <zephyr/bluetooth/conn.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/slist.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -354,6 +357,263 @@ int fmna_paired_adv_enable(void);
  */
 int fmna_paired_adv_disable(void);
 
+/** Find My advertising policy profiles. */
+enum fmna_adv_policy_profile {
+	/** Use the advertising intervals and TX power defined by the Find My
+	 *  specification.
+	 */
+	FMNA_ADV_POLICY_PROFILE_DEFAULT,
+
+	/** Lower the TX power on low battery. With the
+	 *  @kconfig{CONFIG_FMNA_ADV_POLICY_PAIRED_INTERVAL_EXTENDED} Kconfig
+	 *  option, also extend the paired advertising interval on low battery
+	 *  or when the owner has not connected for a long time.
+	 */
+	FMNA_ADV_POLICY_PROFILE_BALANCED,
+
+	/** Always use the minimal TX power and, with the
+	 *  @kconfig{CONFIG_FMNA_ADV_POLICY_PAIRED_INTERVAL_EXTENDED} Kconfig
+	 *  option, the extended paired advertising interval.
+	 */
+	FMNA_ADV_POLICY_PROFILE_LOW_POWER,
+};
+
+/** @brief Set the Find My advertising policy profile.
+ *
+ *  This function selects the policy that the FMN stack uses to choose the
+ *  advertising interval and TX power. The policy takes the accessory state,
+ *  the battery state (see the @ref fmna_battery_level_set API), the motion
+ *  activity reported by the motion detector and the time since the last
+ *  owner connection as its inputs. The selected values never exceed the
+ *  bounds configured with the @kconfig{CONFIG_FMNA_ADV_POLICY_PAIRED_INTERVAL_MAX}
+ *  and @kconfig{CONFIG_FMNA_ADV_POLICY_TX_POWER_MIN} Kconfig options. The
+ *  paired advertising interval only exceeds the specification value if the
+ *  experimental @kconfig{CONFIG_FMNA_ADV_POLICY_PAIRED_INTERVAL_EXTENDED}
+ *  Kconfig option is enabled. The TX power is only lowered if the
+ *  @kconfig{CONFIG_FMNA_TX_POWER} Kconfig option is configured above the
+ *  minimal TX power.
+ *
+ *  The profile used after boot is selected with the
+ *  @kconfig{CONFIG_FMNA_ADV_POLICY_PROFILE} Kconfig choice. The ongoing
+ *  advertising is updated if the new profile changes its parameters.
+ *
+ *  @param profile Advertising policy profile.
+ *
+ *  @return Zero on success, otherwise a negative error code.
+ */
+int fmna_adv_policy_profile_set(enum fmna_adv_policy_profile profile);
+
+/** @brief Get the Find My advertising policy profile.
+ *
+ *  @return Currently used advertising policy profile.
+ */
+enum fmna_adv_policy_profile fmna_adv_policy_profile_get(void);
+
+/** Time spent by the advertising set with the given advertising interval. */
+struct fmna_adv_arbiter_interval_time {
+	/** Advertising interval in 0.625 ms units. */
+	uint32_t interval;
+
+	/** Time in milliseconds. */
+	uint64_t time_ms;
+};
+
+/** @brief Advertising statistics of the advertising set.
+ *
+ *  The statistics are estimated from the advertising interval, the
+ *  advertising data length and the charge model configured with the
+ *  @kconfig{CONFIG_FMNA_ADV_ARBITER_EVENT_CHARGE} and
+ *  @kconfig{CONFIG_FMNA_ADV_ARBITER_TX_CURRENT} Kconfig options.
+ */
+struct fmna_adv_arbiter_stats {
+	/** Time in milliseconds since the registration or the last reset. */
+	uint64_t time_ms;
+
+	/** Number of advertising events. */
+	uint64_t events;
+
+	/** On-air time of the advertising events in microseconds. */
+	uint64_t airtime_us;
+
+	/** Charge used by the advertising events in picocoulombs. */
+	uint64_t charge_pc;
+
+	/** Number of advertising set starts. */
+	uint32_t starts;
+
+	/** Average number of advertising set starts per hour. */
+	uint32_t starts_per_hour;
+
+	/** Average charge used per day in nAh. */
+	uint32_t charge_nah_per_day;
+
+	/** Time spent with each advertising interval, in the order of first use. */
+	struct fmna_adv_arbiter_interval_time
+		intervals[CONFIG_FMNA_ADV_ARBITER_STATS_INTERVAL_NUM];
+
+	/** Time in milliseconds spent with intervals not tracked in the intervals array. */
+	uint64_t other_interval_time_ms;
+};
+
+/** @brief Advertising set managed by the advertising arbiter.
+ *
+ *  The advertising arbiter coordinates all extended advertising sets of
+ *  the application, including the Find My advertising set. It enables
+ *  the registered sets in the priority order, limits the number of
+ *  concurrently enabled sets to the
+ *  @kconfig{CONFIG_FMNA_ADV_ARBITER_SET_MAX} Kconfig option and keeps the
+ *  total advertising airtime within the
+ *  @kconfig{CONFIG_FMNA_ADV_ARBITER_AIRTIME_BUDGET} Kconfig option. Sets
+ *  that do not fit into these limits are suspended until the resources
+ *  are released by other sets.
+ *
+ *  The Find My advertising set is registered with the priority equal to
+ *  zero and always takes precedence over the application sets. Sets with
+ *  this priority are exempt from the total airtime budget, but their
+ *  airtime is charged against it. During the paired address rotation, two
+ *  Find My sets are briefly enabled at the same time.
+ */
+struct fmna_adv_arbiter_set {
+	/** Name of the advertising set used in logs. */
+	const char *name;
+
+	/** Priority of the advertising set. Lower value means higher priority. */
+	uint8_t priority;
+
+	/** Maximum airtime of the advertising set in per mille of the radio
+	 *  time. The arbiter extends the advertising interval within the range
+	 *  from the advertising parameters to meet this budget. Set to zero
+	 *  to disable the per-set limit.
+	 */
+	uint16_t airtime_budget;
+
+	/** Internal fields, must not be modified by the user. */
+	sys_snode_t node;
+	atomic_t flags;
+	struct bt_le_ext_adv *adv;
+	struct bt_le_adv_param param;
+	uint32_t event_airtime_us;
+	uint32_t interval;
+	uint32_t interval_next;
+	uint16_t timeout;
+	bool is_admitted;
+	struct {
+		struct fmna_adv_arbiter_stats data;
+		int64_t reset_time;
+		int64_t segment_start;
+		bool is_counting;
+	} stats;
+};
+
+/** Advertising arbiter start parameters. */
+struct fmna_adv_arbiter_start_param {
+	/** Parameters used to create the advertising set. The interval range
+	 *  defines the advertising intervals accepted by the set owner. The
+	 *  arbiter updates the set parameters only if the range allows more
+	 *  than one interval value, so sets that use a custom random address
+	 *  should use a fixed interval.
+	 */
+	const struct bt_le_adv_param *param;
+
+	/** Advertising timeout in 10 ms units. Set to zero to disable the timeout. */
+	uint16_t timeout;
+
+	/** Estimated on-air time of a single advertising event in microseconds.
+	 *  Use the @ref fmna_adv_arbiter_event_airtime_estimate function to
+	 *  calculate this value.
+	 */
+	uint32_t event_airtime_us;
+};
+
+/** @brief Estimate the on-air time of a single advertising event.
+ *
+ *  The estimate assumes the legacy advertising PDU sent on all three
+ *  primary advertising channels using the LE 1M PHY.
+ *
+ *  @param ad Advertising data.
+ *  @param ad_len Number of elements in the advertising data.
+ *
+ *  @return Estimated on-air time in microseconds.
+ */
+uint32_t fmna_adv_arbiter_event_airtime_estimate(const struct bt_data *ad, size_t ad_len);
+
+/** @brief Register an advertising set in the advertising arbiter.
+ *
+ *  @param set Advertising set descriptor. The descriptor must stay valid
+ *             for the application lifetime.
+ *
+ *  @return Zero on success or negative error code otherwise.
+ *          -EALREADY if the set is already registered.
+ */
+int fmna_adv_arbiter_register(struct fmna_adv_arbiter_set *set);
+
+/** @brief Request the advertising arbiter to enable an advertising set.
+ *
+ *  The advertising set must be created and configured with advertising data
+ *  by the caller. The arbiter enables the set immediately if the controller
+ *  resources and the airtime budget allow it. Otherwise, the set is enabled
+ *  once the resources are released by other sets. Calling this function for
+ *  an already requested set restarts it only if the arbitrated advertising
+ *  interval changes due to the new interval range. This allows updating the
+ *  advertising data and the interval range of an enabled set in place. The
+ *  timeout of an already requested set is not changed.
+ *
+ *  @param set Registered advertising set descriptor.
+ *  @param adv Advertising set object.
+ *  @param start_param Start parameters.
+ *
+ *  @return Zero on success or negative error code otherwise.
+ */
+int fmna_adv_arbiter_start(struct fmna_adv_arbiter_set *set, struct bt_le_ext_adv *adv,
+			   const struct fmna_adv_arbiter_start_param *start_param);
+
+/** @brief Request the advertising arbiter to disable an advertising set.
+ *
+ *  The set is disabled before this function returns, so it can be deleted
+ *  or reconfigured by the caller afterwards.
+ *
+ *  @param set Registered advertising set descriptor.
+ *
+ *  @return Zero on success or negative error code otherwise.
+ */
+int fmna_adv_arbiter_stop(struct fmna_adv_arbiter_set *set);
+
+/** @brief Notify the advertising arbiter that the controller disabled the set.
+ *
+ *  Call this function from the @ref bt_le_ext_adv_cb callbacks when the
+ *  advertising set is disabled by the controller, e.g. once a connection
+ *  is established or the advertising timeout expires.
+ *
+ *  @param set Registered advertising set descriptor.
+ */
+void fmna_adv_arbiter_set_terminated(struct fmna_adv_arbiter_set *set);
+
+/** @brief Check if the advertising set is enabled by the advertising arbiter.
+ *
+ *  @param set Registered advertising set descriptor.
+ *
+ *  @return true if the set is enabled, false if it is disabled or suspended.
+ */
+bool fmna_adv_arbiter_is_running(const struct fmna_adv_arbiter_set *set);
+
+/** @brief Get the advertising statistics of the advertising set.
+ *
+ *  @param set Registered advertising set descriptor.
+ *  @param stats Statistics of the advertising set.
+ *
+ *  @return Zero on success or negative error code otherwise.
+ */
+int fmna_adv_arbiter_stats_get(const struct fmna_adv_arbiter_set *set,
+			       struct fmna_adv_arbiter_stats *stats);
+
+/** @brief Reset the advertising statistics of the advertising set.
+ *
+ *  @param set Registered advertising set descriptor.
+ *
+ *  @return Zero on success or negative error code otherwise.
+ */
+int fmna_adv_arbiter_stats_reset(struct fmna_adv_arbiter_set *set);
+
 /** @brief Cancel the pairing mode.
  *
  *  This function instructs the Find My stack to cancel the pairing mode
@@ -417,6 +677,10 @@ int fmna_pairing_mode_cancel(void);
  *  Such a timeout is indicated by the @ref pairing_mode_exited callback from
  *  the @ref fmna_info_cb structure.
  *
+ *  With the @kconfig{CONFIG_FMNA_PAIRING_MODE_ADV_BACKOFF} Kconfig option
+ *  enabled, calling this function in the pairing mode (e.g. on a button press)
+ *  restarts the fast stage of the pairing mode advertising.
+ *
  *  The pairing mode management APIs provide a mechanism for disabling
  *  the pairing mode on "pair before use" accessories. Such devices require
  *  the pairing mode to be cancelled when connected to a Bluetooth peer
@@ -441,15 +705,17 @@ int fmna_pairing_mode_enter(void);
  *  The Bluetooth identity must be set before calling the @ref fmna_enable API.
  *  It is assumed that Bluetooth identity used for the FMN stack is used only
  *  by the FMN stack and is not shared with other Bluetooth subsystems as
- *  the FMN stack periodically resets the Bluetooth identity using the
- *  @ref bt_id_reset to rotate its advertising MAC address and satisfy
- *  requirements from the FMN specification. The identity is owned by the FMN
- *  stack after the first @ref fmna_enable call (reboots do not reset the count)
- *  and remains in this state until the @ref fmna_factory_reset operation is
- *  performed. When the FMN stack does not own the identity, it can be used
- *  by other Bluetooth subsystems. Passing ownership to the FMN stack deletes
- *  all Bluetooth identity information (for example, Bluetooth bonds) of its
- *  previous owner.
+ *  the FMN stack resets the Bluetooth identity using the @ref bt_id_reset
+ *  to rotate its advertising MAC address and satisfy requirements from the
+ *  FMN specification. In the paired state, the identity is only reset if the
+ *  CONFIG_FMNA_ADV_SET_RANDOM_ADDR Kconfig option is disabled. Otherwise, the
+ *  rotating address is applied to the FMN advertising set. The identity is
+ *  owned by the FMN stack after the first @ref fmna_enable call (reboots do
+ *  not reset the count) and remains in this state until the
+ *  @ref fmna_factory_reset operation is performed. When the FMN stack does
+ *  not own the identity, it can be used by other Bluetooth subsystems.
+ *  Passing ownership to the FMN stack deletes all Bluetooth identity
+ *  information (for example, Bluetooth bonds) of its previous owner.
  *
  *  The BT_ID_DEFAULT identity for FMN is not available because it cannot be
  *  combined with @ref bt_id_reset function used in the FMN stack.
@@ -43,6 +43,8 @@ BUILD_ASSERT(BT_ID_COUNT == CONFIG_BT_ID_MAX, "BT identities misconfigured");
 
 #define HR_SENSOR_PAIRING_BUTTON      DK_BTN3_MSK
 
+#define HR_SENSOR_ADV_ARBITER_PRIORITY 1
+
 #define HR_SENSOR_DEVICE_NAME "HR Sensor"
 #define HR_SENSOR_FMNA_DEVICE_NAME \
 	HR_SENSOR_DEVICE_NAME FMNA_DEVICE_NAME_SUFFIX
@@ -68,6 +70,10 @@ static struct bt_data hr_sensor_sd[] = {
 	BT_DATA(BT_DATA_NAME_COMPLETE, HR_SENSOR_DEVICE_NAME, sizeof(HR_SENSOR_DEVICE_NAME) - 1)
 };
 static struct bt_le_ext_adv *hr_sensor_adv_set;
+static struct fmna_adv_arbiter_set hr_sensor_adv_arbiter_set = {
+	.name = "HR sensor",
+	.priority = HR_SENSOR_ADV_ARBITER_PRIORITY,
+};
 static bool hr_sensor_pairing_mode;
 static struct bt_conn *hr_sensor_conn;
 
@@ -471,13 +477,34 @@ static int dk_library_initialize(void)
 	return 0;
 }
 
+static void hr_sensor_adv_connected(struct bt_le_ext_adv *adv,
+				    struct bt_le_ext_adv_connected_info *info)
+{
+	fmna_adv_arbiter_set_terminated(&hr_sensor_adv_arbiter_set);
+}
+
 static int hr_sensor_advertising_start(void)
 {
 	int err;
-	struct bt_le_ext_adv_start_param ext_adv_start_param = {0};
 	struct bt_le_adv_param param = {0};
+	struct fmna_adv_arbiter_start_param start_param = {0};
+	static const struct bt_le_ext_adv_cb hr_sensor_adv_cb = {
+		.connected = hr_sensor_adv_connected,
+	};
+
+	err = fmna_adv_arbiter_register(&hr_sensor_adv_arbiter_set);
+	if (err && (err != -EALREADY)) {
+		printk("fmna_adv_arbiter_register returned error: %d\n", err);
+		return err;
+	}
 
 	if (hr_sensor_adv_set) {
+		err = fmna_adv_arbiter_stop(&hr_sensor_adv_arbiter_set);
+		if (err) {
+			printk("fmna_adv_arbiter_stop returned error: %d\n", err);
+			return err;
+		}
+
 		err = bt_le_ext_adv_delete(hr_sensor_adv_set);
 		if (err) {
 			printk("bt_le_ext_adv_delete returned error: %d\n", err);
@@ -490,7 +517,7 @@ static int hr_sensor_advertising_start(void)
 	param.options      = BT_LE_ADV_OPT_CONN;
 	param.interval_min = BT_GAP_ADV_FAST_INT_MIN_2;
 	param.interval_max = BT_GAP_ADV_FAST_INT_MAX_2;
-	err = bt_le_ext_adv_create(&param, NULL, &hr_sensor_adv_set);
+	err = bt_le_ext_adv_create(&param, &hr_sensor_adv_cb, &hr_sensor_adv_set);
 	if (err) {
 		printk("Could not create HR sensor advertising set (err %d)\n", err);
 		return err;
@@ -503,7 +530,11 @@ static int hr_sensor_advertising_start(void)
 		return err;
 	}
 
-	err = bt_le_ext_adv_start(hr_sensor_adv_set, &ext_adv_start_param);
+	start_param.param = &param;
+	start_param.event_airtime_us =
+		fmna_adv_arbiter_event_airtime_estimate(hr_sensor_ad, ARRAY_SIZE(hr_sensor_ad));
+
+	err = fmna_adv_arbiter_start(&hr_sensor_adv_arbiter_set, hr_sensor_adv_set, &start_param);
 	if (err) {
 		printk("Advertising for HR sensor set failed to start (err %d)\n", err);
 		return err;
@@ -14,12 +14,21 @@
 
 #include <zephyr/mgmt/mcumgr/transport/smp_bt.h>
 
+#include <fmna.h>
+
 #include "app_dfu_bt_adv.h"
 
 #include <zephyr/logging/log.h>
 LOG_MODULE_DECLARE(dfu, LOG_LEVEL_INF);
 
+/* DFU advertising set priority in the advertising arbiter. */
+#define DFU_ADV_ARBITER_PRIORITY (2)
+
 static struct bt_le_ext_adv *dfu_adv_set;
+static struct fmna_adv_arbiter_set dfu_adv_arbiter_set = {
+	.name = "DFU",
+	.priority = DFU_ADV_ARBITER_PRIORITY,
+};
 
 static const struct bt_data dfu_ad[] = {
 	BT_DATA_BYTES(BT_DATA_FLAGS, (BT_LE_AD_GENERAL | BT_LE_AD_NO_BREDR)),
@@ -47,6 +56,8 @@ static void adv_connected(struct bt_le_ext_adv *adv, struct bt_le_ext_adv_connec
 {
 	__ASSERT_NO_MSG(!dfu_conn);
 
+	fmna_adv_arbiter_set_terminated(&dfu_adv_arbiter_set);
+
 	LOG_INF("DFU: Connected");
 
 	dfu_conn = info->conn;
@@ -83,9 +94,13 @@ static int dfu_adv_set_setup(void)
 static int dfu_adv_enable(void)
 {
 	int err;
-	struct bt_le_ext_adv_start_param ext_adv_start_param = {0};
+	struct fmna_adv_arbiter_start_param start_param = {
+		.param = &dfu_adv_param,
+		.event_airtime_us = fmna_adv_arbiter_event_airtime_estimate(dfu_ad,
+									    ARRAY_SIZE(dfu_ad)),
+	};
 
-	err = bt_le_ext_adv_start(dfu_adv_set, &ext_adv_start_param);
+	err = fmna_adv_arbiter_start(&dfu_adv_arbiter_set, dfu_adv_set, &start_param);
 	if (err) {
 		LOG_ERR("DFU: Advertising set failed to start (err %d)", err);
 		return err;
@@ -100,7 +115,7 @@ static int dfu_adv_disable(void)
 {
 	int err;
 
-	err = bt_le_ext_adv_stop(dfu_adv_set);
+	err = fmna_adv_arbiter_stop(&dfu_adv_arbiter_set);
 	if (err) {
 		LOG_ERR("DFU: Cannot stop advertising (err: %d)", err);
 		return err;
@@ -199,6 +214,12 @@ int app_dfu_bt_adv_init(void)
 {
 	int err;
 
+	err = fmna_adv_arbiter_register(&dfu_adv_arbiter_set);
+	if (err && (err != -EALREADY)) {
+		LOG_ERR("DFU: fmna_adv_arbiter_register failed (err %d)", err);
+		return err;
+	}
+
 	err = dfu_adv_set_setup();
 	if (err) {
 		LOG_ERR("DFU: dfu_adv_set_setup failed (err %d)", err);
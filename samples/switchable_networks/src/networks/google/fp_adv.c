@@ -16,6 +16,8 @@
 #include <bluetooth/services/fast_pair/fast_pair.h>
 #include <bluetooth/services/fast_pair/fmdn.h>
 
+#include <fmna.h>
+
 #include "app_fp_adv.h"
 
 #include <zephyr/logging/log.h>
@@ -23,6 +25,11 @@ LOG_MODULE_DECLARE(google, LOG_LEVEL_INF);
 
 /* Fast Pair advertising interval 100ms. */
 #define FP_ADV_INTERVAL (0x00A0)
+/* Longest Fast Pair advertising interval in the not discoverable mode 250ms. */
+#define FP_ADV_INTERVAL_NOT_DISCOVERABLE_MAX (0x0190)
+
+/* Fast Pair advertising set priority in the advertising arbiter. */
+#define FP_ADV_ARBITER_PRIORITY (1)
 
 /* Rotation period configuration for Fast Pair advertitising. */
 #define FP_RPA_SEC_PER_MIN		(60U)
@@ -31,6 +38,16 @@ LOG_MODULE_DECLARE(google, LOG_LEVEL_INF);
 
 #define BITS_PER_VAR(_var)	(__CHAR_BIT__ * sizeof(_var))
 
+/* Maximum number of advertising data elements cached for AD and SD each. */
+#define FP_ADV_DATA_CACHE_CNT_MAX	(8)
+
+/* Copy of the advertising data pushed to the advertising set. */
+struct fp_adv_data_cache {
+	size_t cnt;
+	struct bt_data data[FP_ADV_DATA_CACHE_CNT_MAX];
+	uint8_t buf[FP_ADV_DATA_CACHE_CNT_MAX][BT_GAP_ADV_MAX_ADV_DATA_LEN];
+};
+
 static bool is_initialized;
 static bool is_enabled;
 
@@ -40,6 +57,13 @@ static const struct app_fp_adv_cb *registered_cb;
 
 static struct bt_conn *fp_conn;
 static struct bt_le_ext_adv *fp_adv_set;
+static struct fmna_adv_arbiter_set fp_adv_arbiter_set = {
+	.name = "Fast Pair",
+	.priority = FP_ADV_ARBITER_PRIORITY,
+};
+static uint32_t fp_adv_event_airtime_us;
+static struct fp_adv_data_cache fp_adv_ad_cache;
+static struct fp_adv_data_cache fp_adv_sd_cache;
 static bool fp_adv_rpa_rotation_suspended;
 static enum app_fp_adv_mode fp_adv_mode = APP_FP_ADV_MODE_OFF;
 static uint32_t fp_adv_request_bm;
@@ -131,8 +155,59 @@ static void fp_adv_prov_configure(enum app_fp_adv_mode fp_adv_mode)
 	};
 }
 
+static void fp_adv_data_cache_invalidate(void)
+{
+	fp_adv_ad_cache.cnt = 0;
+	fp_adv_sd_cache.cnt = 0;
+}
+
+static int fp_adv_data_cache_update(struct fp_adv_data_cache *cache,
+				    const struct bt_data *data, size_t cnt, bool *changed)
+{
+	bool is_changed = (cache->cnt != cnt);
+
+	if (cnt > ARRAY_SIZE(cache->data)) {
+		LOG_ERR("Fast Pair: too many advertising data elements: %zu", cnt);
+		return -ENOMEM;
+	}
+
+	for (size_t i = 0; i < cnt; i++) {
+		struct bt_data *entry = &cache->data[i];
+
+		if (data[i].data_len > sizeof(cache->buf[i])) {
+			LOG_ERR("Fast Pair: advertising data element too long: %u",
+				data[i].data_len);
+			return -ENOMEM;
+		}
+
+		/* Compare each provider output with its cached copy. */
+		if ((i < cache->cnt) &&
+		    (entry->type == data[i].type) &&
+		    (entry->data_len == data[i].data_len) &&
+		    !memcmp(cache->buf[i], data[i].data, data[i].data_len)) {
+			continue;
+		}
+
+		LOG_DBG("Fast Pair: advertising data element %zu (type 0x%02x) changed",
+			i, data[i].type);
+
+		memcpy(cache->buf[i], data[i].data, data[i].data_len);
+		entry->type = data[i].type;
+		entry->data_len = data[i].data_len;
+		entry->data = cache->buf[i];
+
+		is_changed = true;
+	}
+
+	cache->cnt = cnt;
+	*changed = *changed || is_changed;
+
+	return 0;
+}
+
 static int fp_adv_payload_set(bool rpa_rotated, bool new_session)
 {
+	bool changed = false;
 	int err;
 	uint8_t adv_handle;
 	struct bt_le_adv_prov_adv_state state = {0};
@@ -168,9 +243,30 @@ static int fp_adv_payload_set(bool rpa_rotated, bool new_session)
 		return err;
 	}
 
-	err = bt_le_ext_adv_set_data(fp_adv_set, ad, ad_len, sd, sd_len);
+	err = fp_adv_data_cache_update(&fp_adv_ad_cache, ad, ad_len, &changed);
+	if (!err) {
+		err = fp_adv_data_cache_update(&fp_adv_sd_cache, sd, sd_len, &changed);
+	}
+	if (err) {
+		fp_adv_data_cache_invalidate();
+		return err;
+	}
+
+	if (!changed) {
+		LOG_DBG("Fast Pair: advertising payload unchanged");
+		return 0;
+	}
+
+	fp_adv_event_airtime_us = fmna_adv_arbiter_event_airtime_estimate(fp_adv_ad_cache.data,
+									  fp_adv_ad_cache.cnt);
+
+	/* The advertising data of the enabled set is updated in place. */
+	err = bt_le_ext_adv_set_data(fp_adv_set,
+				     fp_adv_ad_cache.data, fp_adv_ad_cache.cnt,
+				     fp_adv_sd_cache.data, fp_adv_sd_cache.cnt);
 	if (err) {
 		LOG_ERR("Fast Pair: bt_le_ext_adv_set_data returned error: %d", err);
+		fp_adv_data_cache_invalidate();
 		return err;
 	}
 
@@ -180,27 +276,40 @@ static int fp_adv_payload_set(bool rpa_rotated, bool new_session)
 static int bt_stack_advertising_update(void)
 {
 	int err;
-	struct bt_le_ext_adv_start_param ext_adv_start_param = {0};
-
-	err = bt_le_ext_adv_stop(fp_adv_set);
-	if (err) {
-		LOG_ERR("Fast Pair: cannot stop advertising (err: %d)", err);
-		return err;
-	}
+	struct bt_le_adv_param param = fp_adv_param;
+	struct fmna_adv_arbiter_start_param start_param = {
+		.param = &param,
+	};
 
 	if (fp_adv_mode == APP_FP_ADV_MODE_OFF) {
+		err = fmna_adv_arbiter_stop(&fp_adv_arbiter_set);
+		if (err) {
+			LOG_ERR("Fast Pair: cannot stop advertising (err: %d)", err);
+			return err;
+		}
+
 		return 0;
 	}
 
+	/* Every start is a new advertising session for the payload providers. The
+	 * payload is pushed to the advertising set only if it has changed.
+	 */
 	err = fp_adv_payload_set(false, true);
 	if (err) {
 		LOG_ERR("Fast Pair: cannot set advertising payload (err: %d)", err);
 		return err;
 	}
 
-	err = bt_le_ext_adv_start(fp_adv_set, &ext_adv_start_param);
+	/* Allow the arbiter to slow down the advertising within the specification limits. */
+	if (fp_adv_mode == APP_FP_ADV_MODE_NOT_DISCOVERABLE) {
+		param.interval_max = FP_ADV_INTERVAL_NOT_DISCOVERABLE_MAX;
+	}
+
+	start_param.event_airtime_us = fp_adv_event_airtime_us;
+
+	err = fmna_adv_arbiter_start(&fp_adv_arbiter_set, fp_adv_set, &start_param);
 	if (err) {
-		LOG_ERR("Fast Pair: bt_le_ext_adv_start returned error: %d", err);
+		LOG_ERR("Fast Pair: fmna_adv_arbiter_start returned error: %d", err);
 		return err;
 	}
 
@@ -254,6 +363,8 @@ extern int app_network_selector_set(enum app_network_selector network);
 extern uint32_t current_network_id_get();
 static void fp_adv_connected(struct bt_le_ext_adv *adv, struct bt_le_ext_adv_connected_info *info)
 {
+	fmna_adv_arbiter_set_terminated(&fp_adv_arbiter_set);
+
 	LOG_INF("google_adv_connected###");
 	if(0 == current_network_id_get())
 	{
@@ -357,7 +468,7 @@ int google_adv_stop(void)
 
 	//__ASSERT(fp_adv_set, "Fast Pair: invalid state of the advertising set");
 	LOG_INF("google_adv_stop######");
-	err = bt_le_ext_adv_stop(fp_adv_set);
+	err = fmna_adv_arbiter_stop(&fp_adv_arbiter_set);
 	if (err) {
 		LOG_ERR("Fast Pair: cannot stop advertising (err: %d)", err);
 		return err;
@@ -370,6 +481,7 @@ int google_adv_stop(void)
 	}
 
 	fp_adv_set = NULL;
+	fp_adv_data_cache_invalidate();
 	
 
 	return 0;
@@ -387,6 +499,7 @@ static int fp_adv_set_teardown(void)
 	}
 
 	fp_adv_set = NULL;
+	fp_adv_data_cache_invalidate();
 
 	return 0;
 }
@@ -601,6 +714,12 @@ int app_fp_adv_init(const struct app_fp_adv_cb *cb)
 
 	registered_cb = cb;
 
+	err = fmna_adv_arbiter_register(&fp_adv_arbiter_set);
+	if (err && (err != -EALREADY)) {
+		LOG_ERR("Fast Pair: fmna_adv_arbiter_register returned error: %d", err);
+		return err;
+	}
+
 	err = bt_fast_pair_fmdn_info_cb_register(&fmdn_info_cb);
 	if (err) {
 		LOG_ERR("Fast Pair: bt_fast_pair_fmdn_info_cb_register returned error: %d", err);
@@ -17,8 +17,10 @@ extern "C" {
 	_name->conn = _conn;
 
 enum fmna_event_id {
+	FMNA_EVENT_ADV_POLICY_CHANGED,
 	FMNA_EVENT_BATTERY_LEVEL_CHANGED,
 	FMNA_EVENT_MAX_CONN_CHANGED,
+	FMNA_EVENT_NFC_FIELD_DETECTED,
 	FMNA_EVENT_OWNER_CONNECTED,
 	FMNA_EVENT_PEER_CONNECTED,
 	FMNA_EVENT_PEER_DISCONNECTED,
@@ -5,8 +5,9 @@
 extern "C" {
 #endif
 
+#include <zephyr/net_buf.h>
+
 #include "app_event_manager.h"
-#include "fmna_gatt_pkt_manager.h"
 
 enum fmna_pair_event_id {
 	FMNA_PAIR_EVENT_INITIATE_PAIRING,
@@ -14,17 +15,16 @@ enum fmna_pair_event_id {
 	FMNA_PAIR_EVENT_PAIRING_COMPLETE,
 };
 
-struct fmna_pair_buf {
-	uint8_t data[FMNA_GATT_PKT_MAX_LEN];
-	uint16_t len;
-};
-
 struct fmna_pair_event {
 	struct app_event_header header;
 
 	enum fmna_pair_event_id id;
 	struct bt_conn *conn;
-	struct fmna_pair_buf buf;
+
+	/* Reassembled command parameters. The event holds one reference to
+	 * the buffer which must be released by the event listener.
+	 */
+	struct net_buf *buf;
 };
 
 APP_EVENT_TYPE_DECLARE(fmna_pair_event);
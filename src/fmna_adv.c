@@ -5,9 +5,13 @@
  */
 
 #include "fmna_adv.h"
+#include "fmna_adv_arbiter.h"
+#include "fmna_adv_policy.h"
 #include "fmna_battery.h"
 #include "fmna_product_plan.h"
 
+#include <fmna.h>
+
 #include <zephyr/bluetooth/bluetooth.h>
 #include <zephyr/bluetooth/conn.h>
 #include <zephyr/bluetooth/hci.h>
@@ -15,11 +19,16 @@
 #include <zephyr/sys/byteorder.h>
 #include <zephyr/logging/log.h>
 
+/* BLE internal header, use with caution. */
+#include <bluetooth/host/hci_core.h>
+#include <bluetooth/host/id.h>
+
 LOG_MODULE_DECLARE(fmna, CONFIG_FMNA_LOG_LEVEL);
 
-#define UNPAIRED_ADV_INTERVAL    0x0030 /* 30 ms */
-#define PAIRED_ADV_INTERVAL      0x0C80 /* 2 s */
-#define PAIRED_ADV_INTERVAL_FAST 0x0030 /* 30 ms */
+#define TX_POWER_VERIFY_ADV_INTERVAL 0x0030 /* 30 ms */
+
+/* The Find My advertising set has precedence over all other advertising sets. */
+#define ADV_ARBITER_PRIORITY 0
 
 #define BT_ADDR_LEN sizeof(((bt_addr_t *) NULL)->val)
 
@@ -92,8 +101,56 @@ enum app_network_selector {
 };
 extern int app_network_selector_set(enum app_network_selector network);
 extern uint32_t current_network_id_get();
+
+/* Advertising set together with its arbiter descriptor. */
+struct adv_slot {
+	struct bt_le_ext_adv *adv;
+	struct fmna_adv_arbiter_set arbiter_set;
+};
+
+/* The second slot is used only during the address rotation: the set with the
+ * next address is enabled before the current one is disabled and deleted.
+ */
+static struct adv_slot adv_slots[2] = {
+	{
+		.arbiter_set = {
+			.name = "Find My",
+			.priority = ADV_ARBITER_PRIORITY,
+		},
+	},
+	{
+		.arbiter_set = {
+			.name = "Find My",
+			.priority = ADV_ARBITER_PRIORITY,
+		},
+	},
+};
+static uint8_t adv_slot_active_idx;
+
+static struct adv_slot *adv_slot_active_get(void)
+{
+	return &adv_slots[adv_slot_active_idx];
+}
+
+static struct adv_slot *adv_slot_next_get(void)
+{
+	return &adv_slots[adv_slot_active_idx ^ 1];
+}
+
+static void adv_slot_terminated(const struct bt_le_ext_adv *adv)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(adv_slots); i++) {
+		if (adv_slots[i].adv == adv) {
+			fmna_adv_arbiter_set_terminated(&adv_slots[i].arbiter_set);
+			return;
+		}
+	}
+}
+
 static void apple_adv_connected(struct bt_le_ext_adv *adv, struct bt_le_ext_adv_connected_info *info)
 {
+	adv_slot_terminated(adv);
+
 	LOG_INF("apple_adv_connected###");
 	if(0 == current_network_id_get())
 	{
@@ -104,22 +161,82 @@ static void apple_adv_connected(struct bt_le_ext_adv *adv, struct bt_le_ext_adv_
 static const struct bt_le_ext_adv_cb apple_adv_set_cb = {
 	.connected = apple_adv_connected,
 };
+
+static void paired_adv_connected(struct bt_le_ext_adv *adv,
+				 struct bt_le_ext_adv_connected_info *info)
+{
+	/* The controller disables the advertising set on connection. */
+	adv_slot_terminated(adv);
+}
+
+static const struct bt_le_ext_adv_cb paired_adv_set_cb = {
+	.connected = paired_adv_connected,
+};
 struct adv_start_config {
 	struct {
 		const struct bt_data *payload;
 		size_t len;
 	} ad;
 	const struct bt_le_ext_adv_cb *cb;
+	const bt_addr_le_t *addr;
 
 	uint32_t interval;
 	uint16_t timeout;
+	int8_t tx_power;
+};
+
+/* Advertising payload and address staged for the advertising set. */
+struct adv_buf {
+	union adv_payload payload;
+	bt_addr_le_t addr;
 };
 
 static uint8_t bt_id;
-static union adv_payload adv_payload;
-static struct bt_le_ext_adv *adv_set = NULL;
 
-static int bt_ext_advertising_tx_power_set(uint16_t handle, int8_t *tx_power)
+/* Double buffer: the active entry describes what the controller currently
+ * uses, the other one is encoded ahead of the next controller update.
+ */
+static struct adv_buf adv_bufs[2];
+static uint8_t adv_buf_active_idx;
+
+static struct {
+	bool is_paired;
+	uint32_t interval;
+	uint16_t timeout;
+	int8_t tx_power;
+} adv_set_info;
+
+uint64_t fmna_adv_airtime_get(void)
+{
+	uint64_t airtime_us = 0;
+	struct fmna_adv_arbiter_stats stats;
+
+	for (size_t i = 0; i < ARRAY_SIZE(adv_slots); i++) {
+		if (!fmna_adv_arbiter_stats_get(&adv_slots[i].arbiter_set, &stats)) {
+			airtime_us += stats.airtime_us;
+		}
+	}
+
+	return airtime_us;
+}
+
+static struct adv_buf *adv_buf_active_get(void)
+{
+	return &adv_bufs[adv_buf_active_idx];
+}
+
+static struct adv_buf *adv_buf_staging_get(void)
+{
+	return &adv_bufs[adv_buf_active_idx ^ 1];
+}
+
+static void adv_buf_commit(void)
+{
+	adv_buf_active_idx ^= 1;
+}
+
+static int bt_ext_advertising_tx_power_set(uint16_t handle, int8_t tx_power_level,
+					   int8_t *tx_power)
 {
 	int err;
 	struct bt_hci_cp_vs_write_tx_power_level *cp;
@@ -136,7 +253,7 @@ static int bt_ext_advertising_tx_power_set(uint16_t handle, int8_t *tx_power)
 	cp = net_buf_add(buf, sizeof(*cp));
 	cp->handle = sys_cpu_to_le16(handle);
 	cp->handle_type = BT_HCI_VS_LL_HANDLE_TYPE_ADV;
-	cp->tx_power_level = CONFIG_FMNA_TX_POWER;
+	cp->tx_power_level = tx_power_level;
 
 	err = bt_hci_cmd_send_sync(BT_HCI_OP_VS_WRITE_TX_POWER_LEVEL, buf, &rsp);
 	if (err) {
@@ -156,80 +273,290 @@ static int bt_ext_advertising_tx_power_set(uint16_t handle, int8_t *tx_power)
 	return err;
 }
 
+static int adv_slot_release(struct adv_slot *slot)
+{
+	int err;
+
+	if (!slot->adv) {
+		return 0;
+	}
+
+	err = fmna_adv_arbiter_stop(&slot->arbiter_set);
+	if (err) {
+		LOG_ERR("fmna_adv_arbiter_stop returned error: %d", err);
+		return err;
+	}
+
+	err = bt_le_ext_adv_delete(slot->adv);
+	if (err) {
+		LOG_ERR("bt_le_ext_adv_delete returned error: %d", err);
+		return err;
+	}
+
+	slot->adv = NULL;
+
+	return 0;
+}
+
 int fmna_adv_stop(void)
 {
 	int err;
 
-	if (adv_set) {
-		err = bt_le_ext_adv_stop(adv_set);
+	if (adv_slot_active_get()->adv) {
+		err = adv_slot_release(adv_slot_active_get());
 		if (err) {
-			LOG_ERR("bt_le_ext_adv_stop returned error: %d", err);
+			LOG_ERR("adv_slot_release returned error: %d", err);
 			return err;
 		}
 
-		err = bt_le_ext_adv_delete(adv_set);
-		if (err) {
-			LOG_ERR("bt_le_ext_adv_delete returned error: %d", err);
-			return err;
-		}
+		memset(&adv_set_info, 0, sizeof(adv_set_info));
+	}
+
+	return 0;
+}
 
-		adv_set = NULL;
+static int adv_set_addr_configure(struct bt_le_ext_adv *adv, const bt_addr_le_t *addr)
+{
+	int err;
+	char addr_str[BT_ADDR_LE_STR_LEN];
+
+	/* The advertising set is created but not enabled at this point, so the
+	 * controller accepts the new random address for this set only. The
+	 * Bluetooth identity and its settings entry are left untouched.
+	 */
+	err = bt_id_set_adv_random_addr(adv, &addr->a);
+	if (err) {
+		LOG_ERR("bt_id_set_adv_random_addr returned error: %d", err);
+		return err;
 	}
 
+	bt_addr_le_to_str(addr, addr_str, sizeof(addr_str));
+	LOG_INF("FMN advertising set address configured to: %s", addr_str);
+
 	return 0;
 }
 
-static int bt_ext_advertising_start(const struct adv_start_config *config)
+static int adv_arbiter_start(struct adv_slot *slot, const struct adv_start_config *config,
+			     const struct bt_le_adv_param *param)
+{
+	int err;
+	struct fmna_adv_arbiter_start_param start_param = {
+		.param = param,
+		.timeout = config->timeout,
+		.event_airtime_us = fmna_adv_arbiter_event_airtime_estimate(config->ad.payload,
+									    config->ad.len),
+	};
+
+	err = fmna_adv_arbiter_start(&slot->arbiter_set, slot->adv, &start_param);
+	if (err) {
+		LOG_ERR("fmna_adv_arbiter_start returned error: %d", err);
+		return err;
+	}
+
+	return 0;
+}
+
+static void adv_param_get(const struct adv_start_config *config, struct bt_le_adv_param *param)
+{
+	memset(param, 0, sizeof(*param));
+
+	param->id = bt_id;
+	param->options = BT_LE_ADV_OPT_CONN | BT_LE_ADV_OPT_USE_IDENTITY;
+	param->interval_min = config->interval;
+	param->interval_max = config->interval;
+}
+
+static int adv_slot_configure(struct adv_slot *slot, const struct adv_start_config *config,
+			      struct bt_le_adv_param *param)
 {
 	int err;
-	struct bt_le_adv_param param = {0};
-	struct bt_le_ext_adv_start_param ext_adv_start_param = {0};
 	uint8_t adv_handle;
 
-	if (adv_set) {
+	if (slot->adv) {
 		LOG_ERR("Advertising set is already claimed");
 		return -EAGAIN;
 	}
 
-	param.id = bt_id;
-	param.options = BT_LE_ADV_OPT_CONN | BT_LE_ADV_OPT_USE_IDENTITY;
-	param.interval_min = config->interval;
-	param.interval_max = config->interval;
-
-	ext_adv_start_param.timeout = config->timeout;
+	adv_param_get(config, param);
 
-	err = bt_le_ext_adv_create(&param, config->cb, &adv_set);
+	err = bt_le_ext_adv_create(param, config->cb, &slot->adv);
 	if (err) {
 		LOG_ERR("bt_le_ext_adv_create returned error: %d", err);
 		return err;
 	}
 
-	err = bt_le_ext_adv_set_data(adv_set, config->ad.payload, config->ad.len, NULL, 0);
+	if (config->addr) {
+		err = adv_set_addr_configure(slot->adv, config->addr);
+		if (err) {
+			LOG_ERR("adv_set_addr_configure returned error: %d", err);
+			return err;
+		}
+	}
+
+	err = bt_le_ext_adv_set_data(slot->adv, config->ad.payload, config->ad.len, NULL, 0);
 	if (err) {
 		LOG_ERR("bt_le_ext_adv_set_data returned error: %d", err);
 		return err;
 	}
 
-	err = bt_hci_get_adv_handle(adv_set, &adv_handle);
+	err = bt_hci_get_adv_handle(slot->adv, &adv_handle);
 	if (err) {
 		LOG_ERR("bt_hci_get_adv_handle returned error: %d", err);
 		return err;
 	}
 
-	err = bt_ext_advertising_tx_power_set(adv_handle, NULL);
+	err = bt_ext_advertising_tx_power_set(adv_handle, config->tx_power, NULL);
 	if (err) {
 		LOG_ERR("bt_ext_advertising_tx_power_set returned error: %d", err);
 		return err;
 	}
 
-	err = bt_le_ext_adv_start(adv_set, &ext_adv_start_param);
+	return 0;
+}
+
+static int bt_ext_advertising_start(const struct adv_start_config *config)
+{
+	int err;
+	struct bt_le_adv_param param;
+	struct adv_slot *slot = adv_slot_active_get();
+
+	err = adv_slot_configure(slot, config, &param);
+	if (err) {
+		LOG_ERR("adv_slot_configure returned error: %d", err);
+		return err;
+	}
+
+	err = adv_arbiter_start(slot, config, &param);
 	if (err) {
-		LOG_ERR("bt_le_ext_adv_start returned error: %d", err);
+		LOG_ERR("adv_arbiter_start returned error: %d", err);
 		return err;
 	}
 
+	adv_set_info.interval = config->interval;
+	adv_set_info.timeout = config->timeout;
+	adv_set_info.tx_power = config->tx_power;
+
 	return err;
 }
+
+static void adv_policy_apply(enum fmna_adv_policy_mode mode, bool fast_mode,
+			     struct adv_start_config *start_config)
+{
+	struct fmna_adv_policy_params params;
+
+	fmna_adv_policy_params_get(mode, fast_mode, &params);
+
+	start_config->interval = params.interval;
+	start_config->tx_power = params.tx_power;
+}
+
+static bool adv_set_swap_possible(const struct adv_start_config *config)
+{
+	/* Without the advertising set address, the address rotation requires
+	 * the identity reset that cannot be done with the enabled set.
+	 */
+	if (!IS_ENABLED(CONFIG_FMNA_ADV_SET_RANDOM_ADDR)) {
+		return false;
+	}
+
+	if (!adv_slot_active_get()->adv || !adv_set_info.is_paired) {
+		return false;
+	}
+
+	/* Changing advertising parameters restores the identity address. */
+	return ((adv_set_info.interval == config->interval) &&
+		(adv_set_info.timeout == config->timeout) &&
+		(adv_set_info.tx_power == config->tx_power));
+}
+
+static int adv_set_rotate(const struct adv_start_config *config)
+{
+	int err;
+	int release_err;
+	struct bt_le_adv_param param;
+	struct adv_slot *next = adv_slot_next_get();
+
+	if (CONFIG_BT_EXT_ADV_MAX_ADV_SET < ARRAY_SIZE(adv_slots)) {
+		return -ENOMEM;
+	}
+
+	/* Configure and enable the set with the next address while the current
+	 * set is still advertising, then disable the current set.
+	 */
+	err = adv_slot_configure(next, config, &param);
+	if (!err) {
+		err = adv_arbiter_start(next, config, &param);
+	}
+
+	if (!err) {
+		err = adv_slot_release(adv_slot_active_get());
+	}
+
+	if (err) {
+		release_err = adv_slot_release(next);
+		if (release_err) {
+			LOG_ERR("adv_slot_release returned error: %d", release_err);
+		}
+
+		return err;
+	}
+
+	adv_slot_active_idx ^= 1;
+
+	return 0;
+}
+
+static int adv_set_swap(const struct adv_start_config *config)
+{
+	int err;
+	struct bt_le_adv_param param;
+	struct adv_slot *slot = adv_slot_active_get();
+
+	if (config->addr) {
+		err = adv_set_rotate(config);
+		if (!err) {
+			return 0;
+		}
+
+		/* Without a free advertising set in the controller, the random
+		 * address of the connectable set can only be changed when the
+		 * set is disabled.
+		 */
+		LOG_DBG("adv_set_rotate returned error: %d", err);
+
+		err = fmna_adv_arbiter_stop(&slot->arbiter_set);
+		if (err) {
+			LOG_ERR("fmna_adv_arbiter_stop returned error: %d", err);
+			return err;
+		}
+
+		err = adv_set_addr_configure(slot->adv, config->addr);
+		if (err) {
+			LOG_ERR("adv_set_addr_configure returned error: %d", err);
+			return err;
+		}
+	}
+
+	err = bt_le_ext_adv_set_data(slot->adv, config->ad.payload, config->ad.len, NULL, 0);
+	if (err) {
+		LOG_ERR("bt_le_ext_adv_set_data returned error: %d", err);
+		return err;
+	}
+
+	/* The set is still enabled if only the payload was updated. It can
+	 * also be disabled if the previous advertising ended in a connection.
+	 */
+	adv_param_get(config, &param);
+
+	err = adv_arbiter_start(slot, config, &param);
+	if (err) {
+		LOG_ERR("adv_arbiter_start returned error: %d", err);
+		return err;
+	}
+
+	return 0;
+}
+
 extern  void factory_reset_reboot(void);
 static int id_addr_reconfigure(bt_addr_le_t *addr)
 {
@@ -270,13 +597,13 @@ static void unpaired_adv_payload_encode(struct unpaired_adv_payload *svc_payload
 
 int fmna_adv_start_unpaired(bool change_address)
 {
-	static const struct bt_data unpaired_ad[] = {
-		BT_DATA(BT_DATA_SVC_DATA16, (uint8_t *) &adv_payload,
-			sizeof(struct unpaired_adv_payload)),
-	};
-
 	int err;
+	struct adv_buf *staging = adv_buf_staging_get();
 	struct adv_start_config start_config = {0};
+	const struct bt_data unpaired_ad[] = {
+		BT_DATA(BT_DATA_SVC_DATA16, (uint8_t *) &staging->payload,
+			sizeof(struct unpaired_adv_payload)),
+	};
 
 	/* Stop any ongoing advertising. */
 	err = fmna_adv_stop();
@@ -299,11 +626,12 @@ int fmna_adv_start_unpaired(bool change_address)
 	}
 
 	/* Encode the FMN Service payload for advertising data set. */
-	unpaired_adv_payload_encode(&adv_payload.unpaired);
+	unpaired_adv_payload_encode(&staging->payload.unpaired);
+	bt_addr_le_copy(&staging->addr, BT_ADDR_LE_ANY);
 
 	start_config.ad.payload = unpaired_ad;
 	start_config.ad.len = ARRAY_SIZE(unpaired_ad);
-	start_config.interval = UNPAIRED_ADV_INTERVAL;
+	adv_policy_apply(FMNA_ADV_POLICY_MODE_UNPAIRED, false, &start_config);
 	start_config.cb = &apple_adv_set_cb;
 	err = bt_ext_advertising_start(&start_config);
 	if (err) {
@@ -311,6 +639,8 @@ int fmna_adv_start_unpaired(bool change_address)
 		return err;
 	}
 
+	adv_buf_commit();
+
 	LOG_INF("FMN advertising started for the Unpaired state");
 
 	return err;
@@ -323,6 +653,74 @@ static void paired_addr_encode(bt_addr_le_t *addr, const uint8_t pubkey[FMNA_PUB
 	BT_ADDR_SET_STATIC(&addr->a);
 }
 
+static int paired_addr_apply(bt_addr_le_t *addr, struct adv_start_config *start_config)
+{
+	int err;
+
+	if (IS_ENABLED(CONFIG_FMNA_ADV_SET_RANDOM_ADDR)) {
+		/* Use the key-derived address only for the FMN advertising set. */
+		start_config->addr = addr;
+
+		return 0;
+	}
+
+	/*
+	 * Reconfigure the BT address after coming back from the Separated
+	 * state. Each address reconfiguration changes the BLE identity and
+	 * removes BLE bonds.
+	 */
+	err = id_addr_reconfigure(addr);
+	if (err) {
+		LOG_ERR("id_addr_reconfigure returned error: %d", err);
+		return err;
+	}
+
+	return 0;
+}
+
+static int paired_adv_start(bt_addr_le_t *addr, struct adv_start_config *start_config)
+{
+	int err;
+
+	if (adv_set_swap_possible(start_config)) {
+		/* Skip the address update if the new key maps to the same address. */
+		start_config->addr = bt_addr_le_eq(addr, &adv_buf_active_get()->addr) ?
+			NULL : addr;
+
+		err = adv_set_swap(start_config);
+		if (!err) {
+			adv_buf_commit();
+			return 0;
+		}
+
+		LOG_WRN("FMN advertising swap failed, restarting the advertising set");
+	}
+
+	/* Stop any ongoing advertising. */
+	err = fmna_adv_stop();
+	if (err) {
+		LOG_ERR("fmna_adv_stop returned error: %d", err);
+		return err;
+	}
+
+	err = paired_addr_apply(addr, start_config);
+	if (err) {
+		LOG_ERR("paired_addr_apply returned error: %d", err);
+		return err;
+	}
+
+	err = bt_ext_advertising_start(start_config);
+	if (err) {
+		LOG_ERR("bt_ext_advertising_start returned error: %d", err);
+		return err;
+	}
+
+	adv_set_info.is_paired = true;
+	adv_buf_commit();
+
+	return 0;
+}
+
 static void paired_adv_header_encode(struct paired_adv_payload_header *hdr,
 				     size_t payload_len)
 {
@@ -357,43 +755,25 @@ static void nearby_adv_payload_encode(struct nearby_adv_payload *adv_payload,
 
 int fmna_adv_start_nearby(const struct fmna_adv_nearby_config *config)
 {
-	static const struct bt_data nearby_ad[] = {
-		BT_DATA(BT_DATA_MANUFACTURER_DATA, (uint8_t *) &adv_payload,
-			sizeof(struct nearby_adv_payload)),
-	};
-
 	int err;
-	bt_addr_le_t addr;
+	struct adv_buf *staging = adv_buf_staging_get();
 	struct adv_start_config start_config = {0};
+	const struct bt_data nearby_ad[] = {
+		BT_DATA(BT_DATA_MANUFACTURER_DATA, (uint8_t *) &staging->payload,
+			sizeof(struct nearby_adv_payload)),
+	};
 
-	/* Stop any ongoing advertising. */
-	err = fmna_adv_stop();
-	if (err) {
-		LOG_ERR("fmna_adv_stop returned error: %d", err);
-		return err;
-	}
-
-	nearby_adv_payload_encode(&adv_payload.nearby, config);
-
-	/*
-	 * Reconfigure the BT address after coming back from the Separated
-	 * state. Each address reconfiguration changes the BLE identity and
-	 * removes BLE bonds.
-	 */
-	paired_addr_encode(&addr, config->primary_key);
-	err = id_addr_reconfigure(&addr);
-	if (err) {
-		LOG_ERR("id_addr_reconfigure returned error: %d", err);
-		return err;
-	}
+	/* Encode the next payload and address while the current ones are still in use. */
+	nearby_adv_payload_encode(&staging->payload.nearby, config);
+	paired_addr_encode(&staging->addr, config->primary_key);
 
 	start_config.ad.payload = nearby_ad;
 	start_config.ad.len = ARRAY_SIZE(nearby_ad);
-	start_config.interval = config->fast_mode ?
-		PAIRED_ADV_INTERVAL_FAST : PAIRED_ADV_INTERVAL;
-	err = bt_ext_advertising_start(&start_config);
+	start_config.cb = &paired_adv_set_cb;
+	adv_policy_apply(FMNA_ADV_POLICY_MODE_NEARBY, config->fast_mode, &start_config);
+	err = paired_adv_start(&staging->addr, &start_config);
 	if (err) {
-		LOG_ERR("bt_ext_advertising_start returned error: %d", err);
+		LOG_ERR("paired_adv_start returned error: %d", err);
 		return err;
 	}
 
@@ -434,43 +814,25 @@ static void separated_adv_payload_encode(struct separated_adv_payload *adv_paylo
 
 int fmna_adv_start_separated(const struct fmna_adv_separated_config *config)
 {
-	static const struct bt_data separated_ad[] = {
-		BT_DATA(BT_DATA_MANUFACTURER_DATA, (uint8_t *) &adv_payload,
-			sizeof(struct separated_adv_payload)),
-	};
-
 	int err;
-	bt_addr_le_t addr;
+	struct adv_buf *staging = adv_buf_staging_get();
 	struct adv_start_config start_config = {0};
+	const struct bt_data separated_ad[] = {
+		BT_DATA(BT_DATA_MANUFACTURER_DATA, (uint8_t *) &staging->payload,
+			sizeof(struct separated_adv_payload)),
+	};
 
-	/* Stop any ongoing advertising. */
-	err = fmna_adv_stop();
-	if (err) {
-		LOG_ERR("fmna_adv_stop returned error: %d", err);
-		return err;
-	}
-
-	separated_adv_payload_encode(&adv_payload.separated, config);
-
-	/*
-	 * Reconfigure the BT address after coming back from the Separated
-	 * state. Each address reconfiguration changes the BLE identity and
-	 * removes BLE bonds.
-	 */
-	paired_addr_encode(&addr, config->separated_key);
-	err = id_addr_reconfigure(&addr);
-	if (err) {
-		LOG_ERR("id_addr_reconfigure returned error: %d", err);
-		return err;
-	}
+	/* Encode the next payload and address while the current ones are still in use. */
+	separated_adv_payload_encode(&staging->payload.separated, config);
+	paired_addr_encode(&staging->addr, config->separated_key);
 
 	start_config.ad.payload = separated_ad;
 	start_config.ad.len = ARRAY_SIZE(separated_ad);
-	start_config.interval = config->fast_mode ?
-		PAIRED_ADV_INTERVAL_FAST : PAIRED_ADV_INTERVAL;
-	err = bt_ext_advertising_start(&start_config);
+	start_config.cb = &paired_adv_set_cb;
+	adv_policy_apply(FMNA_ADV_POLICY_MODE_SEPARATED, config->fast_mode, &start_config);
+	err = paired_adv_start(&staging->addr, &start_config);
 	if (err) {
-		LOG_ERR("bt_ext_advertising_start returned error: %d", err);
+		LOG_ERR("paired_adv_start returned error: %d", err);
 		return err;
 	}
 
@@ -490,8 +852,8 @@ static int bt_ext_advertising_tx_power_verify(uint8_t id)
 	struct bt_le_adv_param param = {
 		.id = id,
 		.options = BT_LE_ADV_OPT_CONN | BT_LE_ADV_OPT_USE_IDENTITY,
-		.interval_min = UNPAIRED_ADV_INTERVAL,
-		.interval_max = UNPAIRED_ADV_INTERVAL,
+		.interval_min = TX_POWER_VERIFY_ADV_INTERVAL,
+		.interval_max = TX_POWER_VERIFY_ADV_INTERVAL,
 	};
 
 	err = bt_le_ext_adv_create(&param, NULL, &tx_adv_set);
@@ -506,7 +868,7 @@ static int bt_ext_advertising_tx_power_verify(uint8_t id)
 		goto error;
 	}
 
-	err = bt_ext_advertising_tx_power_set(adv_handle, &tx_power);
+	err = bt_ext_advertising_tx_power_set(adv_handle, CONFIG_FMNA_TX_POWER, &tx_power);
 	if (err) {
 		LOG_ERR("bt_ext_advertising_tx_power_set returned error: %d", err);
 		goto error;
@@ -553,6 +915,15 @@ int fmna_adv_init(uint8_t id)
 		return err;
 	}
 
+	/* The sets stay registered in the arbiter after the FMN stack is disabled. */
+	for (size_t i = 0; i < ARRAY_SIZE(adv_slots); i++) {
+		err = fmna_adv_arbiter_register(&adv_slots[i].arbiter_set);
+		if (err && (err != -EALREADY)) {
+			LOG_ERR("fmna_adv_arbiter_register returned error: %d", err);
+			return err;
+		}
+	}
+
 	return 0;
 }
 
@@ -36,6 +36,8 @@ int fmna_adv_start_nearby(const struct fmna_adv_nearby_config *config);
 
 int fmna_adv_start_separated(const struct fmna_adv_separated_config *config);
 
+uint64_t fmna_adv_airtime_get(void);
+
 int fmna_adv_init(uint8_t id);
 
 int fmna_adv_uninit(void);
@@ -0,0 +1,601 @@
+/*
+ * Copyright (c) 2021 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-4-Clause
+ */
+
+#include "fmna_adv_arbiter.h"
+
+#include <fmna.h>
+
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/sys/slist.h>
+
+#include <zephyr/logging/log.h>
+
+LOG_MODULE_DECLARE(fmna, CONFIG_FMNA_LOG_LEVEL);
+
+/* Advertising airtime estimation parameters. */
+#define ADV_INTERVAL_UNIT_US    625
+#define ADV_DELAY_AVG_US        5000
+#define ADV_PRIMARY_CHANNEL_NUM 3
+#define ADV_LE_1M_BYTE_US       8
+/* Preamble, access address, PDU header and CRC. */
+#define ADV_PDU_OVERHEAD_LEN    (1 + 4 + 2 + 3)
+#define ADV_ADDR_LEN            6
+
+/* Airtime budgets are configured in per mille and evaluated in parts per million. */
+#define AIRTIME_PPM_PER_PERMILLE 1000
+#define AIRTIME_PPM_FULL         1000000
+
+/* Priority of the Find My advertising set. Its interval range is defined by the
+ * specification, so it is exempt from the total airtime budget.
+ */
+#define BUDGET_EXEMPT_PRIORITY 0
+
+/* Interval step used to separate sets that would advertise with the same interval. */
+#define INTERVAL_STAGGER_STEP 0x0003 /* 1.875 ms */
+
+/* Charge model units: 1 nAh = 3.6 uC = 3.6 * 10^6 pC, so the average
+ * charge per day in nAh equals the charge in pC per millisecond times 24.
+ */
+#define CHARGE_PC_PER_NC        1000
+#define CHARGE_NAH_PER_DAY_COEF 24
+
+#define MSEC_PER_HOUR (60 * 60 * MSEC_PER_SEC)
+
+enum set_flag {
+	SET_FLAG_REGISTERED,
+	SET_FLAG_REQUESTED,
+	SET_FLAG_RUNNING,
+	SET_FLAG_TERMINATED,
+};
+
+static sys_slist_t sets = SYS_SLIST_STATIC_INIT(&sets);
+static K_MUTEX_DEFINE(arbiter_mutex);
+static struct k_spinlock stats_lock;
+
+static void arbitrate_work_handle(struct k_work *item);
+
+static K_WORK_DEFINE(arbitrate_work, arbitrate_work_handle);
+
+uint32_t fmna_adv_arbiter_event_airtime_estimate(const struct bt_data *ad, size_t ad_len)
+{
+	size_t pdu_len = ADV_PDU_OVERHEAD_LEN + ADV_ADDR_LEN;
+
+	for (size_t i = 0; i < ad_len; i++) {
+		pdu_len += (2 + ad[i].data_len);
+	}
+
+	/* Legacy advertising PDU is sent on each primary channel using LE 1M PHY. */
+	return (ADV_PRIMARY_CHANNEL_NUM * pdu_len * ADV_LE_1M_BYTE_US);
+}
+
+uint32_t fmna_adv_arbiter_event_period_us(uint32_t interval)
+{
+	return ((interval * ADV_INTERVAL_UNIT_US) + ADV_DELAY_AVG_US);
+}
+
+static uint32_t airtime_ppm_get(uint32_t event_airtime_us, uint32_t interval)
+{
+	uint64_t airtime = (uint64_t) event_airtime_us * AIRTIME_PPM_FULL;
+
+	return (uint32_t) DIV_ROUND_UP(airtime, fmna_adv_arbiter_event_period_us(interval));
+}
+
+static uint32_t interval_min_for_airtime_get(uint32_t event_airtime_us, uint32_t airtime_ppm)
+{
+	uint64_t period_us;
+
+	if (airtime_ppm == 0) {
+		return UINT32_MAX;
+	}
+
+	period_us = DIV_ROUND_UP((uint64_t) event_airtime_us * AIRTIME_PPM_FULL, airtime_ppm);
+	if (period_us <= ADV_DELAY_AVG_US) {
+		return 0;
+	}
+
+	return (uint32_t) MIN(DIV_ROUND_UP(period_us - ADV_DELAY_AVG_US, ADV_INTERVAL_UNIT_US),
+			      UINT32_MAX);
+}
+
+static uint32_t interval_stagger(const struct fmna_adv_arbiter_set *set, uint32_t interval)
+{
+	struct fmna_adv_arbiter_set *other;
+	uint32_t candidate = interval;
+	bool is_colliding;
+
+	/* Sets with equal intervals keep overlapping on the same advertising events.
+	 * Shift the lower priority set to a slightly longer interval if its range allows it.
+	 */
+	do {
+		is_colliding = false;
+
+		SYS_SLIST_FOR_EACH_CONTAINER(&sets, other, node) {
+			if (other == set) {
+				break;
+			}
+
+			if (other->is_admitted && (other->interval_next == candidate)) {
+				is_colliding = true;
+				candidate += INTERVAL_STAGGER_STEP;
+				break;
+			}
+		}
+	} while (is_colliding && (candidate <= set->param.interval_max));
+
+	return (candidate <= set->param.interval_max) ? candidate : interval;
+}
+
+static void admission_evaluate(void)
+{
+	struct fmna_adv_arbiter_set *set;
+	uint32_t slots = CONFIG_FMNA_ADV_ARBITER_SET_MAX;
+	uint32_t budget_ppm = CONFIG_FMNA_ADV_ARBITER_AIRTIME_BUDGET * AIRTIME_PPM_PER_PERMILLE;
+	uint32_t interval;
+	uint32_t airtime_ppm;
+	bool was_admitted;
+
+	/* The registered sets are sorted by priority. */
+	SYS_SLIST_FOR_EACH_CONTAINER(&sets, set, node) {
+		was_admitted = set->is_admitted;
+		set->is_admitted = false;
+
+		if (!atomic_test_bit(&set->flags, SET_FLAG_REQUESTED)) {
+			continue;
+		}
+
+		interval = set->param.interval_min;
+
+		if (set->airtime_budget != 0) {
+			interval = MAX(interval, interval_min_for_airtime_get(
+				set->event_airtime_us,
+				set->airtime_budget * AIRTIME_PPM_PER_PERMILLE));
+		}
+
+		/* The exempt set is only charged, so the lower priority sets
+		 * share the airtime that it leaves.
+		 */
+		if ((CONFIG_FMNA_ADV_ARBITER_AIRTIME_BUDGET != 0) &&
+		    (set->priority != BUDGET_EXEMPT_PRIORITY)) {
+			interval = MAX(interval, interval_min_for_airtime_get(
+				set->event_airtime_us, budget_ppm));
+		}
+
+		interval = interval_stagger(set, interval);
+
+		if ((slots == 0) || (interval > set->param.interval_max)) {
+			if (was_admitted || atomic_test_bit(&set->flags, SET_FLAG_RUNNING)) {
+				LOG_WRN("FMN advertising arbiter: suspending the %s set: %s",
+					set->name, (slots == 0) ?
+					"no advertising set slot left" :
+					"airtime budget exceeded");
+			}
+			continue;
+		}
+
+		set->is_admitted = true;
+		set->interval_next = interval;
+
+		slots--;
+
+		if (CONFIG_FMNA_ADV_ARBITER_AIRTIME_BUDGET != 0) {
+			airtime_ppm = airtime_ppm_get(set->event_airtime_us, interval);
+			budget_ppm -= MIN(airtime_ppm, budget_ppm);
+		}
+	}
+}
+
+static uint64_t event_charge_pc_get(uint32_t event_airtime_us)
+{
+	return ((uint64_t) CONFIG_FMNA_ADV_ARBITER_EVENT_CHARGE * CHARGE_PC_PER_NC) +
+	       ((uint64_t) CONFIG_FMNA_ADV_ARBITER_TX_CURRENT * event_airtime_us);
+}
+
+static void stats_segment_get(const struct fmna_adv_arbiter_set *set, int64_t now,
+			      uint64_t *time_ms, uint64_t *events)
+{
+	if (!set->stats.is_counting) {
+		*time_ms = 0;
+		*events = 0;
+		return;
+	}
+
+	*time_ms = now - set->stats.segment_start;
+	*events = (*time_ms * USEC_PER_MSEC) / fmna_adv_arbiter_event_period_us(set->interval);
+}
+
+static void stats_interval_time_add(struct fmna_adv_arbiter_stats *stats, uint32_t interval,
+				    uint64_t time_ms)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(stats->intervals); i++) {
+		if ((stats->intervals[i].interval == interval) ||
+		    (stats->intervals[i].time_ms == 0)) {
+			stats->intervals[i].interval = interval;
+			stats->intervals[i].time_ms += time_ms;
+			return;
+		}
+	}
+
+	stats->other_interval_time_ms += time_ms;
+}
+
+static void stats_segment_add(struct fmna_adv_arbiter_stats *stats,
+			      const struct fmna_adv_arbiter_set *set,
+			      uint64_t time_ms, uint64_t events)
+{
+	if (time_ms == 0) {
+		return;
+	}
+
+	stats->events += events;
+	stats->airtime_us += events * set->event_airtime_us;
+	stats->charge_pc += events * event_charge_pc_get(set->event_airtime_us);
+
+	stats_interval_time_add(stats, set->interval, time_ms);
+}
+
+static void stats_segment_open(struct fmna_adv_arbiter_set *set)
+{
+	k_spinlock_key_t key = k_spin_lock(&stats_lock);
+
+	set->stats.is_counting = true;
+	set->stats.segment_start = k_uptime_get();
+	set->stats.data.starts++;
+
+	k_spin_unlock(&stats_lock, key);
+}
+
+static void stats_segment_close(struct fmna_adv_arbiter_set *set)
+{
+	uint64_t time_ms;
+	uint64_t events;
+	k_spinlock_key_t key = k_spin_lock(&stats_lock);
+
+	stats_segment_get(set, k_uptime_get(), &time_ms, &events);
+	stats_segment_add(&set->stats.data, set, time_ms, events);
+	set->stats.is_counting = false;
+
+	k_spin_unlock(&stats_lock, key);
+}
+
+static void stats_event_airtime_update(struct fmna_adv_arbiter_set *set,
+				       uint32_t event_airtime_us)
+{
+	int64_t now;
+	uint64_t time_ms;
+	uint64_t events;
+	k_spinlock_key_t key = k_spin_lock(&stats_lock);
+
+	if (set->stats.is_counting && (set->event_airtime_us != event_airtime_us)) {
+		/* Account the elapsed time with the previous advertising data. */
+		now = k_uptime_get();
+		stats_segment_get(set, now, &time_ms, &events);
+		stats_segment_add(&set->stats.data, set, time_ms, events);
+		set->stats.segment_start = now;
+	}
+
+	set->event_airtime_us = event_airtime_us;
+
+	k_spin_unlock(&stats_lock, key);
+}
+
+static void set_stop(struct fmna_adv_arbiter_set *set)
+{
+	int err;
+
+	err = bt_le_ext_adv_stop(set->adv);
+	if (err) {
+		LOG_ERR("FMN advertising arbiter: bt_le_ext_adv_stop returned error: %d", err);
+	}
+
+	atomic_clear_bit(&set->flags, SET_FLAG_RUNNING);
+
+	stats_segment_close(set);
+}
+
+static int set_start(struct fmna_adv_arbiter_set *set)
+{
+	int err;
+	struct bt_le_adv_param param = set->param;
+	struct bt_le_ext_adv_start_param ext_adv_start_param = {
+		.timeout = set->timeout,
+	};
+
+	/* Sets with a fixed interval were created with the arbitrated parameters.
+	 * Avoid the parameter update for them as it also reconfigures the set address.
+	 */
+	if ((param.interval_min != param.interval_max) ||
+	    (param.interval_min != set->interval_next)) {
+		param.interval_min = set->interval_next;
+		param.interval_max = set->interval_next;
+
+		err = bt_le_ext_adv_update_param(set->adv, &param);
+		if (err) {
+			LOG_ERR("FMN advertising arbiter: bt_le_ext_adv_update_param "
+				"returned error: %d", err);
+			return err;
+		}
+	}
+
+	err = bt_le_ext_adv_start(set->adv, &ext_adv_start_param);
+	if (err) {
+		LOG_ERR("FMN advertising arbiter: bt_le_ext_adv_start returned error: %d", err);
+		return err;
+	}
+
+	set->interval = set->interval_next;
+	atomic_set_bit(&set->flags, SET_FLAG_RUNNING);
+
+	stats_segment_open(set);
+
+	LOG_DBG("FMN advertising arbiter: %s set started with interval %u [0.625 ms]",
+		set->name, set->interval);
+
+	return 0;
+}
+
+static void arbitrate(void)
+{
+	struct fmna_adv_arbiter_set *set;
+
+	/* Close the statistics of the sets terminated by the controller before
+	 * any of them is started again.
+	 */
+	SYS_SLIST_FOR_EACH_CONTAINER(&sets, set, node) {
+		if (atomic_test_and_clear_bit(&set->flags, SET_FLAG_TERMINATED)) {
+			stats_segment_close(set);
+		}
+	}
+
+	admission_evaluate();
+
+	/* Release the controller resources before any other set is started. */
+	SYS_SLIST_FOR_EACH_CONTAINER(&sets, set, node) {
+		if (!atomic_test_bit(&set->flags, SET_FLAG_RUNNING)) {
+			continue;
+		}
+
+		if (!set->is_admitted || (set->interval != set->interval_next)) {
+			set_stop(set);
+		}
+	}
+
+	/* Start the sets in the priority order. */
+	SYS_SLIST_FOR_EACH_CONTAINER(&sets, set, node) {
+		if (!set->is_admitted || atomic_test_bit(&set->flags, SET_FLAG_RUNNING)) {
+			continue;
+		}
+
+		if (set_start(set)) {
+			set->is_admitted = false;
+		}
+	}
+}
+
+static void arbitrate_work_handle(struct k_work *item)
+{
+	k_mutex_lock(&arbiter_mutex, K_FOREVER);
+	arbitrate();
+	k_mutex_unlock(&arbiter_mutex);
+}
+
+int fmna_adv_arbiter_register(struct fmna_adv_arbiter_set *set)
+{
+	struct fmna_adv_arbiter_set *prev = NULL;
+	struct fmna_adv_arbiter_set *iter;
+
+	if (!set || !set->name) {
+		return -EINVAL;
+	}
+
+	if (set->airtime_budget > 1000) {
+		return -EINVAL;
+	}
+
+	k_mutex_lock(&arbiter_mutex, K_FOREVER);
+
+	if (atomic_test_and_set_bit(&set->flags, SET_FLAG_REGISTERED)) {
+		k_mutex_unlock(&arbiter_mutex);
+		return -EALREADY;
+	}
+
+	/* Keep the list sorted by priority, preserving the registration order for ties. */
+	SYS_SLIST_FOR_EACH_CONTAINER(&sets, iter, node) {
+		if (iter->priority > set->priority) {
+			break;
+		}
+
+		prev = iter;
+	}
+
+	sys_slist_insert(&sets, prev ? &prev->node : NULL, &set->node);
+
+	memset(&set->stats, 0, sizeof(set->stats));
+	set->stats.reset_time = k_uptime_get();
+
+	k_mutex_unlock(&arbiter_mutex);
+
+	LOG_DBG("FMN advertising arbiter: registered the %s set with priority %u",
+		set->name, set->priority);
+
+	return 0;
+}
+
+int fmna_adv_arbiter_start(struct fmna_adv_arbiter_set *set, struct bt_le_ext_adv *adv,
+			   const struct fmna_adv_arbiter_start_param *start_param)
+{
+	if (!set || !adv || !start_param || !start_param->param) {
+		return -EINVAL;
+	}
+
+	if (start_param->param->interval_min > start_param->param->interval_max) {
+		return -EINVAL;
+	}
+
+	if (!atomic_test_bit(&set->flags, SET_FLAG_REGISTERED)) {
+		return -ENOENT;
+	}
+
+	k_mutex_lock(&arbiter_mutex, K_FOREVER);
+
+	if (atomic_test_bit(&set->flags, SET_FLAG_REQUESTED) && (set->adv == adv)) {
+		/* The requested set keeps running unless the new constraints change
+		 * its arbitrated interval, so the payload and the interval range of
+		 * an enabled set can be updated without the restart.
+		 */
+		stats_event_airtime_update(set, start_param->event_airtime_us);
+		set->param = *start_param->param;
+
+		arbitrate();
+
+		k_mutex_unlock(&arbiter_mutex);
+		return 0;
+	}
+
+	set->adv = adv;
+	set->param = *start_param->param;
+	set->timeout = start_param->timeout;
+	stats_event_airtime_update(set, start_param->event_airtime_us);
+
+	atomic_set_bit(&set->flags, SET_FLAG_REQUESTED);
+
+	arbitrate();
+
+	k_mutex_unlock(&arbiter_mutex);
+
+	if (!set->is_admitted) {
+		LOG_INF("FMN advertising arbiter: %s set is waiting for the radio time",
+			set->name);
+	}
+
+	return 0;
+}
+
+int fmna_adv_arbiter_stop(struct fmna_adv_arbiter_set *set)
+{
+	if (!set) {
+		return -EINVAL;
+	}
+
+	if (!atomic_test_bit(&set->flags, SET_FLAG_REGISTERED)) {
+		return -ENOENT;
+	}
+
+	k_mutex_lock(&arbiter_mutex, K_FOREVER);
+
+	atomic_clear_bit(&set->flags, SET_FLAG_REQUESTED);
+
+	if (atomic_test_bit(&set->flags, SET_FLAG_RUNNING)) {
+		set_stop(set);
+	}
+
+	set->is_admitted = false;
+
+	k_mutex_unlock(&arbiter_mutex);
+
+	/* Resume the suspended sets outside of the caller context. The caller
+	 * often restarts its set right away, which makes the resumption needless.
+	 */
+	k_work_submit(&arbitrate_work);
+
+	return 0;
+}
+
+void fmna_adv_arbiter_set_terminated(struct fmna_adv_arbiter_set *set)
+{
+	/* The controller has already disabled the set, e.g. on a connection.
+	 * This function is called from the Bluetooth callbacks, so the arbiter
+	 * mutex cannot be taken here. The statistics are closed in the
+	 * arbitration under the mutex.
+	 */
+	atomic_clear_bit(&set->flags, SET_FLAG_REQUESTED);
+	atomic_clear_bit(&set->flags, SET_FLAG_RUNNING);
+	atomic_set_bit(&set->flags, SET_FLAG_TERMINATED);
+
+	k_work_submit(&arbitrate_work);
+}
+
+bool fmna_adv_arbiter_is_running(const struct fmna_adv_arbiter_set *set)
+{
+	return atomic_test_bit(&set->flags, SET_FLAG_RUNNING);
+}
+
+int fmna_adv_arbiter_stats_get(const struct fmna_adv_arbiter_set *set,
+			       struct fmna_adv_arbiter_stats *stats)
+{
+	int64_t now;
+	uint64_t time_ms;
+	uint64_t events;
+	k_spinlock_key_t key;
+
+	if (!set || !stats) {
+		return -EINVAL;
+	}
+
+	if (!atomic_test_bit(&set->flags, SET_FLAG_REGISTERED)) {
+		return -ENOENT;
+	}
+
+	key = k_spin_lock(&stats_lock);
+
+	now = k_uptime_get();
+
+	*stats = set->stats.data;
+	stats_segment_get(set, now, &time_ms, &events);
+	stats_segment_add(stats, set, time_ms, events);
+
+	stats->time_ms = now - set->stats.reset_time;
+
+	k_spin_unlock(&stats_lock, key);
+
+	if (stats->time_ms != 0) {
+		stats->starts_per_hour = (uint32_t) DIV_ROUND_UP(
+			(uint64_t) stats->starts * MSEC_PER_HOUR, stats->time_ms);
+		stats->charge_nah_per_day = (uint32_t) MIN(
+			(stats->charge_pc * CHARGE_NAH_PER_DAY_COEF) / stats->time_ms,
+			UINT32_MAX);
+	}
+
+	return 0;
+}
+
+int fmna_adv_arbiter_stats_reset(struct fmna_adv_arbiter_set *set)
+{
+	k_spinlock_key_t key;
+
+	if (!set) {
+		return -EINVAL;
+	}
+
+	if (!atomic_test_bit(&set->flags, SET_FLAG_REGISTERED)) {
+		return -ENOENT;
+	}
+
+	key = k_spin_lock(&stats_lock);
+
+	memset(&set->stats.data, 0, sizeof(set->stats.data));
+	set->stats.reset_time = k_uptime_get();
+	if (set->stats.is_counting) {
+		set->stats.segment_start = set->stats.reset_time;
+	}
+
+	k_spin_unlock(&stats_lock, key);
+
+	return 0;
+}
+
+void fmna_adv_arbiter_foreach(void (*func)(struct fmna_adv_arbiter_set *set, void *user_data),
+			      void *user_data)
+{
+	struct fmna_adv_arbiter_set *set;
+
+	k_mutex_lock(&arbiter_mutex, K_FOREVER);
+
+	SYS_SLIST_FOR_EACH_CONTAINER(&sets, set, node) {
+		func(set, user_data);
+	}
+
+	k_mutex_unlock(&arbiter_mutex);
+}
@@ -0,0 +1,31 @@
+/*
+ * Copyright (c) 2021 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-4-Clause
+ */
+
+#ifndef FMNA_ADV_ARBITER_H_
+#define FMNA_ADV_ARBITER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <zephyr/kernel.h>
+
+#include <fmna.h>
+
+/* Average duration in microseconds between the starts of two consecutive
+ * advertising events, including the random advertising delay.
+ */
+uint32_t fmna_adv_arbiter_event_period_us(uint32_t interval);
+
+void fmna_adv_arbiter_foreach(void (*func)(struct fmna_adv_arbiter_set *set, void *user_data),
+			      void *user_data);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* FMNA_ADV_ARBITER_H_ */
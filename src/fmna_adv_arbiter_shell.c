@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2021 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-4-Clause
+ */
+
+#include "fmna_adv_arbiter.h"
+
+#include <fmna.h>
+
+#include <zephyr/shell/shell.h>
+
+/* Conversion from 0.625 ms advertising interval units to microseconds. */
+#define ADV_INTERVAL_TO_US(_interval) ((_interval) * 625)
+
+static void stats_print(struct fmna_adv_arbiter_set *set, void *user_data)
+{
+	int err;
+	const struct shell *sh = user_data;
+	struct fmna_adv_arbiter_stats stats;
+	uint32_t interval_us;
+
+	err = fmna_adv_arbiter_stats_get(set, &stats);
+	if (err) {
+		shell_error(sh, "%s: fmna_adv_arbiter_stats_get returned error: %d",
+			    set->name, err);
+		return;
+	}
+
+	shell_print(sh, "%s (priority %u, %s):", set->name, set->priority,
+		    fmna_adv_arbiter_is_running(set) ? "running" : "stopped");
+	shell_print(sh, "\ttracked time: %llu [s]", stats.time_ms / MSEC_PER_SEC);
+	shell_print(sh, "\tevents: %llu", stats.events);
+	shell_print(sh, "\tairtime: %llu [ms]", stats.airtime_us / USEC_PER_MSEC);
+	shell_print(sh, "\tstarts: %u (%u per hour)", stats.starts, stats.starts_per_hour);
+	shell_print(sh, "\tcharge: %u.%03u [uAh/day]",
+		    stats.charge_nah_per_day / 1000, stats.charge_nah_per_day % 1000);
+
+	for (size_t i = 0; i < ARRAY_SIZE(stats.intervals); i++) {
+		if (stats.intervals[i].time_ms == 0) {
+			break;
+		}
+
+		interval_us = ADV_INTERVAL_TO_US(stats.intervals[i].interval);
+		shell_print(sh, "\tinterval %u.%03u [ms]: %llu [s]",
+			    interval_us / USEC_PER_MSEC, interval_us % USEC_PER_MSEC,
+			    stats.intervals[i].time_ms / MSEC_PER_SEC);
+	}
+
+	if (stats.other_interval_time_ms != 0) {
+		shell_print(sh, "\tother intervals: %llu [s]",
+			    stats.other_interval_time_ms / MSEC_PER_SEC);
+	}
+}
+
+static void stats_reset(struct fmna_adv_arbiter_set *set, void *user_data)
+{
+	int err;
+	const struct shell *sh = user_data;
+
+	err = fmna_adv_arbiter_stats_reset(set);
+	if (err) {
+		shell_error(sh, "%s: fmna_adv_arbiter_stats_reset returned error: %d",
+			    set->name, err);
+	}
+}
+
+static int cmd_stats(const struct shell *sh, size_t argc, char **argv)
+{
+	fmna_adv_arbiter_foreach(stats_print, (void *) sh);
+
+	return 0;
+}
+
+static int cmd_stats_reset(const struct shell *sh, size_t argc, char **argv)
+{
+	fmna_adv_arbiter_foreach(stats_reset, (void *) sh);
+
+	shell_print(sh, "Advertising statistics reset");
+
+	return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(fmna_adv_cmds,
+	SHELL_CMD_ARG(stats, NULL, "Print the advertising statistics of all sets",
+		      cmd_stats, 1, 0),
+	SHELL_CMD_ARG(stats_reset, NULL, "Reset the advertising statistics of all sets",
+		      cmd_stats_reset, 1, 0),
+	SHELL_SUBCMD_SET_END
+);
+
+SHELL_CMD_REGISTER(fmna_adv, &fmna_adv_cmds, "Find My advertising arbiter commands", NULL);
@@ -0,0 +1,425 @@
+/*
+ * Copyright (c) 2021 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-4-Clause
+ */
+
+#include "events/fmna_event.h"
+#include "fmna_adv.h"
+#include "fmna_adv_policy.h"
+#include "fmna_battery.h"
+#include "fmna_state.h"
+
+#include <fmna.h>
+
+#include <zephyr/logging/log.h>
+
+LOG_MODULE_DECLARE(fmna, CONFIG_FMNA_LOG_LEVEL);
+
+#define UNPAIRED_ADV_INTERVAL    0x0030 /* 30 ms */
+#define PAIRED_ADV_INTERVAL      0x0C80 /* 2 s */
+#define PAIRED_ADV_INTERVAL_FAST 0x0030 /* 30 ms */
+
+/* Conversion from milliseconds to 0.625 ms advertising interval units. */
+#define ADV_INTERVAL_FROM_MS(_ms) (((_ms) * 8) / 5)
+
+#if CONFIG_FMNA_ADV_POLICY_PAIRED_INTERVAL_EXTENDED
+#define PAIRED_ADV_INTERVAL_MAX \
+	ADV_INTERVAL_FROM_MS(CONFIG_FMNA_ADV_POLICY_PAIRED_INTERVAL_MAX)
+#else
+/* Keep the paired advertising interval within the specification. */
+#define PAIRED_ADV_INTERVAL_MAX PAIRED_ADV_INTERVAL
+#endif
+
+#define OWNER_ABSENT_TIMEOUT  K_HOURS(CONFIG_FMNA_ADV_POLICY_OWNER_ABSENT_TIMEOUT)
+#define MOTION_ACTIVE_TIMEOUT K_SECONDS(CONFIG_FMNA_ADV_POLICY_MOTION_ACTIVE_TIMEOUT)
+
+enum pairing_stage {
+	PAIRING_STAGE_FAST,
+	PAIRING_STAGE_MEDIUM,
+	PAIRING_STAGE_SLOW,
+};
+
+#if CONFIG_FMNA_PAIRING_MODE_ADV_BACKOFF
+/* Pairing mode advertising stages, the last stage lasts until the pairing mode ends. */
+static const struct {
+	uint32_t interval;
+	uint32_t duration;
+} pairing_stages[] = {
+	[PAIRING_STAGE_FAST] = {
+		.interval = UNPAIRED_ADV_INTERVAL,
+		.duration = CONFIG_FMNA_PAIRING_MODE_ADV_BACKOFF_FAST_DURATION,
+	},
+	[PAIRING_STAGE_MEDIUM] = {
+		.interval = ADV_INTERVAL_FROM_MS(CONFIG_FMNA_PAIRING_MODE_ADV_BACKOFF_MEDIUM_INTERVAL),
+		.duration = CONFIG_FMNA_PAIRING_MODE_ADV_BACKOFF_MEDIUM_DURATION,
+	},
+	[PAIRING_STAGE_SLOW] = {
+		.interval = ADV_INTERVAL_FROM_MS(CONFIG_FMNA_PAIRING_MODE_ADV_BACKOFF_SLOW_INTERVAL),
+		.duration = 0,
+	},
+};
+#endif
+
+BUILD_ASSERT(PAIRED_ADV_INTERVAL_MAX >= PAIRED_ADV_INTERVAL,
+	     "The paired advertising interval bound is below the specification value");
+BUILD_ASSERT(CONFIG_FMNA_ADV_POLICY_TX_POWER_MIN <= CONFIG_FMNA_TX_POWER,
+	     "The minimal advertising TX power exceeds the configured TX power");
+
+static enum fmna_adv_policy_profile profile =
+	IS_ENABLED(CONFIG_FMNA_ADV_POLICY_PROFILE_LOW_POWER) ?
+		FMNA_ADV_POLICY_PROFILE_LOW_POWER :
+	IS_ENABLED(CONFIG_FMNA_ADV_POLICY_PROFILE_BALANCED) ?
+		FMNA_ADV_POLICY_PROFILE_BALANCED :
+		FMNA_ADV_POLICY_PROFILE_DEFAULT;
+
+/* Pairing mode advertising back-off context. */
+static struct {
+	bool is_active;
+	enum pairing_stage stage;
+	uint64_t airtime_start;
+} pairing_backoff;
+
+static bool is_owner_absent;
+static bool is_motion_active;
+
+/* Last advertising configuration that was requested by the advertising module. */
+static struct {
+	bool is_valid;
+	enum fmna_adv_policy_mode mode;
+	bool fast_mode;
+	struct fmna_adv_policy_params params;
+} last;
+
+static void owner_absent_work_handle(struct k_work *item);
+static void motion_work_handle(struct k_work *item);
+static void motion_active_work_handle(struct k_work *item);
+static void pairing_backoff_work_handle(struct k_work *item);
+
+static K_WORK_DEFINE(motion_work, motion_work_handle);
+static K_WORK_DELAYABLE_DEFINE(owner_absent_work, owner_absent_work_handle);
+static K_WORK_DELAYABLE_DEFINE(motion_active_work, motion_active_work_handle);
+static K_WORK_DELAYABLE_DEFINE(pairing_backoff_work, pairing_backoff_work_handle);
+
+static const char *profile_name_get(enum fmna_adv_policy_profile profile)
+{
+	switch (profile) {
+	case FMNA_ADV_POLICY_PROFILE_DEFAULT:
+		return "Default";
+	case FMNA_ADV_POLICY_PROFILE_BALANCED:
+		return "Balanced";
+	case FMNA_ADV_POLICY_PROFILE_LOW_POWER:
+		return "Low power";
+	default:
+		return "Unknown";
+	}
+}
+
+static uint32_t paired_interval_scale_get(enum fmna_adv_policy_mode mode,
+					  enum fmna_battery_state battery_state)
+{
+	uint32_t scale = 1;
+
+	switch (profile) {
+	case FMNA_ADV_POLICY_PROFILE_BALANCED:
+		break;
+	case FMNA_ADV_POLICY_PROFILE_LOW_POWER:
+		scale = 2;
+		break;
+	case FMNA_ADV_POLICY_PROFILE_DEFAULT:
+	default:
+		return 1;
+	}
+
+	/* A moving accessory is likely to be carried away from its owner. */
+	if (is_motion_active) {
+		return scale;
+	}
+
+	if (battery_state == FMNA_BATTERY_STATE_LOW) {
+		scale *= 2;
+	} else if (battery_state == FMNA_BATTERY_STATE_CRITICALLY_LOW) {
+		scale *= 4;
+	}
+
+	if ((mode == FMNA_ADV_POLICY_MODE_SEPARATED) && is_owner_absent) {
+		scale *= 2;
+	}
+
+	return scale;
+}
+
+static uint32_t unpaired_interval_get(void)
+{
+#if CONFIG_FMNA_PAIRING_MODE_ADV_BACKOFF
+	if (pairing_backoff.is_active) {
+		return pairing_stages[pairing_backoff.stage].interval;
+	}
+#endif
+
+	return UNPAIRED_ADV_INTERVAL;
+}
+
+static int8_t tx_power_get(enum fmna_battery_state battery_state)
+{
+	switch (profile) {
+	case FMNA_ADV_POLICY_PROFILE_BALANCED:
+		if ((battery_state == FMNA_BATTERY_STATE_LOW) ||
+		    (battery_state == FMNA_BATTERY_STATE_CRITICALLY_LOW)) {
+			return CONFIG_FMNA_ADV_POLICY_TX_POWER_MIN;
+		}
+
+		return CONFIG_FMNA_TX_POWER;
+	case FMNA_ADV_POLICY_PROFILE_LOW_POWER:
+		return CONFIG_FMNA_ADV_POLICY_TX_POWER_MIN;
+	case FMNA_ADV_POLICY_PROFILE_DEFAULT:
+	default:
+		return CONFIG_FMNA_TX_POWER;
+	}
+}
+
+static void params_compute(enum fmna_adv_policy_mode mode, bool fast_mode,
+			   struct fmna_adv_policy_params *params)
+{
+	enum fmna_battery_state battery_state = fmna_battery_state_get_no_cb();
+
+	params->tx_power = tx_power_get(battery_state);
+
+	if (mode == FMNA_ADV_POLICY_MODE_UNPAIRED) {
+		params->interval = unpaired_interval_get();
+	} else if (fast_mode) {
+		/* Keep the persistent connection reestablishment fast. */
+		params->interval = PAIRED_ADV_INTERVAL_FAST;
+	} else {
+		params->interval = PAIRED_ADV_INTERVAL * paired_interval_scale_get(mode,
+										   battery_state);
+		params->interval = MIN(params->interval, PAIRED_ADV_INTERVAL_MAX);
+	}
+}
+
+void fmna_adv_policy_params_get(enum fmna_adv_policy_mode mode, bool fast_mode,
+				struct fmna_adv_policy_params *params)
+{
+	params_compute(mode, fast_mode, params);
+
+	if (!last.is_valid ||
+	    (last.params.interval != params->interval) ||
+	    (last.params.tx_power != params->tx_power)) {
+		LOG_INF("FMN advertising policy (%s): interval %u [0.625 ms], TX power %d dBm",
+			profile_name_get(profile), params->interval, params->tx_power);
+	}
+
+	last.is_valid = true;
+	last.mode = mode;
+	last.fast_mode = fast_mode;
+	last.params = *params;
+}
+
+static void params_reevaluate(void)
+{
+	struct fmna_adv_policy_params params;
+
+	if (!last.is_valid || !fmna_state_is_enabled()) {
+		return;
+	}
+
+	params_compute(last.mode, last.fast_mode, &params);
+	if ((params.interval == last.params.interval) &&
+	    (params.tx_power == last.params.tx_power)) {
+		return;
+	}
+
+	LOG_DBG("FMN advertising policy inputs changed, requesting advertising update");
+
+	FMNA_EVENT_CREATE(event, FMNA_EVENT_ADV_POLICY_CHANGED, NULL);
+	APP_EVENT_SUBMIT(event);
+}
+
+void fmna_adv_policy_motion_report(void)
+{
+	/* Switch context as the motion is reported from the timer handler. */
+	k_work_submit(&motion_work);
+}
+
+static void motion_work_handle(struct k_work *item)
+{
+	is_motion_active = true;
+	k_work_reschedule(&motion_active_work, MOTION_ACTIVE_TIMEOUT);
+
+	params_reevaluate();
+}
+
+static void motion_active_work_handle(struct k_work *item)
+{
+	is_motion_active = false;
+
+	params_reevaluate();
+}
+
+static void owner_absent_work_handle(struct k_work *item)
+{
+	LOG_DBG("FMN advertising policy: owner absent for %d [h]",
+		CONFIG_FMNA_ADV_POLICY_OWNER_ABSENT_TIMEOUT);
+
+	is_owner_absent = true;
+
+	params_reevaluate();
+}
+
+static uint32_t pairing_airtime_ms_get(void)
+{
+	uint64_t airtime = fmna_adv_airtime_get();
+
+	/* The advertising statistics may have been reset in the meantime. */
+	if (airtime >= pairing_backoff.airtime_start) {
+		airtime -= pairing_backoff.airtime_start;
+	}
+
+	return (uint32_t) (airtime / USEC_PER_MSEC);
+}
+
+static void pairing_stage_set(enum pairing_stage stage)
+{
+	pairing_backoff.stage = stage;
+
+#if CONFIG_FMNA_PAIRING_MODE_ADV_BACKOFF
+	if (pairing_stages[stage].duration != 0) {
+		k_work_reschedule(&pairing_backoff_work,
+				  K_SECONDS(pairing_stages[stage].duration));
+	} else {
+		k_work_cancel_delayable(&pairing_backoff_work);
+	}
+#endif
+}
+
+static void pairing_backoff_work_handle(struct k_work *item)
+{
+	if (!pairing_backoff.is_active || (pairing_backoff.stage == PAIRING_STAGE_SLOW)) {
+		return;
+	}
+
+	pairing_stage_set(pairing_backoff.stage + 1);
+
+	LOG_INF("FMN pairing mode advertising: stage %d, airtime %u [ms]",
+		pairing_backoff.stage, pairing_airtime_ms_get());
+
+	params_reevaluate();
+}
+
+void fmna_adv_policy_pairing_backoff_start(void)
+{
+	if (!pairing_backoff.is_active) {
+		pairing_backoff.is_active = true;
+		pairing_backoff.airtime_start = fmna_adv_airtime_get();
+	}
+
+	pairing_stage_set(PAIRING_STAGE_FAST);
+}
+
+void fmna_adv_policy_pairing_backoff_stop(void)
+{
+	if (!pairing_backoff.is_active) {
+		return;
+	}
+
+	k_work_cancel_delayable(&pairing_backoff_work);
+
+	LOG_INF("FMN pairing mode advertising: finished, airtime %u [ms]",
+		pairing_airtime_ms_get());
+
+	pairing_backoff.is_active = false;
+}
+
+static void nfc_field_detected(void)
+{
+	if (!pairing_backoff.is_active || (pairing_backoff.stage == PAIRING_STAGE_FAST)) {
+		return;
+	}
+
+	LOG_DBG("FMN pairing mode advertising: NFC field detected, restarting fast stage");
+
+	pairing_stage_set(PAIRING_STAGE_FAST);
+
+	params_reevaluate();
+}
+
+int fmna_adv_policy_profile_set(enum fmna_adv_policy_profile new_profile)
+{
+	switch (new_profile) {
+	case FMNA_ADV_POLICY_PROFILE_DEFAULT:
+	case FMNA_ADV_POLICY_PROFILE_BALANCED:
+	case FMNA_ADV_POLICY_PROFILE_LOW_POWER:
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	profile = new_profile;
+
+	LOG_INF("FMN advertising policy profile set to: %s", profile_name_get(profile));
+
+	params_reevaluate();
+
+	return 0;
+}
+
+enum fmna_adv_policy_profile fmna_adv_policy_profile_get(void)
+{
+	return profile;
+}
+
+static void state_changed(void)
+{
+	switch (fmna_state_get()) {
+	case FMNA_STATE_CONNECTED:
+		/* The owner is present, restart the absence measurement. */
+		is_owner_absent = false;
+		k_work_cancel_delayable(&owner_absent_work);
+		break;
+	case FMNA_STATE_NEARBY:
+	case FMNA_STATE_SEPARATED:
+		if (!is_owner_absent && !k_work_delayable_is_pending(&owner_absent_work)) {
+			k_work_schedule(&owner_absent_work, OWNER_ABSENT_TIMEOUT);
+		}
+		break;
+	case FMNA_STATE_DISABLED:
+		last.is_valid = false;
+		__fallthrough;
+	case FMNA_STATE_UNPAIRED:
+	default:
+		is_owner_absent = false;
+		is_motion_active = false;
+		k_work_cancel(&motion_work);
+		k_work_cancel_delayable(&owner_absent_work);
+		k_work_cancel_delayable(&motion_active_work);
+		break;
+	}
+}
+
+static bool app_event_handler(const struct app_event_header *aeh)
+{
+	if (is_fmna_event(aeh)) {
+		struct fmna_event *event = cast_fmna_event(aeh);
+
+		switch (event->id) {
+		case FMNA_EVENT_BATTERY_LEVEL_CHANGED:
+			params_reevaluate();
+			break;
+		case FMNA_EVENT_NFC_FIELD_DETECTED:
+			nfc_field_detected();
+			break;
+		case FMNA_EVENT_STATE_CHANGED:
+			state_changed();
+			break;
+		default:
+			break;
+		}
+
+		return false;
+	}
+
+	return false;
+}
+
+APP_EVENT_LISTENER(fmna_adv_policy, app_event_handler);
+APP_EVENT_SUBSCRIBE(fmna_adv_policy, fmna_event);
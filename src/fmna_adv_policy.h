@@ -0,0 +1,43 @@
+/*
+ * Copyright (c) 2021 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-4-Clause
+ */
+
+#ifndef FMNA_ADV_POLICY_H_
+#define FMNA_ADV_POLICY_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <zephyr/kernel.h>
+
+enum fmna_adv_policy_mode {
+	FMNA_ADV_POLICY_MODE_UNPAIRED,
+	FMNA_ADV_POLICY_MODE_NEARBY,
+	FMNA_ADV_POLICY_MODE_SEPARATED,
+};
+
+struct fmna_adv_policy_params {
+	/* Advertising interval in 0.625 ms units. */
+	uint32_t interval;
+	/* Advertising TX power in dBm. */
+	int8_t tx_power;
+};
+
+void fmna_adv_policy_params_get(enum fmna_adv_policy_mode mode, bool fast_mode,
+				struct fmna_adv_policy_params *params);
+
+void fmna_adv_policy_motion_report(void);
+
+void fmna_adv_policy_pairing_backoff_start(void);
+
+void fmna_adv_policy_pairing_backoff_stop(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* FMNA_ADV_POLICY_H_ */
@@ -10,55 +10,55 @@
 #include "fmna_state.h"
 #include "fmna_gatt_fmns.h"
 //#include "app_network_selector.h"
+#include <zephyr/sys/math_extras.h>
 #include <zephyr/sys/util.h>
 
 #include <zephyr/logging/log.h>
 LOG_MODULE_DECLARE(fmna, CONFIG_FMNA_LOG_LEVEL);
 
-#define MAX_CONN_WORK_CHECK_PERIOD K_MSEC(100)
+BUILD_ASSERT(CONFIG_BT_MAX_CONN <= 32,
+	     "The pending disconnection bitmap supports up to 32 connections");
 
 BUILD_ASSERT(!(IS_ENABLED(CONFIG_FMNA_BT_PAIRING_NO_BONDING) &&
 	     IS_ENABLED(CONFIG_BT_BONDING_REQUIRED)),
 	     "CONFIG_FMNA_BT_PAIRING_NO_BONDING cannot be used together "
 	     "with CONFIG_BT_BONDING_REQUIRED");
 
-struct conn_owner_finder {
-	struct bt_conn ** const owners;
-	uint8_t * const owner_cnt;
-	const uint8_t owner_array_size;
-};
-
-struct conn_status_finder {
-	const struct {
-		enum fmna_conn_multi_status_bit status_bit;
-	} in;
-	struct {
-		bool is_found;
-	} out;
-};
-
 struct conn_disconnecter {
 	int disconnect_num;
 	struct bt_conn *req_conn;
 };
 
 struct fmna_conn {
+	struct bt_conn *conn;
 	uint32_t multi_status;
 	bool is_valid;
 	bool is_disconnecting;
 };
 
+/* Connection registry with bitmaps indexed by bt_conn_index. It is updated
+ * incrementally on connection events and multi status changes, so that the
+ * frequent queries do not have to iterate over all Bluetooth connections.
+ */
+static struct {
+	/* Valid connections that are not being disconnected. */
+	atomic_t active;
+	/* Encrypted connections with the link security level of at least L2. */
+	atomic_t encrypted;
+	/* Valid connections with the given multi status bit set. */
+	atomic_t status[FMNA_CONN_MULTI_STATUS_BIT_MULTIPLE_OWNERS + 1];
+} registry;
+
 static struct fmna_conn conns[CONFIG_BT_MAX_CONN];
 static uint8_t max_connections = CONFIG_FMNA_MAX_CONN;
 static uint8_t fmna_bt_id;
 
-static void max_conn_work_handle(struct k_work *item);
-
-static struct max_conn_work {
-	struct k_work_delayable item;
+/* Set Max Connections request waiting for the excessive links to drop. */
+static struct max_conn_request {
 	struct bt_conn *conn;
-	struct bt_conn *disconnecting_conns[CONFIG_BT_MAX_CONN];
-} max_conn_work;
+	/* Bitmap of connection indexes with a pending disconnection. */
+	uint32_t pending;
+} max_conn_request;
 
 struct conn_timeout_work {
 	struct k_work_delayable item;
@@ -231,7 +231,9 @@ static void connected(struct bt_conn *conn, uint8_t conn_err)
 	bt_addr_le_to_str(bt_conn_get_dst(conn), addr, sizeof(addr));
 	LOG_DBG("FMN Peer connected: %s", addr);
 
+	fmna_conn->conn = conn;
 	fmna_conn->is_valid = true;
+	atomic_set_bit(&registry.active, bt_conn_index(conn));
 	bt_conn_ref(conn);
 
 	conn_timeout_work_schedule(conn);
@@ -257,6 +259,8 @@ static void disconnected(struct bt_conn *conn, uint8_t reason)
 	LOG_DBG("FMN Peer disconnected (reason %u): %s", reason, addr);
 
 	fmna_conn->is_disconnecting = true;
+	atomic_clear_bit(&registry.active, bt_conn_index(conn));
+	atomic_clear_bit(&registry.encrypted, bt_conn_index(conn));
 	conn_timeout_work_cancel(conn);
 
 	bt_conn_unref(conn);
@@ -294,6 +298,7 @@ static void security_changed(struct bt_conn *conn, bt_security_t level,
 
 		if ((level >= BT_SECURITY_L2) && (level <= BT_SECURITY_L4)) {
 			conn_timeout_work_cancel(conn);
+			atomic_set_bit(&registry.encrypted, bt_conn_index(conn));
 		}
 	}
 
@@ -309,64 +314,59 @@ BT_CONN_CB_DEFINE(conn_callbacks) = {
 	.security_changed = security_changed,
 };
 
-static void conn_owner_iterator(struct bt_conn *conn, void *user_data)
+uint8_t fmna_conn_connection_num_get(void)
 {
-	struct conn_owner_finder *conn_owner_finder = user_data;
-
-	if (fmna_conn_multi_status_bit_check(
-		conn, FMNA_CONN_MULTI_STATUS_BIT_OWNER_CONNECTED)) {
-		if (*conn_owner_finder->owner_cnt < conn_owner_finder->owner_array_size) {
-			conn_owner_finder->owners[*conn_owner_finder->owner_cnt] = conn;
-		}
-
-		*conn_owner_finder->owner_cnt += 1;
-	}
+	return POPCOUNT(atomic_get(&registry.active));
 }
 
-static void conn_status_iterator(struct bt_conn *conn, void *user_data)
+bool fmna_conn_limit_check(void)
 {
-	struct conn_status_finder *conn_status_finder =
-		(struct conn_status_finder *) user_data;
+	uint8_t cnt = fmna_conn_connection_num_get();
 
-	if (fmna_conn_multi_status_bit_check(conn, conn_status_finder->in.status_bit)) {
-		conn_status_finder->out.is_found = true;
-	}
+	return (cnt < max_connections);
 }
 
-uint8_t fmna_conn_connection_num_get(void)
+uint32_t fmna_conn_owner_bitmap_get(void)
 {
-	uint8_t cnt = 0;
-
-	for (size_t i = 0; i < ARRAY_SIZE(conns); i++) {
-		if (conns[i].is_valid && !conns[i].is_disconnecting) {
-			cnt++;
-		}
-	}
+	return atomic_get(&registry.status[FMNA_CONN_MULTI_STATUS_BIT_OWNER_CONNECTED]);
+}
 
-	return cnt;
+uint32_t fmna_conn_non_owner_bitmap_get(void)
+{
+	return (atomic_get(&registry.active) & ~fmna_conn_owner_bitmap_get());
 }
 
-bool fmna_conn_limit_check(void)
+uint32_t fmna_conn_encrypted_bitmap_get(void)
 {
-	uint8_t cnt = fmna_conn_connection_num_get();
+	return atomic_get(&registry.encrypted);
+}
 
-	return (cnt < max_connections);
+uint8_t fmna_conn_owner_num_get(void)
+{
+	return POPCOUNT(fmna_conn_owner_bitmap_get());
 }
 
 int fmna_conn_owner_find(struct bt_conn *owner_conns[], uint8_t *owner_conn_cnt)
 {
-	struct conn_owner_finder conn_owner_finder = {
-		.owners = owner_conns,
-		.owner_cnt = owner_conn_cnt,
-		.owner_array_size = *owner_conn_cnt,
-	};
+	uint8_t owner_array_size = *owner_conn_cnt;
+	uint32_t owners = fmna_conn_owner_bitmap_get();
+	uint8_t index;
 
 	/* Reset the owner connection counter. */
-	*conn_owner_finder.owner_cnt = 0;
+	*owner_conn_cnt = 0;
+
+	while (owners) {
+		index = u32_count_trailing_zeros(owners);
+		owners &= (owners - 1);
 
-	bt_conn_foreach(BT_CONN_TYPE_LE, conn_owner_iterator, &conn_owner_finder);
+		if (*owner_conn_cnt < owner_array_size) {
+			owner_conns[*owner_conn_cnt] = conns[index].conn;
+		}
+
+		*owner_conn_cnt += 1;
+	}
 
-	if (conn_owner_finder.owner_array_size < *conn_owner_finder.owner_cnt) {
+	if (owner_array_size < *owner_conn_cnt) {
 		return -ENOMEM;
 	}
 
@@ -397,10 +397,11 @@ void fmna_conn_multi_status_bit_set(struct bt_conn *conn,
 		return;
 	}
 
-	__ASSERT(status_bit < (sizeof(fmna_conn->multi_status) * __CHAR_BIT__),
+	__ASSERT(status_bit < ARRAY_SIZE(registry.status),
 		 "FMNA Status bit is invalid: %d", status_bit);
 
 	WRITE_BIT(fmna_conn->multi_status, status_bit, 1);
+	atomic_set_bit(&registry.status[status_bit], bt_conn_index(conn));
 }
 
 void fmna_conn_multi_status_bit_clear(struct bt_conn *conn,
@@ -412,20 +413,21 @@ void fmna_conn_multi_status_bit_clear(struct bt_conn *conn,
 		return;
 	}
 
-	__ASSERT(status_bit < (sizeof(fmna_conn->multi_status) * __CHAR_BIT__),
+	__ASSERT(status_bit < ARRAY_SIZE(registry.status),
 		 "FMNA Status bit is invalid: %d", status_bit);
 
 	WRITE_BIT(fmna_conn->multi_status, status_bit, 0);
+	atomic_clear_bit(&registry.status[status_bit], bt_conn_index(conn));
 }
 
 int fmna_conn_init(uint8_t bt_id)
 {
-	k_work_init_delayable(&max_conn_work.item, max_conn_work_handle);
-
 	/* Reset the state. */
 	fmna_bt_id = bt_id;
 	max_connections = CONFIG_FMNA_MAX_CONN;
 	memset(conns, 0, sizeof(conns));
+	memset(&registry, 0, sizeof(registry));
+	memset(&max_conn_request, 0, sizeof(max_conn_request));
 
 	conn_timeout_work_init();
 
@@ -470,11 +472,58 @@ int fmna_conn_uninit(void)
 	return 0;
 }
 
+static void max_conn_response_send(struct bt_conn *conn)
+{
+	int err;
+	uint16_t opcode;
+
+	opcode = fmna_config_event_to_gatt_cmd_opcode(FMNA_CONFIG_EVENT_SET_MAX_CONNECTIONS);
+	FMNA_GATT_COMMAND_RESPONSE_BUILD(cmd_buf, opcode, FMNA_GATT_RESPONSE_STATUS_SUCCESS);
+	err = fmna_gatt_config_cp_indicate(conn, FMNA_GATT_CONFIG_COMMAND_RESPONSE_IND, &cmd_buf);
+	if (err) {
+		LOG_ERR("fmna_gatt_config_cp_indicate returned error: %d", err);
+	}
+}
+
+static void max_conn_request_disconnected(struct bt_conn *conn)
+{
+	uint8_t conn_index = bt_conn_index(conn);
+
+	if (!max_conn_request.conn) {
+		return;
+	}
+
+	if (max_conn_request.conn == conn) {
+		/* The requesting peer is gone, there is no one to respond to. */
+		memset(&max_conn_request, 0, sizeof(max_conn_request));
+		return;
+	}
+
+	if (!(max_conn_request.pending & BIT(conn_index))) {
+		return;
+	}
+
+	WRITE_BIT(max_conn_request.pending, conn_index, 0);
+	if (!max_conn_request.pending) {
+		LOG_DBG("All excessive links dropped, sending Set Max Connections response");
+
+		max_conn_response_send(max_conn_request.conn);
+		max_conn_request.conn = NULL;
+	}
+}
+
 static void peer_disconnected(struct bt_conn *conn)
 {
-	struct fmna_conn *fmna_conn = &conns[bt_conn_index(conn)];
+	uint8_t conn_index = bt_conn_index(conn);
+	struct fmna_conn *fmna_conn = &conns[conn_index];
 
 	memset(fmna_conn, 0, sizeof(*fmna_conn));
+
+	for (size_t i = 0; i < ARRAY_SIZE(registry.status); i++) {
+		atomic_clear_bit(&registry.status[i], conn_index);
+	}
+
+	max_conn_request_disconnected(conn);
 }
 
 static void unpaired_state_transition_handle(void)
@@ -500,16 +549,14 @@ static void persistent_conn_request_handle(struct bt_conn *conn, uint8_t persist
 {
 	int err;
 	uint16_t resp_opcode;
-	struct conn_status_finder conn_status_finder = {
-		.in.status_bit = FMNA_CONN_MULTI_STATUS_BIT_PERSISTENT_CONNECTION,
-		.out.is_found = false,
-	};
+	bool is_found;
 
 	LOG_INF("FMN Config CP: responding to persistent connection request: %d",
 		persistent_conn_status);
 
-	bt_conn_foreach(BT_CONN_TYPE_LE, conn_status_iterator, &conn_status_finder);
-	if ((persistent_conn_status & BIT(0)) && !conn_status_finder.out.is_found) {
+	is_found = (atomic_get(
+		&registry.status[FMNA_CONN_MULTI_STATUS_BIT_PERSISTENT_CONNECTION]) != 0);
+	if ((persistent_conn_status & BIT(0)) && !is_found) {
 		fmna_conn_multi_status_bit_set(
 			conn, FMNA_CONN_MULTI_STATUS_BIT_PERSISTENT_CONNECTION);
 	} else {
@@ -560,48 +607,11 @@ static void conn_disconnecter_iterator(struct bt_conn *conn, void *user_data)
 	}
 
 	conn_disconnecter->disconnect_num--;
-	max_conn_work.disconnecting_conns[bt_conn_index(conn)] = conn;
-}
-
-static void max_conn_work_handle(struct k_work *item)
-{
-	struct bt_conn *conn;
-	bool disconnects_done = true;
-
-	for (size_t i = 0; i < ARRAY_SIZE(max_conn_work.disconnecting_conns); i++) {
-		conn = max_conn_work.disconnecting_conns[i];
-		if (conn) {
-			if (conns[bt_conn_index(conn)].is_valid) {
-				disconnects_done = false;
-				break;
-			}
-		}
-	}
-
-	if (disconnects_done) {
-		int err;
-		uint16_t opcode;
-
-		opcode = fmna_config_event_to_gatt_cmd_opcode(
-			FMNA_CONFIG_EVENT_SET_MAX_CONNECTIONS);
-		FMNA_GATT_COMMAND_RESPONSE_BUILD(
-			cmd_buf, opcode, FMNA_GATT_RESPONSE_STATUS_SUCCESS);
-		err = fmna_gatt_config_cp_indicate(
-			max_conn_work.conn, FMNA_GATT_CONFIG_COMMAND_RESPONSE_IND, &cmd_buf);
-		if (err) {
-			LOG_ERR("fmna_gatt_config_cp_indicate returned error: %d", err);
-		}
-
-		max_conn_work.conn = NULL;
-	} else {
-		k_work_reschedule(&max_conn_work.item, MAX_CONN_WORK_CHECK_PERIOD);
-	}
+	WRITE_BIT(max_conn_request.pending, bt_conn_index(conn), 1);
 }
 
 static void max_connections_request_handle(struct bt_conn *conn, uint8_t max_conns)
 {
-	int err;
-	uint16_t opcode;
 	bool use_event;
 	struct conn_disconnecter conn_disconnecter;
 
@@ -626,27 +636,23 @@ static void max_connections_request_handle(struct bt_conn *conn, uint8_t max_con
 	max_connections = max_conns;
 
 	if (conn_disconnecter.disconnect_num > 0) {
-		/* Disconnect excessive links. */
+		/* Disconnect excessive links. The response is sent from the
+		 * disconnection handler once the last of them drops.
+		 */
 		bt_conn_foreach(BT_CONN_TYPE_LE, conn_disconnecter_iterator, &conn_disconnecter);
 
-		if (!max_conn_work.conn) {
-			max_conn_work.conn = conn;
-			memset(max_conn_work.disconnecting_conns, 0,
-			       sizeof(max_conn_work.disconnecting_conns));
+		if (!max_conn_request.conn) {
+			if (max_conn_request.pending) {
+				max_conn_request.conn = conn;
 
-			k_work_reschedule(&max_conn_work.item, MAX_CONN_WORK_CHECK_PERIOD);
-
-			LOG_DBG("Delaying Set Max Connections response");
+				LOG_DBG("Delaying Set Max Connections response");
+			} else {
+				max_conn_response_send(conn);
+			}
 		}
 	} else {
 		/* Respond to the command. */
-		opcode = fmna_config_event_to_gatt_cmd_opcode(
-			FMNA_CONFIG_EVENT_SET_MAX_CONNECTIONS);
-		FMNA_GATT_COMMAND_RESPONSE_BUILD(cmd_buf, opcode, FMNA_GATT_RESPONSE_STATUS_SUCCESS);
-		err = fmna_gatt_config_cp_indicate(conn, FMNA_GATT_CONFIG_COMMAND_RESPONSE_IND, &cmd_buf);
-		if (err) {
-			LOG_ERR("fmna_gatt_config_cp_indicate returned error: %d", err);
-		}
+		max_conn_response_send(conn);
 	}
 
 	/* Emit the event. */
@@ -664,16 +670,8 @@ static void multi_status_request_handle(struct bt_conn *conn)
 	NET_BUF_SIMPLE_DEFINE(status_buf, sizeof(multi_status));
 
 	multi_status = conns[req_author_index].multi_status;
-	for (size_t i = 0; i < ARRAY_SIZE(conns); i++) {
-		if ((!conns[i].is_valid) || (i == req_author_index)) {
-			continue;
-		}
-
-		if (fmna_conn_multi_status_bit_check(conn,
-			FMNA_CONN_MULTI_STATUS_BIT_OWNER_CONNECTED)) {
-			WRITE_BIT(multi_status, FMNA_CONN_MULTI_STATUS_BIT_MULTIPLE_OWNERS, 1);
-			break;
-		}
+	if (fmna_conn_owner_bitmap_get() & ~BIT(req_author_index)) {
+		WRITE_BIT(multi_status, FMNA_CONN_MULTI_STATUS_BIT_MULTIPLE_OWNERS, 1);
 	}
 
 	LOG_INF("FMN Config CP: responding to connection multi status: 0x%02X",
@@ -30,6 +30,15 @@ bool fmna_conn_check(struct bt_conn *conn);
 
 int fmna_conn_owner_find(struct bt_conn *owner_conns[], uint8_t *owner_conn_cnt);
 
+/* Bitmaps of the Find My connections indexed by bt_conn_index. */
+uint32_t fmna_conn_owner_bitmap_get(void);
+
+uint32_t fmna_conn_non_owner_bitmap_get(void);
+
+uint32_t fmna_conn_encrypted_bitmap_get(void);
+
+uint8_t fmna_conn_owner_num_get(void);
+
 bool fmna_conn_multi_status_bit_check(struct bt_conn *conn,
 				      enum fmna_conn_multi_status_bit status_bit);
 
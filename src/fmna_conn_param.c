@@ -0,0 +1,225 @@
+/*
+ * Copyright (c) 2021 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-4-Clause
+ */
+
+#include "events/fmna_event.h"
+#include "fmna_conn.h"
+#include "fmna_conn_param.h"
+
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/gatt.h>
+
+#include <zephyr/logging/log.h>
+
+LOG_MODULE_DECLARE(fmna, CONFIG_FMNA_LOG_LEVEL);
+
+/* Conversion from milliseconds to 1.25 ms connection interval units. */
+#define CONN_INTERVAL_FROM_MS(_ms) (((_ms) * 4) / 5)
+
+/* Conversion from milliseconds to 10 ms supervision timeout units. */
+#define CONN_TIMEOUT_FROM_MS(_ms) ((_ms) / 10)
+
+#define IDLE_TIMEOUT K_SECONDS(CONFIG_FMNA_CONN_PARAM_IDLE_TIMEOUT)
+
+BUILD_ASSERT(CONFIG_FMNA_CONN_PARAM_SUPERVISION_TIMEOUT >
+	     (2 * CONFIG_FMNA_CONN_PARAM_IDLE_INTERVAL_MAX *
+	      (CONFIG_FMNA_CONN_PARAM_IDLE_LATENCY + 1)),
+	     "The supervision timeout is too short for the idle link parameters");
+
+enum ctx_flag {
+	CTX_FLAG_BULK,
+	CTX_FLAG_LINK_SETUP_DONE,
+};
+
+struct conn_param_ctx {
+	struct bt_conn *conn;
+	struct k_work update_work;
+	struct k_work_delayable idle_work;
+	ATOMIC_DEFINE(flags, 2);
+#if defined(CONFIG_BT_GATT_CLIENT)
+	struct bt_gatt_exchange_params mtu_params;
+#endif
+};
+
+static const struct bt_le_conn_param bulk_param = BT_LE_CONN_PARAM_INIT(
+	CONN_INTERVAL_FROM_MS(CONFIG_FMNA_CONN_PARAM_BULK_INTERVAL_MIN),
+	CONN_INTERVAL_FROM_MS(CONFIG_FMNA_CONN_PARAM_BULK_INTERVAL_MAX),
+	0,
+	CONN_TIMEOUT_FROM_MS(CONFIG_FMNA_CONN_PARAM_SUPERVISION_TIMEOUT));
+
+static const struct bt_le_conn_param idle_param = BT_LE_CONN_PARAM_INIT(
+	CONN_INTERVAL_FROM_MS(CONFIG_FMNA_CONN_PARAM_IDLE_INTERVAL_MIN),
+	CONN_INTERVAL_FROM_MS(CONFIG_FMNA_CONN_PARAM_IDLE_INTERVAL_MAX),
+	CONFIG_FMNA_CONN_PARAM_IDLE_LATENCY,
+	CONN_TIMEOUT_FROM_MS(CONFIG_FMNA_CONN_PARAM_SUPERVISION_TIMEOUT));
+
+static struct conn_param_ctx ctxs[CONFIG_BT_MAX_CONN];
+
+#if defined(CONFIG_BT_GATT_CLIENT)
+static void mtu_exchange_cb(struct bt_conn *conn, uint8_t err,
+			    struct bt_gatt_exchange_params *params)
+{
+	if (err) {
+		LOG_WRN("fmna_conn_param: MTU exchange failed: %d", err);
+	} else {
+		LOG_DBG("fmna_conn_param: MTU updated to %d", bt_gatt_get_mtu(conn));
+	}
+}
+#endif
+
+static void link_setup(struct conn_param_ctx *ctx)
+{
+	int err;
+
+	/* The data length, the PHY and the MTU are negotiated only once per
+	 * connection as they do not affect the idle link consumption.
+	 */
+	if (IS_ENABLED(CONFIG_BT_USER_DATA_LEN_UPDATE)) {
+		err = bt_conn_le_data_len_update(ctx->conn, BT_LE_DATA_LEN_PARAM_MAX);
+		if (err && (err != -EALREADY)) {
+			LOG_WRN("bt_conn_le_data_len_update returned error: %d", err);
+		}
+	}
+
+	if (IS_ENABLED(CONFIG_BT_USER_PHY_UPDATE)) {
+		err = bt_conn_le_phy_update(ctx->conn, BT_CONN_LE_PHY_PARAM_2M);
+		if (err && (err != -EALREADY)) {
+			LOG_WRN("bt_conn_le_phy_update returned error: %d", err);
+		}
+	}
+
+#if defined(CONFIG_BT_GATT_CLIENT)
+	ctx->mtu_params.func = mtu_exchange_cb;
+
+	err = bt_gatt_exchange_mtu(ctx->conn, &ctx->mtu_params);
+	if (err && (err != -EALREADY)) {
+		LOG_WRN("bt_gatt_exchange_mtu returned error: %d", err);
+	}
+#endif
+}
+
+static void conn_param_request(struct bt_conn *conn, const struct bt_le_conn_param *param)
+{
+	int err;
+	struct bt_conn_info info;
+
+	err = bt_conn_get_info(conn, &info);
+	if (err) {
+		LOG_ERR("bt_conn_get_info returned error: %d", err);
+		return;
+	}
+
+	if ((info.le.interval >= param->interval_min) &&
+	    (info.le.interval <= param->interval_max) &&
+	    (info.le.latency == param->latency)) {
+		return;
+	}
+
+	err = bt_conn_le_param_update(conn, param);
+	if (err) {
+		LOG_WRN("bt_conn_le_param_update returned error: %d", err);
+	}
+}
+
+static void update_work_handle(struct k_work *item)
+{
+	struct conn_param_ctx *ctx = CONTAINER_OF(item, struct conn_param_ctx, update_work);
+
+	if (!ctx->conn) {
+		return;
+	}
+
+	if (atomic_test_bit(ctx->flags, CTX_FLAG_BULK)) {
+		if (!atomic_test_and_set_bit(ctx->flags, CTX_FLAG_LINK_SETUP_DONE)) {
+			link_setup(ctx);
+		}
+
+		LOG_DBG("fmna_conn_param: requesting bulk transfer parameters");
+		conn_param_request(ctx->conn, &bulk_param);
+	} else {
+		LOG_DBG("fmna_conn_param: requesting idle link parameters");
+		conn_param_request(ctx->conn, &idle_param);
+	}
+}
+
+static void idle_work_handle(struct k_work *item)
+{
+	struct k_work_delayable *work_d = k_work_delayable_from_work(item);
+	struct conn_param_ctx *ctx = CONTAINER_OF(work_d, struct conn_param_ctx, idle_work);
+
+	atomic_clear_bit(ctx->flags, CTX_FLAG_BULK);
+	k_work_submit(&ctx->update_work);
+}
+
+void fmna_conn_param_activity(struct bt_conn *conn)
+{
+	struct conn_param_ctx *ctx = &ctxs[bt_conn_index(conn)];
+
+	if (ctx->conn != conn) {
+		return;
+	}
+
+	if (!atomic_test_and_set_bit(ctx->flags, CTX_FLAG_BULK)) {
+		k_work_submit(&ctx->update_work);
+	}
+
+	k_work_reschedule(&ctx->idle_work, IDLE_TIMEOUT);
+}
+
+static void peer_connected(struct bt_conn *conn)
+{
+	struct conn_param_ctx *ctx = &ctxs[bt_conn_index(conn)];
+
+	ctx->conn = bt_conn_ref(conn);
+	atomic_clear(ctx->flags);
+	k_work_init(&ctx->update_work, update_work_handle);
+	k_work_init_delayable(&ctx->idle_work, idle_work_handle);
+
+	/* Start with the bulk parameters to speed up the service discovery and
+	 * the pairing or the owner connection setup.
+	 */
+	fmna_conn_param_activity(conn);
+}
+
+static void peer_disconnected(struct bt_conn *conn)
+{
+	struct conn_param_ctx *ctx = &ctxs[bt_conn_index(conn)];
+
+	if (ctx->conn != conn) {
+		return;
+	}
+
+	/* The works run on the same work queue as this event handler. */
+	(void)k_work_cancel_delayable(&ctx->idle_work);
+	(void)k_work_cancel(&ctx->update_work);
+
+	bt_conn_unref(ctx->conn);
+	ctx->conn = NULL;
+}
+
+static bool app_event_handler(const struct app_event_header *aeh)
+{
+	if (is_fmna_event(aeh)) {
+		struct fmna_event *event = cast_fmna_event(aeh);
+
+		switch (event->id) {
+		case FMNA_EVENT_PEER_CONNECTED:
+			peer_connected(event->conn);
+			break;
+		case FMNA_EVENT_PEER_DISCONNECTED:
+			peer_disconnected(event->conn);
+			break;
+		default:
+			break;
+		}
+
+		return false;
+	}
+
+	return false;
+}
+
+APP_EVENT_LISTENER(fmna_conn_param, app_event_handler);
+APP_EVENT_SUBSCRIBE(fmna_conn_param, fmna_event);
@@ -0,0 +1,28 @@
+/*
+ * Copyright (c) 2021 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-4-Clause
+ */
+
+#ifndef FMNA_CONN_PARAM_H_
+#define FMNA_CONN_PARAM_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <zephyr/kernel.h>
+#include <zephyr/bluetooth/conn.h>
+
+/* Report bulk traffic (pairing or UARP) on the connection. The link is kept
+ * with the high-throughput parameters until no traffic is reported for the
+ * idle timeout. Safe to call from the Bluetooth RX context.
+ */
+void fmna_conn_param_activity(struct bt_conn *conn);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* FMNA_CONN_PARAM_H_ */
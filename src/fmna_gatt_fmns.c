@@ -8,6 +8,7 @@
 #include <zephyr/kernel.h>
 
 #include "fmna_conn.h"
+#include "fmna_conn_param.h"
 #include "fmna_gatt_fmns.h"
 #include "fmna_gatt_pkt_manager.h"
 #include "fmna_state.h"
@@ -53,6 +54,11 @@ LOG_MODULE_DECLARE(fmna, CONFIG_FMNA_LOG_LEVEL);
 
 #define FMNS_OPCODE_NONE 0x0000
 
+/* One buffer for the packet being reassembled and one for the packet that
+ * is processed by the pairing module.
+ */
+#define PAIRING_BUF_COUNT 2
+
 enum pairing_cp_opcode {
 	PAIRING_CP_OPCODE_BASE                 = 0x0100,
 	PAIRING_CP_OPCODE_INITIATE_PAIRING     = 0x0100,
@@ -106,17 +112,57 @@ enum debug_cp_opcode {
 	DEBUG_CP_OPCODE_UT_MOTION_TIMERS_CONFIG  = 0x0505,
 };
 
-struct ind_packet {
-	void *fifo_reserved;
+/* Metadata of a queued indication, stored in the net_buf user data. The buffer
+ * data holds the indication payload without the opcode.
+ */
+struct ind_packet_meta {
 	struct bt_conn *conn;
 	const struct bt_gatt_attr *attr;
 	uint16_t opcode;
-	uint8_t data[FMNA_GATT_PKT_MAX_LEN];
-	uint16_t len;
 };
 
-static K_FIFO_DEFINE(fifo_ind_data);
-NET_BUF_SIMPLE_DEFINE_STATIC(cp_ind_buf, FMNA_GATT_PKT_MAX_LEN);
+NET_BUF_POOL_FIXED_DEFINE(pairing_buf_pool, PAIRING_BUF_COUNT, FMNA_GATT_PKT_MAX_LEN, 0, NULL);
+
+NET_BUF_POOL_VAR_DEFINE(ind_packet_pool, CONFIG_FMNA_GATT_IND_QUEUE_COUNT,
+			CONFIG_FMNA_GATT_IND_QUEUE_DATA_SIZE, sizeof(struct ind_packet_meta),
+			NULL);
+
+/* Indication streams of a single connection. With Enhanced ATT, the Config CP
+ * indications (key rolls, status updates and command responses) use their own
+ * stream, so they can be outstanding on another bearer while a long packet is
+ * transferred on the other control points.
+ */
+enum cp_ind_stream {
+	CP_IND_STREAM_DEFAULT,
+#if CONFIG_FMNA_GATT_EATT
+	CP_IND_STREAM_CONFIG,
+#endif
+	CP_IND_STREAM_COUNT,
+};
+
+/* Indication state kept separately for each connection and stream, so that
+ * the ACK chain of one peer does not delay indications addressed to another
+ * peer.
+ */
+struct cp_ind_ctx {
+	struct bt_gatt_indicate_params params;
+	struct net_buf_simple buf;
+	uint8_t buf_data[FMNA_GATT_PKT_MAX_LEN];
+	sys_slist_t queue;
+};
+
+/* Indication streams of a Find My connection. The slot is bound to the
+ * connection on its first indication and released on the disconnection,
+ * so the number of the packet buffers follows the Find My connection limit.
+ */
+struct cp_ind_slot {
+	struct bt_conn *conn;
+	struct cp_ind_ctx streams[CP_IND_STREAM_COUNT];
+};
+
+static struct cp_ind_slot cp_ind_slots[CONFIG_FMNA_MAX_CONN];
+static struct k_spinlock cp_ind_queue_lock;
+static struct fmna_gatt_ind_queue_stats cp_ind_queue_stats;
 
 static void pairing_cp_ccc_cfg_changed(const struct bt_gatt_attr *attr,
 				       uint16_t value)
@@ -163,7 +209,7 @@ static ssize_t pairing_cp_write(struct bt_conn *conn,
 	int err;
 	bool pkt_complete;
 
-	NET_BUF_SIMPLE_DEFINE_STATIC(pairing_buf, FMNA_GATT_PKT_MAX_LEN);
+	static struct net_buf *pairing_buf;
 
 	LOG_INF("FMN Pairing CP write, handle: %u, conn: %p, len: %d",
 		attr->handle, (void *) conn, len);
@@ -178,7 +224,19 @@ static ssize_t pairing_cp_write(struct bt_conn *conn,
 		return BT_GATT_ERR(BT_ATT_ERR_WRITE_NOT_PERMITTED);
 	}
 
-	err = fmna_gatt_pkt_manager_chunk_collect(&pairing_buf, buf, len, &pkt_complete);
+	if (IS_ENABLED(CONFIG_FMNA_CONN_PARAM)) {
+		fmna_conn_param_activity(conn);
+	}
+
+	if (!pairing_buf) {
+		pairing_buf = net_buf_alloc(&pairing_buf_pool, K_NO_WAIT);
+		if (!pairing_buf) {
+			LOG_ERR("FMN Pairing CP write: no free reassembly buffer");
+			return BT_GATT_ERR(BT_ATT_ERR_INSUFFICIENT_RESOURCES);
+		}
+	}
+
+	err = fmna_gatt_pkt_manager_chunk_collect(&pairing_buf->b, buf, len, &pkt_complete);
 	if (err) {
 		LOG_ERR("fmna_gatt_pkt_manager_chunk_collect: returned error: %d", err);
 		return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
@@ -188,10 +246,10 @@ static ssize_t pairing_cp_write(struct bt_conn *conn,
 		uint16_t opcode;
 		enum fmna_pair_event_id id;
 
-		LOG_HEXDUMP_INF(pairing_buf.data, pairing_buf.len, "Pairing packet:");
-		LOG_INF("Total packet length: %d", pairing_buf.len);
+		LOG_HEXDUMP_INF(pairing_buf->data, pairing_buf->len, "Pairing packet:");
+		LOG_INF("Total packet length: %d", pairing_buf->len);
 
-		opcode = net_buf_simple_pull_le16(&pairing_buf);
+		opcode = net_buf_pull_le16(pairing_buf);
 		switch (opcode) {
 		case PAIRING_CP_OPCODE_INITIATE_PAIRING:
 			id = FMNA_PAIR_EVENT_INITIATE_PAIRING;
@@ -205,20 +263,22 @@ static ssize_t pairing_cp_write(struct bt_conn *conn,
 		default:
 			LOG_ERR("FMN Pairing CP, unexpected opcode: 0x%02X",
 				opcode);
-			net_buf_simple_reset(&pairing_buf);
+			net_buf_reset(pairing_buf);
 			return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
 		}
 
 		struct fmna_pair_event *event = new_fmna_pair_event();
 
+		/* Pass the reassembly buffer to the pairing module without copying it.
+		 * The next packet is collected in a new buffer from the pool.
+		 */
 		event->id = id;
 		event->conn = conn;
-		event->buf.len = pairing_buf.len;
-		memcpy(event->buf.data, pairing_buf.data, pairing_buf.len);
+		event->buf = pairing_buf;
 
 		APP_EVENT_SUBMIT(event);
 
-		net_buf_simple_reset(&pairing_buf);
+		pairing_buf = NULL;
 	}
 
 	return len;
@@ -836,55 +896,165 @@ static struct bt_gatt_service fmns_svc = BT_GATT_SERVICE(fmns_svc_attrs);
 BT_GATT_SERVICE_DEFINE(fmns_svc, FMNA_ATTRS);
 #endif
 
-static int cp_indicate(struct bt_conn *conn,
-		       const struct bt_gatt_attr *attr,
-		       uint16_t opcode,
-		       struct net_buf_simple *buf);
+static int cp_ctx_indicate(struct cp_ind_ctx *ctx,
+			   struct bt_conn *conn,
+			   const struct bt_gatt_attr *attr,
+			   uint16_t opcode,
+			   struct net_buf_simple *buf);
+
+static enum cp_ind_stream cp_ind_stream_get(struct bt_conn *conn, const struct bt_gatt_attr *attr)
+{
+#if CONFIG_FMNA_GATT_EATT
+	/* Keep a single stream on links without the enhanced bearers, as the
+	 * unenhanced bearer allows only one outstanding indication anyway.
+	 */
+	if ((attr == &fmns_svc.attrs[FMNS_CONFIG_CHAR_INDEX]) && (bt_eatt_count(conn) > 0)) {
+		return CP_IND_STREAM_CONFIG;
+	}
+#endif
+
+	return CP_IND_STREAM_DEFAULT;
+}
+
+static struct cp_ind_slot *cp_ind_slot_get(struct bt_conn *conn, bool bind)
+{
+	struct cp_ind_slot *slot = NULL;
+	struct cp_ind_slot *free_slot = NULL;
+	k_spinlock_key_t key = k_spin_lock(&cp_ind_queue_lock);
+
+	for (size_t i = 0; i < ARRAY_SIZE(cp_ind_slots); i++) {
+		if (cp_ind_slots[i].conn == conn) {
+			slot = &cp_ind_slots[i];
+			break;
+		}
+
+		if (!free_slot && !cp_ind_slots[i].conn) {
+			free_slot = &cp_ind_slots[i];
+		}
+	}
+
+	if (!slot && bind && free_slot) {
+		slot = free_slot;
+		slot->conn = conn;
+	}
+
+	k_spin_unlock(&cp_ind_queue_lock, key);
+
+	return slot;
+}
+
+static void cp_ind_slot_release(struct cp_ind_slot *slot)
+{
+	k_spinlock_key_t key = k_spin_lock(&cp_ind_queue_lock);
+
+	slot->conn = NULL;
+
+	k_spin_unlock(&cp_ind_queue_lock, key);
+}
+
+static struct cp_ind_ctx *cp_ind_ctx_get(struct cp_ind_slot *slot, enum cp_ind_stream stream)
+{
+	struct cp_ind_ctx *ctx = &slot->streams[stream];
+
+	if (!ctx->buf.__buf) {
+		net_buf_simple_init_with_data(&ctx->buf, ctx->buf_data, sizeof(ctx->buf_data));
+		net_buf_simple_reset(&ctx->buf);
+	}
+
+	return ctx;
+}
+
+static void cp_ind_queue_put(struct cp_ind_ctx *ctx, struct net_buf *ind_packet)
+{
+	k_spinlock_key_t key = k_spin_lock(&cp_ind_queue_lock);
+
+	sys_slist_append(&ctx->queue, &ind_packet->node);
+
+	cp_ind_queue_stats.depth++;
+	if (cp_ind_queue_stats.depth > cp_ind_queue_stats.high_water) {
+		cp_ind_queue_stats.high_water = cp_ind_queue_stats.depth;
+	}
 
-static void cp_ind_queue_process(void)
+	k_spin_unlock(&cp_ind_queue_lock, key);
+}
+
+static struct net_buf *cp_ind_queue_get(struct cp_ind_ctx *ctx)
+{
+	sys_snode_t *node;
+	k_spinlock_key_t key = k_spin_lock(&cp_ind_queue_lock);
+
+	node = sys_slist_get(&ctx->queue);
+	if (node) {
+		cp_ind_queue_stats.depth--;
+	}
+
+	k_spin_unlock(&cp_ind_queue_lock, key);
+
+	return node ? CONTAINER_OF(node, struct net_buf, node) : NULL;
+}
+
+static void cp_ind_queue_drop_count(void)
+{
+	k_spinlock_key_t key = k_spin_lock(&cp_ind_queue_lock);
+
+	cp_ind_queue_stats.drops++;
+
+	k_spin_unlock(&cp_ind_queue_lock, key);
+}
+
+static void cp_ind_queue_process(struct cp_ind_ctx *ctx)
 {
 	int err;
-	struct ind_packet *ind_packet;
-	NET_BUF_SIMPLE_DEFINE(data_buf, FMNA_GATT_PKT_MAX_LEN);
+	struct net_buf *ind_packet;
+	struct ind_packet_meta *meta;
 
-	ind_packet = k_fifo_get(&fifo_ind_data, K_NO_WAIT);
+	ind_packet = cp_ind_queue_get(ctx);
 	while (ind_packet) {
 		LOG_INF("FMN GATT: Processing indication queue");
 
-		net_buf_simple_reset(&data_buf);
-		net_buf_simple_add_mem(&data_buf, ind_packet->data, ind_packet->len);
-
-		err = cp_indicate(ind_packet->conn,
-				  ind_packet->attr,
-				  ind_packet->opcode,
-				  &data_buf);
-		k_free(ind_packet);
+		meta = net_buf_user_data(ind_packet);
+		err = cp_ctx_indicate(ctx,
+				      meta->conn,
+				      meta->attr,
+				      meta->opcode,
+				      &ind_packet->b);
+		net_buf_unref(ind_packet);
 
 		if (err) {
-			LOG_ERR("FMN GATT: cp_indicate returned error: %d", err);
+			LOG_ERR("FMN GATT: cp_ctx_indicate returned error: %d", err);
 
-			ind_packet = k_fifo_get(&fifo_ind_data, K_NO_WAIT);
+			ind_packet = cp_ind_queue_get(ctx);
 		} else {
 			return;
 		}
 	}
 }
 
+static void cp_ind_queue_flush(struct cp_ind_ctx *ctx)
+{
+	struct net_buf *ind_packet;
+
+	while ((ind_packet = cp_ind_queue_get(ctx))) {
+		net_buf_unref(ind_packet);
+	}
+}
+
 static void cp_ind_cb(struct bt_conn *conn, struct bt_gatt_indicate_params *params, uint8_t err)
 {
 	uint8_t *ind_data;
 	uint16_t ind_data_len;
+	struct cp_ind_ctx *ctx = CONTAINER_OF(params, struct cp_ind_ctx, params);
 
 	LOG_INF("Received FMN CP indication ACK with status: 0x%04X", err);
 
-	ind_data = fmna_gatt_pkt_manager_chunk_prepare(conn, &cp_ind_buf, &ind_data_len);
+	ind_data = fmna_gatt_pkt_manager_chunk_prepare(conn, &ctx->buf, &ind_data_len);
 	if (!ind_data) {
 		/* Release the buffer when there is not more data
 		 * to be sent for the whole packet transmission.
 		 */
-		net_buf_simple_reset(&cp_ind_buf);
+		net_buf_simple_reset(&ctx->buf);
 
-		cp_ind_queue_process();
+		cp_ind_queue_process(ctx);
 	} else {
 		params->data = ind_data;
 		params->len = ind_data_len;
@@ -896,31 +1066,39 @@ static void cp_ind_cb(struct bt_conn *conn, struct bt_gatt_indicate_params *para
 	}
 }
 
-static int cp_indicate(struct bt_conn *conn,
-		       const struct bt_gatt_attr *attr,
-		       uint16_t opcode,
-		       struct net_buf_simple *buf)
+static int cp_ctx_indicate(struct cp_ind_ctx *ctx,
+			   struct bt_conn *conn,
+			   const struct bt_gatt_attr *attr,
+			   uint16_t opcode,
+			   struct net_buf_simple *buf)
 {
-	if (net_buf_simple_headroom(&cp_ind_buf) != 0) {
-		/* Indication sending in progress. Queue the next item. */
-		struct ind_packet *ind_packet;
-
-		if (buf->len > sizeof(ind_packet->data)) {
+	if (net_buf_simple_headroom(&ctx->buf) != 0) {
+		/* Indication sending in progress on this stream. Queue the next item. */
+		struct net_buf *ind_packet;
+		struct ind_packet_meta *meta;
+
+		if (buf->len > (FMNA_GATT_PKT_MAX_LEN - FMNA_GATT_PKT_HEADER_LEN -
+				FMNA_GATT_COMMAND_OPCODE_LEN)) {
+			cp_ind_queue_drop_count();
 			return -ENOMEM;
 		}
 
-		ind_packet = k_malloc(sizeof(*ind_packet));
+		/* Allocate only as much of the pool as the indication payload needs. */
+		ind_packet = net_buf_alloc_len(&ind_packet_pool, buf->len, K_NO_WAIT);
 		if (!ind_packet) {
+			LOG_WRN("FMN GATT: Indication queue full, dropping indication");
+
+			cp_ind_queue_drop_count();
 			return -ENOMEM;
 		}
 
-		ind_packet->conn = conn;
-		ind_packet->attr = attr;
-		ind_packet->opcode = opcode;
-		ind_packet->len = buf->len;
-		memcpy(ind_packet->data, buf->data, buf->len);
+		meta = net_buf_user_data(ind_packet);
+		meta->conn = conn;
+		meta->attr = attr;
+		meta->opcode = opcode;
+		net_buf_add_mem(ind_packet, buf->data, buf->len);
 
-		k_fifo_put(&fifo_ind_data, ind_packet);
+		cp_ind_queue_put(ctx, ind_packet);
 
 		LOG_INF("FMN GATT: Adding indication to the queue");
 
@@ -930,33 +1108,31 @@ static int cp_indicate(struct bt_conn *conn,
 		uint8_t *ind_data;
 		uint16_t ind_data_len;
 
-		static struct bt_gatt_indicate_params indicate_params;
-
 		/* Initialize buffer for sending. */
-		net_buf_simple_reset(&cp_ind_buf);
-		net_buf_simple_reserve(&cp_ind_buf, FMNA_GATT_PKT_HEADER_LEN);
-		net_buf_simple_add_le16(&cp_ind_buf, opcode);
-		net_buf_simple_add_mem(&cp_ind_buf, buf->data, buf->len);
+		net_buf_simple_reset(&ctx->buf);
+		net_buf_simple_reserve(&ctx->buf, FMNA_GATT_PKT_HEADER_LEN);
+		net_buf_simple_add_le16(&ctx->buf, opcode);
+		net_buf_simple_add_mem(&ctx->buf, buf->data, buf->len);
 
-		ind_data = fmna_gatt_pkt_manager_chunk_prepare(conn, &cp_ind_buf, &ind_data_len);
+		ind_data = fmna_gatt_pkt_manager_chunk_prepare(conn, &ctx->buf, &ind_data_len);
 		if (!ind_data) {
 			LOG_ERR("fmna_gatt_pkt_manager_chunk_prepare failed");
 
-			net_buf_simple_reset(&cp_ind_buf);
+			net_buf_simple_reset(&ctx->buf);
 			return -EINVAL;
 		}
 
-		memset(&indicate_params, 0, sizeof(indicate_params));
-		indicate_params.attr = attr;
-		indicate_params.func = cp_ind_cb;
-		indicate_params.data = ind_data;
-		indicate_params.len = ind_data_len;
+		memset(&ctx->params, 0, sizeof(ctx->params));
+		ctx->params.attr = attr;
+		ctx->params.func = cp_ind_cb;
+		ctx->params.data = ind_data;
+		ctx->params.len = ind_data_len;
 
-		err = bt_gatt_indicate(conn, &indicate_params);
+		err = bt_gatt_indicate(conn, &ctx->params);
 		if (err) {
 			LOG_ERR("bt_gatt_indicate returned error: %d", err);
 
-			net_buf_simple_reset(&cp_ind_buf);
+			net_buf_simple_reset(&ctx->buf);
 			return err;
 		}
 
@@ -964,6 +1140,71 @@ static int cp_indicate(struct bt_conn *conn,
 	}
 }
 
+static int cp_indicate(struct bt_conn *conn,
+		       const struct bt_gatt_attr *attr,
+		       uint16_t opcode,
+		       struct net_buf_simple *buf)
+{
+	struct cp_ind_ctx *ctx;
+	struct cp_ind_slot *slot = cp_ind_slot_get(conn, true);
+
+	if (!slot) {
+		LOG_ERR("FMN GATT: No indication slot left for conn: %p", (void *) conn);
+		return -ENOMEM;
+	}
+
+	ctx = cp_ind_ctx_get(slot, cp_ind_stream_get(conn, attr));
+
+	return cp_ctx_indicate(ctx, conn, attr, opcode, buf);
+}
+
+static void cp_ind_queue_stats_log(void)
+{
+	struct fmna_gatt_ind_queue_stats stats;
+
+	fmna_gatt_ind_queue_stats_get(&stats);
+
+	LOG_DBG("FMN GATT indication queue: depth %u, high water %u, drops %u",
+		stats.depth, stats.high_water, stats.drops);
+}
+
+static void disconnected(struct bt_conn *conn, uint8_t reason)
+{
+	struct cp_ind_ctx *ctx;
+	struct cp_ind_slot *slot = cp_ind_slot_get(conn, false);
+
+	if (!slot) {
+		return;
+	}
+
+	/* Drop indications that were queued for the disconnected peer and release
+	 * the buffers so that the next connection using this slot starts clean.
+	 */
+	for (size_t i = 0; i < CP_IND_STREAM_COUNT; i++) {
+		ctx = cp_ind_ctx_get(slot, i);
+
+		cp_ind_queue_flush(ctx);
+		net_buf_simple_reset(&ctx->buf);
+	}
+
+	cp_ind_slot_release(slot);
+
+	cp_ind_queue_stats_log();
+}
+
+BT_CONN_CB_DEFINE(fmns_conn_callbacks) = {
+	.disconnected = disconnected,
+};
+
+void fmna_gatt_ind_queue_stats_get(struct fmna_gatt_ind_queue_stats *stats)
+{
+	k_spinlock_key_t key = k_spin_lock(&cp_ind_queue_lock);
+
+	*stats = cp_ind_queue_stats;
+
+	k_spin_unlock(&cp_ind_queue_lock, key);
+}
+
 int fmna_gatt_pairing_cp_indicate(struct bt_conn *conn,
 				  enum fmna_gatt_pairing_ind ind_type,
 				  struct net_buf_simple *buf)
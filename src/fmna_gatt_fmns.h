@@ -71,6 +71,15 @@ enum fmna_gatt_response_status {
 	FMNA_GATT_RESPONSE_STATUS_INVALID_COMMAND       = 0xFFFF,
 };
 
+struct fmna_gatt_ind_queue_stats {
+	/* Number of indications currently waiting in the queue. */
+	uint32_t depth;
+	/* Highest number of indications waiting in the queue at the same time. */
+	uint32_t high_water;
+	/* Number of indications dropped because the queue was full. */
+	uint32_t drops;
+};
+
 int fmna_gatt_pairing_cp_indicate(struct bt_conn *conn,
 				  enum fmna_gatt_pairing_ind ind_type,
 				  struct net_buf_simple *buf);
@@ -93,6 +102,8 @@ int fmna_gatt_debug_cp_indicate(struct bt_conn *conn,
 
 int fmna_gatt_service_hidden_mode_set(bool hidden_mode);
 
+void fmna_gatt_ind_queue_stats_get(struct fmna_gatt_ind_queue_stats *stats);
+
 uint16_t fmna_config_event_to_gatt_cmd_opcode(enum fmna_config_event_id config_event);
 
 uint16_t fmna_non_owner_event_to_gatt_cmd_opcode(enum fmna_non_owner_event_id non_owner_event);
@@ -9,6 +9,7 @@
 #include <zephyr/init.h>
 
 #include "events/fmna_event.h"
+#include "fmna_adv_policy.h"
 #include "fmna_gatt_fmns.h"
 #include "fmna_sound.h"
 #include "fmna_state.h"
@@ -135,6 +136,8 @@ static void motion_poll_handle(void)
 
 	motion_detected = user_cb->motion_detection_period_expired();
 	if (motion_detected) {
+		fmna_adv_policy_motion_report();
+
 		/* Restart the timer again after a sound playing action. */
 		k_timer_stop(&motion_poll_timer);
 
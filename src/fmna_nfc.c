@@ -48,6 +48,10 @@ static struct sn_counter_update {
 	atomic_t increment;
 } sn_counter_update;
 
+static void field_detected_work_handle(struct k_work *item);
+
+static K_WORK_DEFINE(field_detected_work, field_detected_work_handle);
+
 static void nfc_callback(void *context,
 			 nfc_t2t_event_t event,
 			 const uint8_t *data,
@@ -58,6 +62,12 @@ static void nfc_callback(void *context,
 	ARG_UNUSED(data_length);
 
 	switch (event) {
+	case NFC_T2T_EVENT_FIELD_ON:
+		if (!paired_state) {
+			k_work_submit(&field_detected_work);
+		}
+
+		break;
 	case NFC_T2T_EVENT_DATA_READ:
 		LOG_DBG("FMN NFC: NDEF payload read");
 
@@ -72,6 +82,14 @@ static void nfc_callback(void *context,
 	}
 }
 
+static void field_detected_work_handle(struct k_work *item)
+{
+	LOG_DBG("FMN NFC: Field detected");
+
+	FMNA_EVENT_CREATE(event, FMNA_EVENT_NFC_FIELD_DETECTED, NULL);
+	APP_EVENT_SUBMIT(event);
+}
+
 static void sn_counter_update_work_handle(struct k_work *item)
 {
 	int err;
@@ -319,6 +337,7 @@ int fmna_nfc_uninit(void)
 	 * and the workqueue item is already being executed.
 	 */
 	k_work_cancel_delayable(&sn_counter_update.work);
+	k_work_cancel(&field_detected_work);
 	atomic_clear(&sn_counter_update.increment);
 
 	LOG_INF("FMN NFC: NFC capability is disabled");
@@ -405,11 +405,19 @@ static int pairing_status_generate(struct net_buf_simple *buf)
 	return err;
 }
 
+/* Reuse the command buffer for the response. The command parameters stay in
+ * the buffer memory and are consumed before the response overwrites them.
+ */
+static void cmd_buf_response_prepare(struct net_buf *buf)
+{
+	net_buf_reset(buf);
+	net_buf_reserve(buf, FMNA_GATT_COMMAND_OPCODE_LEN);
+}
+
 static void initiate_pairing_cmd_handle(struct bt_conn *conn,
-					struct fmna_pair_buf *buf)
+					struct net_buf *buf)
 {
 	int err;
-	struct net_buf_simple buf_desc;
 
 	LOG_INF("FMNA: RX: Initiate pairing command");
 
@@ -421,11 +429,9 @@ static void initiate_pairing_cmd_handle(struct bt_conn *conn,
 		return;
 	}
 
-	/* Initialize buffer descriptor */
-	net_buf_simple_init_with_data(&buf_desc, buf->data, sizeof(buf->data));
-	net_buf_simple_reset(&buf_desc);
+	cmd_buf_response_prepare(buf);
 
-	err = pairing_data_generate(&buf_desc);
+	err = pairing_data_generate(&buf->b);
 	if (err) {
 		LOG_ERR("pairing_data_generate returned error: %d", err);
 
@@ -433,17 +439,16 @@ static void initiate_pairing_cmd_handle(struct bt_conn *conn,
 		return;
 	}
 
-	err = fmna_gatt_pairing_cp_indicate(conn, FMNA_GATT_PAIRING_DATA_IND, &buf_desc);
+	err = fmna_gatt_pairing_cp_indicate(conn, FMNA_GATT_PAIRING_DATA_IND, &buf->b);
 	if (err) {
 		LOG_ERR("fmns_pairing_data_indicate returned error: %d", err);
 	}
 }
 
 static void finalize_pairing_cmd_handle(struct bt_conn *conn,
-					struct fmna_pair_buf *buf)
+					struct net_buf *buf)
 {
 	int err;
-	struct net_buf_simple buf_desc;
 
 	LOG_INF("FMNA: RX: Finalize pairing command");
 
@@ -455,11 +460,9 @@ static void finalize_pairing_cmd_handle(struct bt_conn *conn,
 		return;
 	}
 
-	/* Initialize buffer descriptor */
-	net_buf_simple_init_with_data(&buf_desc, buf->data, sizeof(buf->data));
-	net_buf_simple_reset(&buf_desc);
+	cmd_buf_response_prepare(buf);
 
-	err = pairing_status_generate(&buf_desc);
+	err = pairing_status_generate(&buf->b);
 	if (err) {
 		LOG_ERR("pairing_status_generate returned error: %d",
 			err);
@@ -468,7 +471,7 @@ static void finalize_pairing_cmd_handle(struct bt_conn *conn,
 		return;
 	}
 
-	err = fmna_gatt_pairing_cp_indicate(conn, FMNA_GATT_PAIRING_STATUS_IND, &buf_desc);
+	err = fmna_gatt_pairing_cp_indicate(conn, FMNA_GATT_PAIRING_STATUS_IND, &buf->b);
 	if (err) {
 		LOG_ERR("fmns_pairing_status_indicate returned error: %d",
 			err);
@@ -476,7 +479,7 @@ static void finalize_pairing_cmd_handle(struct bt_conn *conn,
 }
 
 static void pairing_complete_cmd_handle(struct bt_conn *conn,
-					struct fmna_pair_buf *buf)
+					struct net_buf *buf)
 {
 	int err;
 	struct fmna_keys_init init_keys = {0};
@@ -590,19 +593,22 @@ static bool app_event_handler(const struct app_event_header *aeh)
 
 		switch (event->id) {
 		case FMNA_PAIR_EVENT_INITIATE_PAIRING:
-			initiate_pairing_cmd_handle(event->conn, &event->buf);
+			initiate_pairing_cmd_handle(event->conn, event->buf);
 			break;
 		case FMNA_PAIR_EVENT_FINALIZE_PAIRING:
-			finalize_pairing_cmd_handle(event->conn, &event->buf);
+			finalize_pairing_cmd_handle(event->conn, event->buf);
 			break;
 		case FMNA_PAIR_EVENT_PAIRING_COMPLETE:
-			pairing_complete_cmd_handle(event->conn,&event->buf);
+			pairing_complete_cmd_handle(event->conn, event->buf);
 			break;
 		default:
 			LOG_ERR("FMNA: unexpected pairing command opcode: 0x%02X",
 				event->id);
 		}
 
+		/* Return the command buffer to the GATT reassembly pool. */
+		net_buf_unref(event->buf);
+
 		return false;
 	}
 
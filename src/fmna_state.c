@@ -7,6 +7,7 @@
 #include "events/fmna_event.h"
 #include "events/fmna_config_event.h"
 #include "fmna_adv.h"
+#include "fmna_adv_policy.h"
 #include "fmna_conn.h"
 #include "fmna_gatt_fmns.h"
 #include "fmna_keys.h"
@@ -254,6 +255,8 @@ static int state_set(struct bt_conn *conn, enum fmna_state new_state)
 						K_SECONDS(CONFIG_FMNA_PAIRING_MODE_TIMEOUT));
 			}
 
+			fmna_adv_policy_pairing_backoff_start();
+
 			err = unpaired_adv_start(true);
 			if (err) {
 				LOG_ERR("unpaired_adv_start returned error: %d", err);
@@ -273,6 +276,7 @@ static int state_set(struct bt_conn *conn, enum fmna_state new_state)
 		if (prev_state == FMNA_STATE_UNPAIRED) {
 			pairing_mode = false;
 			k_work_cancel_delayable(&pairing_mode_timeout_work);
+			fmna_adv_policy_pairing_backoff_stop();
 		}
 
 		is_maintained = true;
@@ -346,6 +350,7 @@ static int state_set(struct bt_conn *conn, enum fmna_state new_state)
 		k_work_cancel(&nearby_separated_work);
 		k_work_cancel_delayable(&persistent_conn_work);
 		k_work_cancel_delayable(&pairing_mode_timeout_work);
+		fmna_adv_policy_pairing_backoff_stop();
 
 		/* Stop the key service if necessary. */
 		if (prev_state != FMNA_STATE_UNPAIRED) {
@@ -432,6 +437,7 @@ static void pairing_mode_timeout_work_handle(struct k_work *item)
 	fmna_adv_stop();
 
 	pairing_mode = false;
+	fmna_adv_policy_pairing_backoff_stop();
 
 	if (pairing_mode_timeout_cb) {
 		pairing_mode_timeout_cb();
@@ -440,23 +446,8 @@ static void pairing_mode_timeout_work_handle(struct k_work *item)
 
 static bool all_owners_disconnected(struct bt_conn *conn)
 {
-	int err;
-	struct bt_conn *owners[CONFIG_BT_MAX_CONN];
-	uint8_t owners_num = ARRAY_SIZE(owners);
-
 	if (state == FMNA_STATE_CONNECTED) {
-		err = fmna_conn_owner_find(owners, &owners_num);
-		if (err) {
-			LOG_ERR("fmna_conn_owner_find returned error: %d", err);
-		}
-
-		for (size_t i = 0; i < owners_num; i++) {
-			if (owners[i] != conn) {
-				return false;
-			}
-		}
-
-		return true;
+		return !(fmna_conn_owner_bitmap_get() & ~BIT(bt_conn_index(conn)));
 	}
 
 	return false;
@@ -490,8 +481,13 @@ static void fmna_pairing_failed(void)
 
 	/* Regenerate the accessory address to work around the iOS issue
 	 * with the cached bond information. This API will also restart
-	 * pairing mode timeout.
+	 * pairing mode timeout. Return to the fast advertising stage as
+	 * the user is actively trying to pair the accessory.
 	 */
+	if (pairing_mode) {
+		fmna_adv_policy_pairing_backoff_start();
+	}
+
 	err = unpaired_adv_start(true);
 	if (err) {
 		LOG_ERR("unpaired_adv_start returned error: %d", err);
@@ -557,6 +553,7 @@ int fmna_pairing_mode_cancel(void)
 
 	pairing_mode = false;
 	k_work_cancel_delayable(&pairing_mode_timeout_work);
+	fmna_adv_policy_pairing_backoff_stop();
 
 	err = fmna_adv_stop();
 	if (err) {
@@ -582,6 +579,8 @@ int fmna_pairing_mode_enter(void)
 				  K_SECONDS(CONFIG_FMNA_PAIRING_MODE_TIMEOUT));
 	}
 
+	fmna_adv_policy_pairing_backoff_start();
+
 	err = unpaired_adv_start(true);
 	if (err) {
 		LOG_ERR("unpaired_adv_start returned error: %d", err);
@@ -700,7 +699,10 @@ static void fmna_public_keys_changed(struct fmna_public_keys_changed *keys_chang
 	/* Set the maintained status. */
 	is_maintained = (state == FMNA_STATE_CONNECTED);
 
-	/* Restart the advertising with a new key payload. */
+	/* Update the advertising with a new key payload. The FMN advertising
+	 * module enables the set with the new address before it disables the
+	 * current one when a free advertising set is available.
+	 */
 	if (state == FMNA_STATE_UNPAIRED) {
 		return;
 	}
@@ -841,6 +843,7 @@ static bool app_event_handler(const struct app_event_header *aeh)
 		struct fmna_event *event = cast_fmna_event(aeh);
 
 		switch (event->id) {
+		case FMNA_EVENT_ADV_POLICY_CHANGED:
 		case FMNA_EVENT_MAX_CONN_CHANGED:
 			advertise_restart_on_no_state_change();
 			break;
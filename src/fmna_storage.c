@@ -21,6 +21,9 @@ LOG_MODULE_DECLARE(fmna, CONFIG_FMNA_LOG_LEVEL);
 
 #define FMNA_STORAGE_BRANCH_PROVISIONING "provisioning"
 #define FMNA_STORAGE_BRANCH_PAIRING      "pairing"
+#define FMNA_STORAGE_BRANCH_UARP         "uarp"
+
+#define FMNA_STORAGE_UARP_CHECKPOINT_KEY "checkpoint"
 
 #define FMNA_STORAGE_PROVISIONING_SERIAL_NUMBER_KEY 997
 #define FMNA_STORAGE_PROVISIONING_UUID_KEY          998
@@ -255,6 +258,37 @@ int fmna_storage_pairing_data_delete(void)
 	return 0;
 }
 
+int fmna_storage_uarp_checkpoint_store(const uint8_t *checkpoint, size_t checkpoint_len)
+{
+	char *checkpoint_node = FMNA_STORAGE_LEAF_NODE_BUILD(
+		FMNA_STORAGE_BRANCH_UARP,
+		FMNA_STORAGE_UARP_CHECKPOINT_KEY);
+
+	return settings_save_one(checkpoint_node, checkpoint, checkpoint_len);
+}
+
+int fmna_storage_uarp_checkpoint_load(uint8_t *checkpoint, size_t checkpoint_len)
+{
+	char *checkpoint_node = FMNA_STORAGE_LEAF_NODE_BUILD(
+		FMNA_STORAGE_BRANCH_UARP,
+		FMNA_STORAGE_UARP_CHECKPOINT_KEY);
+	struct settings_item checkpoint_item = {
+		.buf = checkpoint,
+		.len = checkpoint_len,
+	};
+
+	return fmna_storage_direct_load(checkpoint_node, &checkpoint_item);
+}
+
+int fmna_storage_uarp_checkpoint_delete(void)
+{
+	char *checkpoint_node = FMNA_STORAGE_LEAF_NODE_BUILD(
+		FMNA_STORAGE_BRANCH_UARP,
+		FMNA_STORAGE_UARP_CHECKPOINT_KEY);
+
+	return settings_delete(checkpoint_node);
+}
+
 static int pairing_branch_load(const char      *key,
 			       size_t           len,
 			       settings_read_cb read_cb,
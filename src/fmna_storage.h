@@ -71,6 +71,14 @@ int fmna_storage_pairing_item_load(enum fmna_storage_pairing_item_id item_id,
 
 int fmna_storage_pairing_data_delete(void);
 
+/* API for accessing and manipulating the UARP transfer checkpoint. */
+
+int fmna_storage_uarp_checkpoint_store(const uint8_t *checkpoint, size_t checkpoint_len);
+
+int fmna_storage_uarp_checkpoint_load(uint8_t *checkpoint, size_t checkpoint_len);
+
+int fmna_storage_uarp_checkpoint_delete(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -93,6 +93,12 @@ static uint32_t uarpPlatformUpdatePayloadPayload( struct uarpPlatformAccessory *
                                                  struct uarpPlatformAsset *pAsset,
                                                  void *pBuffer, uint32_t lengthBuffer );
 
+#if UARP_PAYLOAD_STREAMING
+static void uarpPlatformUpdatePayloadChunk( struct uarpPlatformAccessory *pAccessory,
+                                           struct uarpPlatformAsset *pAsset,
+                                           void *pBuffer, uint32_t lengthBuffer );
+#endif
+
 static uint32_t uarpPlatformUpdateMetaData( struct uarpPlatformAccessory *pAccessory,
                                            struct uarpPlatformAsset *pAsset,
                                            void *pBuffer, uint32_t lengthBuffer,
@@ -255,6 +261,24 @@ __UARP_Verify_exit /* This resolves "exit:" if you have chosen to compile in __U
 
 /* -------------------------------------------------------------------------------- */
 
+uint32_t uarpPlatformAccessoryOptionsUpdate( struct uarpPlatformAccessory *pAccessory,
+                                            struct uarpPlatformOptionsObj *pOptions )
+{
+    uint32_t status;
+
+    __UARP_Verify_Action( pAccessory, exit, status = kUARPStatusInvalidArgument );
+    __UARP_Verify_Action( pOptions, exit, status = kUARPStatusInvalidArgument );
+
+    pAccessory->_options = *pOptions;
+
+    status = kUARPStatusSuccess;
+
+__UARP_Verify_exit /* This resolves "exit:" if you have chosen to compile in __UARP_Verify_Action */
+    return status;
+}
+
+/* -------------------------------------------------------------------------------- */
+
 uint32_t uarpPlatformControllerAdd( struct uarpPlatformAccessory *pAccessory,
                                    struct uarpPlatformController *pController,
                                    void *pControllerDelegate )
@@ -733,6 +757,14 @@ uint32_t uarpPlatformAccessoryPayloadRequestDataWithCookie( struct uarpPlatformA
     {
         length = pAsset->lengthScratchBuffer;
     }
+
+#if UARP_PAYLOAD_STREAMING
+    /* a window restarted after a pause or an orphaned transfer ends on the window boundary */
+    if ( length > pAsset->lengthScratchBuffer - ( pAsset->lengthPayloadRecvd % pAsset->lengthScratchBuffer ) )
+    {
+        length = pAsset->lengthScratchBuffer - ( pAsset->lengthPayloadRecvd % pAsset->lengthScratchBuffer );
+    }
+#endif
     
     /* call the lower edge */
     status = uarpPlatformAssetRequestData( pAccessory, pAsset,
@@ -950,7 +982,9 @@ uint32_t uarpPlatformUpdatePayloadPayload( struct uarpPlatformAccessory *pAccess
 {
     uint32_t status;
     struct uarpPayloadObj *pPayload;
+#if !(UARP_PAYLOAD_STREAMING)
     struct uarpPlatformAssetCookie cookie;
+#endif
     
     /* need to update what was coming from controller */
     pPayload = &(pAsset->payload);
@@ -960,6 +994,7 @@ uint32_t uarpPlatformUpdatePayloadPayload( struct uarpPlatformAccessory *pAccess
                 pPayload->payload4cc[2], pPayload->payload4cc[3],
                 lengthBuffer, pAsset->lengthPayloadRecvd );
 
+#if !(UARP_PAYLOAD_STREAMING)
     cookie.assetTag = pAsset->core.assetTag;
     cookie.assetVersion = pAsset->core.assetVersion;
     cookie.assetTotalLength = pAsset->core.assetTotalLength;
@@ -971,6 +1006,7 @@ uint32_t uarpPlatformUpdatePayloadPayload( struct uarpPlatformAccessory *pAccess
                                        pAsset->lengthPayloadRecvd, (void *)&cookie, sizeof( cookie ) );
 
     pAsset->lengthPayloadRecvd += lengthBuffer;
+#endif
     
     uarpLogInfo( kUARPLoggingCategoryPlatform, "Asset Payload <%c%c%c%c> Payload RX %u bytes of %u",
                 pPayload->payload4cc[0], pPayload->payload4cc[1],
@@ -1002,6 +1038,40 @@ uint32_t uarpPlatformUpdatePayloadPayload( struct uarpPlatformAccessory *pAccess
     return status;
 }
 
+#if UARP_PAYLOAD_STREAMING
+/* -------------------------------------------------------------------------------- */
+
+void uarpPlatformUpdatePayloadChunk( struct uarpPlatformAccessory *pAccessory,
+                                    struct uarpPlatformAsset *pAsset,
+                                    void *pBuffer, uint32_t lengthBuffer )
+{
+    uint32_t offset;
+    struct uarpPlatformAssetCookie cookie;
+
+    if ( lengthBuffer == 0 )
+    {
+        return;
+    }
+
+    /* the received length advances with every chunk, so a restarted window never repeats delivered data */
+    offset = pAsset->lengthPayloadRecvd;
+    pAsset->lengthPayloadRecvd += lengthBuffer;
+
+    uarpLogDebug( kUARPLoggingCategoryPlatform, "Asset Payload Rx Chunk %u bytes from offset %u",
+                 lengthBuffer, offset );
+
+    cookie.assetTag = pAsset->core.assetTag;
+    cookie.assetVersion = pAsset->core.assetVersion;
+    cookie.assetTotalLength = pAsset->core.assetTotalLength;
+    cookie.assetNumPayloads = pAsset->core.assetNumPayloads;
+    cookie.selectedPayloadIndex = pAsset->selectedPayloadIndex;
+    cookie.lengthPayloadRecvd = offset;
+
+    pAccessory->callbacks.fPayloadData( pAccessory->pDelegate, pAsset->pDelegate, pBuffer, lengthBuffer,
+                                       offset, (void *)&cookie, sizeof( cookie ) );
+}
+#endif
+
 /* -------------------------------------------------------------------------------- */
 
 void uarpPlatformCleanupAssetsForController( struct uarpPlatformAccessory *pAccessory,
@@ -1578,12 +1648,22 @@ uint32_t uarpPlatformAssetDataResponse( void *pAccessoryDelegate, void *pControl
     
     uarpPayloadTagUnpack( pRequest->payloadTag, payload4cc );
 
-    pResponseBuffer = pRequest->bytes;
-    pResponseBuffer += pRequest->bytesResponded;
+#if UARP_PAYLOAD_STREAMING
+    if ( pRequest->requestType == ( kUARPDataRequestTypePayloadPayload | kUARPDataRequestTypeOutstanding ) )
+    {
+        /* in-order payload chunks go straight to the delegate, the scratch buffer is not used */
+        uarpPlatformUpdatePayloadChunk( pAccessory, pAsset, pBuffer, length );
+    }
+    else
+#endif
+    {
+        pResponseBuffer = pRequest->bytes;
+        pResponseBuffer += pRequest->bytesResponded;
+
+        /* copy buffers */
+        memcpy( pResponseBuffer, pBuffer, length );
+    }
 
-    /* copy buffers */
-    memcpy( pResponseBuffer, pBuffer, length );
-    
     pRequest->bytesResponded += length;
 
     pRequest->requestType = pRequest->requestType & ~kUARPDataRequestTypeOutstanding;
@@ -389,6 +389,19 @@ uint32_t uarpPlatformAccessoryInit( struct uarpPlatformAccessory *pAccessory,
                                    fcnUarpVendorSpecific fVendorSpecific,
                                    void *pDelegate );
 
+/* -------------------------------------------------------------------------------- */
+/*! @brief Update the accessory options
+    @discussion This routine is called to change the message and window sizes between the transfers.  The maximum
+                RX payload length applies to the next data request, the payload window length applies to the assets
+                accepted or merged afterwards.
+    @param pAccessory pointer to the platform accessory
+    @param pOptions pointer to accessory specific options
+    @return kUARPStatusXXX
+ */
+/* -------------------------------------------------------------------------------- */
+uint32_t uarpPlatformAccessoryOptionsUpdate( struct uarpPlatformAccessory *pAccessory,
+                                            struct uarpPlatformOptionsObj *pOptions );
+
 
 /* -------------------------------------------------------------------------------- */
 /*! @brief Add a controller to the accessory
@@ -85,6 +85,7 @@ extern "C" {
 #define UARP_DISABLE_VERIFY          IS_ENABLED(CONFIG_UARP_DISABLE_VERIFY)
 #define UARP_DISABLE_VENDOR_SPECIFIC IS_ENABLED(CONFIG_UARP_DISABLE_VENDOR_SPECIFIC)
 #define UARP_DISABLE_CONTROLLER      1
+#define UARP_PAYLOAD_STREAMING       IS_ENABLED(CONFIG_UARP_PAYLOAD_STREAMING)
 
 typedef enum
 {
@@ -23,19 +23,43 @@
 
 #include "fmna_uarp.h"
 #include "fmna_serial_number.h"
+#include "fmna_storage.h"
 #include "fmna_version.h"
 
 #include "fmna_uarp_writer.h"
 #include "fmna_uarp_payload.h"
+#include "fmna_uarp_flash.h"
+#include "fmna_uarp_pool.h"
+#include "fmna_uarp_decompress.h"
 
 LOG_MODULE_REGISTER(LOG_MODULE_NAME, CONFIG_FMNA_UARP_LOG_LEVEL);
 
 #define TLV_TYPE_SHA2          0xF4CE36FEuL
 #define TLV_TYPE_APPLY_FLAGS   0xF4CE36FCuL
+#define TLV_TYPE_COMPRESSION   0xF4CE36FDuL
 #define APPLY_FLAGS_FAST_RESET 0xFF
 
 #define TX_MESSAGE_HEADROOM_SIZE 1
 #define MAX_TX_MESSAGE_SIZE      (CONFIG_FMNA_UARP_TX_MSG_PAYLOAD_SIZE + sizeof(union UARPMessages))
+#define TX_MESSAGE_BLOCK_SIZE    \
+	(sizeof(struct net_buf_simple) + TX_MESSAGE_HEADROOM_SIZE + MAX_TX_MESSAGE_SIZE)
+#define TX_QUEUE_SIZE            CONFIG_FMNA_UARP_TX_QUEUE_SIZE
+#define ASSET_COUNT              CONFIG_FMNA_UARP_ASSET_COUNT
+
+#define DATA_RESPONSE_HEADER_SIZE sizeof(struct UARPMsgAssetDataResponse)
+#define RX_PAYLOAD_SIZE_MIN       32
+/* Weight of the previous value in the moving average of the measured timings. */
+#define TIMING_AVG_WEIGHT         7
+
+#if CONFIG_FMNA_UARP_RESUME
+/* The checkpoint is taken at a window boundary with all data before it written to the flash. */
+BUILD_ASSERT((CONFIG_FMNA_UARP_RESUME_CHECKPOINT_INTERVAL %
+	      CONFIG_FMNA_UARP_PAYLOAD_WINDOW_SIZE) == 0);
+#if CONFIG_FMNA_UARP_FLASH_ASYNC
+BUILD_ASSERT((CONFIG_FMNA_UARP_RESUME_CHECKPOINT_INTERVAL %
+	      CONFIG_FMNA_UARP_FLASH_BUF_SIZE) == 0);
+#endif
+#endif
 
 enum last_error_code {
 	LAST_ERROR_UNSET                           = 0,
@@ -53,6 +77,16 @@ enum last_error_code {
 	LAST_ERROR_INVALID_HASH                    = 12,
 	LAST_ERROR_ASSET_FULLY_STAGED_FAILED       = 13,
 	LAST_ERROR_ASSET_ACCEPT_FAILED             = 14,
+	LAST_ERROR_INVALID_COMPRESSION_TLV         = 15,
+};
+
+/* Persistent state of the interrupted payload transfer. */
+struct resume_checkpoint {
+	/* Asset identity, payload index and the number of received payload bytes. */
+	struct uarpPlatformAssetCookie cookie;
+	ocrypto_sha256_ctx hash_ctx;
+	uint8_t payload_hash[ocrypto_sha256_BYTES];
+	uint32_t staged_assets;
 };
 
 enum asset_state {
@@ -67,36 +101,192 @@ enum asset_state {
 static struct fmna_uarp_accessory
 {
 	struct uarpPlatformAccessory accessory;
+	struct uarpPlatformOptionsObj options;
 	struct uarpPlatformController controller;
 	struct uarpPlatformAsset *asset;
 	struct UARPVersion payload_version;
-	struct net_buf_simple *buf;
-	struct net_buf_simple *pending_buf;
+	/* Outgoing messages in the sending order. The head is in flight. */
+	struct {
+		struct net_buf_simple *bufs[TX_QUEUE_SIZE];
+		uint8_t head;
+		uint8_t count;
+	} tx_queue;
 	ocrypto_sha256_ctx hash_ctx;
 	fmna_uarp_send_message_fn send_message;
+	fmna_uarp_process_request_fn process_request;
 	uint32_t last_error;
 	enum asset_state state;
 	uint8_t payload_hash[ocrypto_sha256_BYTES];
 	uint8_t apply_flags;
+	/* The payload is compressed and decompressed before it is written. */
+	bool compressed;
+	struct fmna_uarp_decompress_params compression;
 	const struct fmna_uarp_payload *current_payload;
 	bool transfer_in_progress;
+	/* Asset with the payload data requests paused until the flash catches up. */
+	struct uarpPlatformAsset *write_paused_asset;
 	uint32_t staged_assets;
+	struct resume_checkpoint checkpoint;
+	bool checkpoint_valid;
+	bool resume_pending;
+	/* Write size of the current controller and the timings used to select the message sizes. */
+	uint16_t rx_chunk_size;
+	int64_t tx_timestamp;
+	uint32_t ack_latency_us;
+	uint32_t processing_time_us;
 } accessory;
 
 static int64_t payload_ready_timestamp;
 
+/* Outgoing messages, assets and their payload window scratch buffers are
+ * allocated from fixed pools, so a transfer never fails on heap fragmentation.
+ */
+FMNA_UARP_POOL_DEFINE(tx_msg_pool, TX_MESSAGE_BLOCK_SIZE, TX_QUEUE_SIZE);
+FMNA_UARP_POOL_DEFINE(asset_pool, sizeof(struct uarpPlatformAsset), ASSET_COUNT);
+FMNA_UARP_POOL_DEFINE(scratch_pool, CONFIG_FMNA_UARP_PAYLOAD_WINDOW_SIZE, ASSET_COUNT);
+
 static uint32_t query_active_firmware_version(void *accessory_delegate,
 					      uint32_t asset_tag,
 					      struct UARPVersion *version);
 static void payload_meta_data_complete(void *accessory_delegate, void *asset_delegate);
 static void asset_meta_data_complete(void *accessory_delegate, void *asset_delegate);
+static int payload_transfer_sync(struct fmna_uarp_accessory *accessory);
+
+static void pool_stats_log(void)
+{
+	struct {
+		const char *name;
+		struct fmna_uarp_pool *pool;
+	} pools[] = {
+		{"TX message", &tx_msg_pool},
+		{"asset", &asset_pool},
+		{"scratch", &scratch_pool},
+	};
+	struct fmna_uarp_pool_stats stats;
+
+	for (size_t i = 0; i < ARRAY_SIZE(pools); i++) {
+		fmna_uarp_pool_stats_get(pools[i].pool, &stats);
+		LOG_DBG("UARP %s pool: used %u, high water %u, failures %u",
+			pools[i].name, stats.used, stats.high_water, stats.failures);
+	}
+}
+
+size_t fmna_uarp_mem_peak_get(void)
+{
+	struct fmna_uarp_pool *pools[] = {&tx_msg_pool, &asset_pool, &scratch_pool};
+	struct fmna_uarp_pool_stats stats;
+	size_t peak = 0;
+
+	for (size_t i = 0; i < ARRAY_SIZE(pools); i++) {
+		fmna_uarp_pool_stats_get(pools[i], &stats);
+		peak += stats.high_water * pools[i]->block_size;
+	}
+
+	return peak;
+}
+
+static void timing_avg_update(uint32_t *avg_us, int64_t start)
+{
+	uint32_t sample_us = k_ticks_to_us_ceil32(k_uptime_ticks() - start);
+
+	if (*avg_us == 0) {
+		*avg_us = sample_us;
+	} else {
+		*avg_us = (*avg_us * TIMING_AVG_WEIGHT + sample_us) / (TIMING_AVG_WEIGHT + 1);
+	}
+}
+
+/* Select the RX message payload size with the highest expected data rate. A data request
+ * costs the indication with its confirmation, the response writes of the controller and the
+ * processing of the response. Each write is expected to take as long as the indication.
+ */
+static uint32_t rx_payload_size_select(const struct fmna_uarp_accessory *accessory)
+{
+	uint32_t chunk_size = accessory->rx_chunk_size;
+	uint32_t latency_us = MAX(accessory->ack_latency_us, 1);
+	uint32_t chunks_max;
+	uint32_t best_size = 0;
+	uint64_t best_time = 1;
+
+	if (chunk_size == 0) {
+		return CONFIG_FMNA_UARP_RX_MSG_PAYLOAD_SIZE;
+	}
+
+	chunks_max = DIV_ROUND_UP(DATA_RESPONSE_HEADER_SIZE + CONFIG_FMNA_UARP_RX_MSG_PAYLOAD_SIZE,
+				  chunk_size);
+
+	for (uint32_t chunks = 1; chunks <= chunks_max; chunks++) {
+		uint32_t size;
+		uint64_t time;
+
+		if (chunks * chunk_size <= DATA_RESPONSE_HEADER_SIZE) {
+			continue;
+		}
+
+		/* The largest payload that does not need another write. */
+		size = MIN(chunks * chunk_size - DATA_RESPONSE_HEADER_SIZE,
+			   CONFIG_FMNA_UARP_RX_MSG_PAYLOAD_SIZE);
+		time = accessory->processing_time_us + (uint64_t)(1 + chunks) * latency_us;
+
+		/* Compare the size to time ratios without the division. */
+		if ((uint64_t)size * best_time > (uint64_t)best_size * time) {
+			best_size = size;
+			best_time = time;
+		}
+	}
+
+	return MAX(best_size, RX_PAYLOAD_SIZE_MIN);
+}
+
+static void sizes_update(struct fmna_uarp_accessory *accessory)
+{
+	uint32_t status;
+	uint32_t rx_payload_size;
+
+	rx_payload_size = rx_payload_size_select(accessory);
+
+	accessory->options.maxRxPayloadLength = rx_payload_size;
+	if (IS_ENABLED(CONFIG_FMNA_UARP_RESUME)) {
+		/* Only the RX message payload adapts. The resume checkpoints are aligned to the
+		 * configured window, the flash buffer and the flash page.
+		 */
+		accessory->options.payloadWindowLength = CONFIG_FMNA_UARP_PAYLOAD_WINDOW_SIZE;
+	} else {
+		/* Every window is requested with the full RX message payloads. */
+		accessory->options.payloadWindowLength =
+			ROUND_DOWN(CONFIG_FMNA_UARP_PAYLOAD_WINDOW_SIZE, rx_payload_size);
+
+		/* The metadata is requested at once into the window. */
+		if (accessory->options.payloadWindowLength <
+		    CONFIG_FMNA_UARP_ADAPTIVE_METADATA_SIZE_MAX) {
+			accessory->options.payloadWindowLength =
+				CONFIG_FMNA_UARP_PAYLOAD_WINDOW_SIZE;
+		}
+	}
+
+	status = uarpPlatformAccessoryOptionsUpdate(&accessory->accessory, &accessory->options);
+	if (status != kUARPStatusSuccess) {
+		LOG_ERR("uarpPlatformAccessoryOptionsUpdate failed, status 0x%04X", status);
+		return;
+	}
+
+	LOG_INF("RX message payload size %u, payload window size %u",
+		accessory->options.maxRxPayloadLength, accessory->options.payloadWindowLength);
+	LOG_INF("Write chunk size %u, confirmation latency %u us, processing time %u us",
+		accessory->rx_chunk_size, accessory->ack_latency_us,
+		accessory->processing_time_us);
+}
 
-void fmna_uarp_controller_add(void)
+void fmna_uarp_controller_add(uint16_t rx_chunk_size)
 {
 	uint32_t status;
 
 	LOG_INF("Adding controller");
 
+	/* The confirmation latency depends on the connection, the processing time does not. */
+	accessory.rx_chunk_size = rx_chunk_size;
+	accessory.ack_latency_us = 0;
+
 	status = uarpPlatformControllerAdd(&accessory.accessory,
 					   &accessory.controller,
 					   (void *)&accessory.controller);
@@ -112,21 +302,27 @@ void fmna_uarp_controller_remove(void)
 
 	LOG_INF("Removing controller");
 
-	uarpFree(accessory.buf);
-	uarpFree(accessory.pending_buf);
-	accessory.buf = NULL;
-	accessory.pending_buf = NULL;
+	while (accessory.tx_queue.count > 0) {
+		fmna_uarp_pool_free(&tx_msg_pool, accessory.tx_queue.bufs[accessory.tx_queue.head]);
+
+		accessory.tx_queue.head = (accessory.tx_queue.head + 1) % TX_QUEUE_SIZE;
+		accessory.tx_queue.count--;
+	}
+	accessory.tx_queue.head = 0;
 
 	status = uarpPlatformControllerRemove(&accessory.accessory, &accessory.controller);
 
 	if (status != kUARPStatusSuccess) {
 		LOG_ERR("uarpPlatformControllerRemove failed, status 0x%04X", status);
 	}
+
+	pool_stats_log();
 }
 
 void fmna_uarp_recv_message(struct net_buf_simple *buf)
 {
 	uint32_t status;
+	int64_t start = k_uptime_ticks();
 
 	status = uarpPlatformAccessoryRecvMessage(&accessory.accessory,
 						  &accessory.controller,
@@ -136,16 +332,28 @@ void fmna_uarp_recv_message(struct net_buf_simple *buf)
 	if (status != kUARPStatusSuccess) {
 		LOG_ERR("uarpPlatformAccessoryRecvMessage failed, status 0x%04X", status);
 	}
+
+	if (IS_ENABLED(CONFIG_FMNA_UARP_ADAPTIVE_SIZES)) {
+		timing_avg_update(&accessory.processing_time_us, start);
+	}
 }
 
 static uint32_t request_buffer(void *accessory_delegate, uint8_t **buffer, uint32_t bufferLength)
 {
 	__ASSERT(buffer, "NULL argument");
 
-	*buffer = uarpZalloc(bufferLength);
+	/* UARPDK requests the asset structures and the payload window scratch buffers. The adapted
+	 * window can be smaller than the asset structure and can change between the requests, so
+	 * only the asset structure size selects the asset pool.
+	 */
+	if (bufferLength == sizeof(struct uarpPlatformAsset)) {
+		*buffer = fmna_uarp_pool_alloc(&asset_pool, bufferLength);
+	} else {
+		*buffer = fmna_uarp_pool_alloc(&scratch_pool, bufferLength);
+	}
 
 	if (*buffer == NULL) {
-		LOG_ERR("Out of heap memory");
+		LOG_ERR("No free UARP buffer for length %u", bufferLength);
 		return kUARPStatusNoResources;
 	}
 
@@ -154,7 +362,15 @@ static uint32_t request_buffer(void *accessory_delegate, uint8_t **buffer, uint3
 
 static void return_buffer(void *accessory_delegate, uint8_t *buffer)
 {
-	uarpFree(buffer);
+	if (!buffer) {
+		return;
+	}
+
+	if (fmna_uarp_pool_owns(&asset_pool, buffer)) {
+		fmna_uarp_pool_free(&asset_pool, buffer);
+	} else {
+		fmna_uarp_pool_free(&scratch_pool, buffer);
+	}
 }
 
 static struct net_buf_simple *net_buf_simple_from_uarp_buffer(uint8_t *buffer, uint32_t length)
@@ -183,18 +399,17 @@ static uint32_t request_transmit_msg_buffer(void *accessory_delegate,
 					    uint8_t **buffer,
 					    uint32_t *length)
 {
-	struct net_buf_simple *buf;
+	void *buf;
 
 	__ASSERT(buffer, "NULL argument");
 	__ASSERT(length, "NULL argument");
 
 	*length = MAX_TX_MESSAGE_SIZE;
 
-	buf = uarpZalloc(sizeof(struct net_buf_simple) + TX_MESSAGE_HEADROOM_SIZE + MAX_TX_MESSAGE_SIZE);
-
-	if (buf == NULL) {
+	buf = fmna_uarp_pool_alloc(&tx_msg_pool, TX_MESSAGE_BLOCK_SIZE);
+	if (!buf) {
 		*buffer = NULL;
-		LOG_ERR("Out of heap memory");
+		LOG_ERR("No free UARP TX message buffer");
 		return kUARPStatusNoResources;
 	}
 
@@ -206,7 +421,7 @@ static void return_transmit_msg_buffer(void *accessory_delegate,
 				void *controller_delegate,
 				uint8_t *buffer)
 {
-	uarpFree(net_buf_simple_from_uarp_buffer(buffer, 0));
+	fmna_uarp_pool_free(&tx_msg_pool, net_buf_simple_from_uarp_buffer(buffer, 0));
 }
 
 static uint32_t send_message(void *accessory_delegate,
@@ -214,6 +429,7 @@ static uint32_t send_message(void *accessory_delegate,
 			     uint8_t *buffer,
 			     uint32_t length)
 {
+	uint32_t status;
 	struct net_buf_simple *buf;
 	struct fmna_uarp_accessory *accessory = (struct fmna_uarp_accessory *) accessory_delegate;
 
@@ -223,39 +439,49 @@ static uint32_t send_message(void *accessory_delegate,
 
 	buf = net_buf_simple_from_uarp_buffer(buffer, length);
 
-	if (accessory->buf == NULL) {
-		accessory->buf = buf;
-		return accessory->send_message(buf);
-	} else if (accessory->pending_buf == NULL) {
-		accessory->pending_buf = buf;
-		return kUARPStatusSuccess;
-	} else {
-		LOG_ERR("Already have a pending UARP TX");
+	if (accessory->tx_queue.count == TX_QUEUE_SIZE) {
+		LOG_ERR("UARP TX queue is full");
 		return kUARPStatusNoResources;
 	}
+
+	/* The transport sends the queued messages in order and completes them one by one. */
+	status = accessory->send_message(buf);
+	if (status != kUARPStatusSuccess) {
+		return status;
+	}
+
+	accessory->tx_queue.bufs[(accessory->tx_queue.head + accessory->tx_queue.count) %
+				 TX_QUEUE_SIZE] = buf;
+	accessory->tx_queue.count++;
+
+	if (accessory->tx_queue.count == 1) {
+		accessory->tx_timestamp = k_uptime_ticks();
+	}
+
+	return kUARPStatusSuccess;
 }
 
 void fmna_uarp_send_message_complete(void)
 {
 	struct net_buf_simple *buf;
 
-	__ASSERT(accessory.buf, "Invalid state");
+	__ASSERT(accessory.tx_queue.count > 0, "Invalid state");
 
-	buf = accessory.buf;
+	buf = accessory.tx_queue.bufs[accessory.tx_queue.head];
 
-	if (accessory.pending_buf) {
-		accessory.buf = accessory.pending_buf;
-		accessory.pending_buf = NULL;
-	} else {
-		accessory.buf = NULL;
+	accessory.tx_queue.head = (accessory.tx_queue.head + 1) % TX_QUEUE_SIZE;
+	accessory.tx_queue.count--;
+
+	if (IS_ENABLED(CONFIG_FMNA_UARP_ADAPTIVE_SIZES)) {
+		timing_avg_update(&accessory.ack_latency_us, accessory.tx_timestamp);
 	}
 
 	uarpPlatformAccessorySendMessageComplete(&accessory.accessory,
 						 &accessory.controller,
 						 net_buf_simple_to_uarp_buffer(buf));
 
-	if (accessory.buf) {
-		accessory.send_message(accessory.buf);
+	if (accessory.tx_queue.count > 0) {
+		accessory.tx_timestamp = k_uptime_ticks();
 	}
 }
 
@@ -271,15 +497,155 @@ static uint32_t data_transfer_resume(void *accessory_delegate, void *p_controlle
 	return kUARPStatusSuccess;
 }
 
-static int payload_transfer_start(struct fmna_uarp_accessory *accessory, uint32_t length)
+static void checkpoint_load(struct fmna_uarp_accessory *accessory)
+{
+	int err;
+
+	err = fmna_storage_uarp_checkpoint_load((uint8_t *)&accessory->checkpoint,
+						sizeof(accessory->checkpoint));
+	if (err) {
+		if (err != -ENOENT) {
+			LOG_ERR("fmna_storage_uarp_checkpoint_load returned error: %d", err);
+		}
+		return;
+	}
+
+	LOG_INF("Found checkpoint of interrupted transfer: asset <%08x>, payload %d, offset %u",
+		accessory->checkpoint.cookie.assetTag,
+		accessory->checkpoint.cookie.selectedPayloadIndex,
+		accessory->checkpoint.cookie.lengthPayloadRecvd);
+
+	accessory->checkpoint_valid = true;
+}
+
+static void checkpoint_save(struct fmna_uarp_accessory *accessory,
+			    const struct uarpPlatformAssetCookie *cookie,
+			    uint32_t length_recvd)
+{
+	int err;
+
+	err = payload_transfer_sync(accessory);
+	if (err) {
+		/* The write error is reported with the next payload write. */
+		return;
+	}
+
+	accessory->checkpoint.cookie = *cookie;
+	accessory->checkpoint.cookie.lengthPayloadRecvd = length_recvd;
+	accessory->checkpoint.hash_ctx = accessory->hash_ctx;
+	memcpy(accessory->checkpoint.payload_hash, accessory->payload_hash,
+	       sizeof(accessory->checkpoint.payload_hash));
+	accessory->checkpoint.staged_assets = accessory->staged_assets;
+
+	err = fmna_storage_uarp_checkpoint_store((uint8_t *)&accessory->checkpoint,
+						 sizeof(accessory->checkpoint));
+	if (err) {
+		LOG_ERR("fmna_storage_uarp_checkpoint_store returned error: %d", err);
+		return;
+	}
+
+	accessory->checkpoint_valid = true;
+
+	LOG_DBG("Checkpoint stored at offset %u", length_recvd);
+}
+
+static void checkpoint_clear(struct fmna_uarp_accessory *accessory)
+{
+	int err;
+
+	if (!accessory->checkpoint_valid) {
+		return;
+	}
+
+	accessory->checkpoint_valid = false;
+	accessory->resume_pending = false;
+
+	err = fmna_storage_uarp_checkpoint_delete();
+	if (err) {
+		LOG_ERR("fmna_storage_uarp_checkpoint_delete returned error: %d", err);
+	}
+}
+
+static bool checkpoint_matches(struct fmna_uarp_accessory *accessory,
+			       struct uarpPlatformAsset *asset)
+{
+	const struct uarpPlatformAssetCookie *cookie = &accessory->checkpoint.cookie;
+
+	if (!IS_ENABLED(CONFIG_FMNA_UARP_RESUME) || !accessory->checkpoint_valid) {
+		return false;
+	}
+
+	/* Same checks as UARPDK does for the cookie passed with the payload data. */
+	return (cookie->assetTag == asset->core.assetTag) &&
+	       (cookie->assetTotalLength == asset->core.assetTotalLength) &&
+	       (cookie->assetNumPayloads == asset->core.assetNumPayloads) &&
+	       (cookie->selectedPayloadIndex < asset->core.assetNumPayloads) &&
+	       (uarpVersionCompare((struct UARPVersion *)&cookie->assetVersion,
+				   &asset->core.assetVersion) ==
+		kUARPVersionComparisonResultIsEqual);
+}
+
+static int payload_transfer_write_raw(const uint8_t *buffer, size_t length)
+{
+	if (IS_ENABLED(CONFIG_FMNA_UARP_FLASH_ASYNC)) {
+		return fmna_uarp_flash_write(buffer, length);
+	}
+
+	return fmna_uarp_writer_transfer_write(accessory.current_payload->writer, buffer, length);
+}
+
+static int payload_decompress_sink(const uint8_t *data, size_t len)
+{
+	int ret;
+
+	if (IS_ENABLED(CONFIG_FMNA_UARP_FLASH_ASYNC)) {
+		/* The decompressed data can outgrow the space reserved for the payload
+		 * window. The decoder keeps the rest until the flash thread releases
+		 * a buffer.
+		 */
+		len = MIN(len, fmna_uarp_flash_space_get());
+		if (len == 0) {
+			return 0;
+		}
+	}
+
+	ret = payload_transfer_write_raw(data, len);
+	if (ret) {
+		return ret;
+	}
+
+	return len;
+}
+
+static int payload_transfer_start(struct fmna_uarp_accessory *accessory, uint32_t length,
+				  uint32_t offset)
 {
 	int ret;
+	const struct fmna_uarp_writer *writer;
 
 	__ASSERT(accessory, "NULL parameter");
 	__ASSERT_NO_MSG(accessory->current_payload);
 	__ASSERT_NO_MSG(!accessory->transfer_in_progress);
 
-	ret = fmna_uarp_writer_transfer_start(accessory->current_payload->writer, length);
+	writer = accessory->current_payload->writer;
+
+	if (IS_ENABLED(CONFIG_FMNA_UARP_COMPRESSION) && accessory->compressed) {
+		/* The decompressor state is not a part of the resume checkpoint. */
+		if (offset > 0) {
+			return -ENOTSUP;
+		}
+
+		length = accessory->compression.size;
+		fmna_uarp_decompress_start(&accessory->compression, payload_decompress_sink);
+	}
+
+	if (IS_ENABLED(CONFIG_FMNA_UARP_FLASH_ASYNC)) {
+		ret = fmna_uarp_flash_start(writer, length, offset);
+	} else if (offset > 0) {
+		ret = fmna_uarp_writer_transfer_resume(writer, length, offset);
+	} else {
+		ret = fmna_uarp_writer_transfer_start(writer, length);
+	}
 
 	if (!ret) {
 		accessory->transfer_in_progress = true;
@@ -290,29 +656,95 @@ static int payload_transfer_start(struct fmna_uarp_accessory *accessory, uint32_
 
 static int payload_transfer_write(struct fmna_uarp_accessory *accessory, uint8_t *buffer, uint32_t length)
 {
-	int ret;
-
 	__ASSERT(accessory, "NULL parameter");
 	__ASSERT_NO_MSG(accessory->transfer_in_progress);
 
-	ret = fmna_uarp_writer_transfer_write(accessory->current_payload->writer, buffer, length);
+	if (IS_ENABLED(CONFIG_FMNA_UARP_COMPRESSION) && accessory->compressed) {
+		return fmna_uarp_decompress_write(buffer, length);
+	}
 
-	return ret;
+	return payload_transfer_write_raw(buffer, length);
 }
 
 static int payload_transfer_finish(struct fmna_uarp_accessory *accessory, bool success)
 {
 	int ret;
+	int err = 0;
 
 	__ASSERT(accessory, "NULL parameter");
 	__ASSERT_NO_MSG(accessory->transfer_in_progress);
 
-	ret = fmna_uarp_writer_transfer_finish(accessory->current_payload->writer, success);
+	if (IS_ENABLED(CONFIG_FMNA_UARP_COMPRESSION) && accessory->compressed && success) {
+		/* The last chunk can leave data that did not fit into the flash buffers. */
+		while ((err = fmna_uarp_decompress_finish()) == -EAGAIN) {
+			err = payload_transfer_sync(accessory);
+			if (err) {
+				break;
+			}
+		}
+
+		if (err) {
+			success = false;
+		}
+	}
+
+	if (IS_ENABLED(CONFIG_FMNA_UARP_FLASH_ASYNC)) {
+		ret = fmna_uarp_flash_finish(success);
+	} else {
+		ret = fmna_uarp_writer_transfer_finish(accessory->current_payload->writer, success);
+	}
 	accessory->transfer_in_progress = false;
 
+	if (err) {
+		ret = err;
+	}
+
+	checkpoint_clear(accessory);
+
 	return ret;
 }
 
+static int payload_transfer_sync(struct fmna_uarp_accessory *accessory)
+{
+	__ASSERT(accessory, "NULL parameter");
+	__ASSERT_NO_MSG(accessory->transfer_in_progress);
+
+	if (IS_ENABLED(CONFIG_FMNA_UARP_FLASH_ASYNC)) {
+		return fmna_uarp_flash_sync();
+	}
+
+	return 0;
+}
+
+static int payload_transfer_resume(struct fmna_uarp_accessory *accessory,
+				   struct uarpPlatformAsset *asset)
+{
+	int ret;
+	const struct resume_checkpoint *checkpoint = &accessory->checkpoint;
+
+	if (checkpoint->cookie.selectedPayloadIndex != asset->selectedPayloadIndex) {
+		return -ENOENT;
+	}
+
+	/* The payload metadata of the re-offered SuperBinary must match the checkpoint. */
+	if (memcmp(checkpoint->payload_hash, accessory->payload_hash,
+		   sizeof(accessory->payload_hash)) != 0) {
+		return -EINVAL;
+	}
+
+	ret = payload_transfer_start(accessory, asset->payload.plHdr.payloadLength,
+				     checkpoint->cookie.lengthPayloadRecvd);
+	if (ret) {
+		return ret;
+	}
+
+	accessory->hash_ctx = checkpoint->hash_ctx;
+
+	LOG_INF("Payload transfer resumed from offset %u", checkpoint->cookie.lengthPayloadRecvd);
+
+	return 0;
+}
+
 static inline bool payload_transfer_is_busy(struct fmna_uarp_accessory *accessory)
 {
 	return accessory->transfer_in_progress;
@@ -345,6 +777,12 @@ static void super_binary_offered(void *accessory_delegate,
 		is_acceptable = kUARPNo;
 	}
 
+	if (IS_ENABLED(CONFIG_FMNA_UARP_ADAPTIVE_SIZES) && (is_acceptable == kUARPYes) &&
+	    ((accessory->state == ASSET_NONE) || (accessory->state == ASSET_ORPHANED))) {
+		/* The window size applies to the accepted and the merged asset. */
+		sizes_update(accessory);
+	}
+
 	if (is_acceptable == kUARPNo) {
 
 		LOG_INF("Asset is not acceptable");
@@ -444,6 +882,7 @@ static void remove_asset(struct fmna_uarp_accessory *accessory,
 
 	accessory->state = ASSET_NONE;
 	accessory->asset = NULL;
+	accessory->write_paused_asset = NULL;
 
 	if (payload_transfer_is_busy(accessory)) {
 		ret = payload_transfer_finish(accessory, false);
@@ -518,6 +957,9 @@ static void report_failure(struct fmna_uarp_accessory *accessory,
 
 	accessory->last_error = (last_error << 16) | (last_error_info & 0xFFFF);
 
+	/* Do not resume the failed transfer after a reboot. */
+	checkpoint_clear(accessory);
+
 	switch (accessory->state) {
 	case ASSET_ACTIVE:
 		accessory->state = ASSET_FAILED;
@@ -576,7 +1018,19 @@ static void asset_meta_data_complete(void *accessory_delegate, void *asset_deleg
 	__ASSERT(asset_delegate, "NULL parameter");
 
 	accessory->staged_assets = 0;
-	status = uarpPlatformAssetSetPayloadIndex(&accessory->accessory, asset, 0);
+
+	if (checkpoint_matches(accessory, asset)) {
+		LOG_INF("Resuming interrupted transfer from payload %d",
+			accessory->checkpoint.cookie.selectedPayloadIndex + 1);
+
+		/* The payloads before the checkpoint one are already staged. */
+		accessory->staged_assets = accessory->checkpoint.staged_assets;
+		accessory->resume_pending = true;
+		status = uarpPlatformAssetSetPayloadIndexWithCookie(&accessory->accessory, asset, 0,
+								    &accessory->checkpoint.cookie);
+	} else {
+		status = uarpPlatformAssetSetPayloadIndex(&accessory->accessory, asset, 0);
+	}
 
 	if (status != kUARPStatusSuccess) {
 		LOG_ERR("uarpPlatformAssetSetPayloadIndex failed, status 0x%04X", status);
@@ -703,6 +1157,7 @@ static void payload_ready(void *accessory_delegate, void *asset_delegate)
 		accessory->current_payload = payload;
 
 		accessory->apply_flags = kUARPApplyStagedAssetsFlagsNeedsRestart;
+		accessory->compressed = false;
 		accessory->payload_version = asset->payload.plHdr.payloadVersion;
 		ocrypto_sha256_init(&accessory->hash_ctx);
 		memset(accessory->payload_hash, 0, sizeof(accessory->payload_hash));
@@ -744,7 +1199,7 @@ static void payload_meta_data_tlv(void *accessory_delegate,
 	__ASSERT(accessory_delegate, "NULL parameter");
 	__ASSERT(asset_delegate, "NULL parameter");
 	__ASSERT(value, "NULL parameter");
-	__ASSERT(length < CONFIG_FMNA_UARP_PAYLOAD_WINDOW_SIZE, "Invalid length");
+	__ASSERT(length < accessory->options.payloadWindowLength, "Invalid length");
 
 	LOG_INF("Payload MetaData type 0x%08X, length %d", type, length);
 
@@ -771,6 +1226,18 @@ static void payload_meta_data_tlv(void *accessory_delegate,
 		}
 		break;
 
+	case TLV_TYPE_COMPRESSION:
+		if (IS_ENABLED(CONFIG_FMNA_UARP_COMPRESSION) &&
+		    (fmna_uarp_decompress_params_parse(value, length,
+						       &accessory->compression) == 0)) {
+			accessory->compressed = true;
+		} else {
+			LOG_ERR("Unsupported compression TLV");
+			report_failure(accessory, asset, LAST_ERROR_INVALID_COMPRESSION_TLV,
+				       length);
+		}
+		break;
+
 	default:
 		break;
 	}
@@ -780,6 +1247,7 @@ static void payload_meta_data_complete(void *accessory_delegate, void *asset_del
 {
 	int ret;
 	uint32_t status;
+	struct uarpPlatformAssetCookie *cookie;
 	struct fmna_uarp_accessory *accessory = (struct fmna_uarp_accessory *) accessory_delegate;
 	struct uarpPlatformAsset *asset = (struct uarpPlatformAsset *) asset_delegate;
 
@@ -799,14 +1267,38 @@ static void payload_meta_data_complete(void *accessory_delegate, void *asset_del
 		}
 	}
 
-	ret = payload_transfer_start(accessory, asset->payload.plHdr.payloadLength);
-	if (ret) {
-		LOG_ERR("payload_transfer_start failed, code %d", ret);
-		report_failure(accessory, asset, LAST_ERROR_PAYLOAD_TRANSFER_START_FAILED, ret);
-		return;
+	cookie = NULL;
+	if (accessory->resume_pending) {
+		accessory->resume_pending = false;
+
+		ret = payload_transfer_resume(accessory, asset);
+		if (ret) {
+			LOG_WRN("Cannot resume the payload transfer (err %d), restarting", ret);
+		} else {
+			cookie = &accessory->checkpoint.cookie;
+		}
+	}
+
+	if (!cookie) {
+		ret = payload_transfer_start(accessory, asset->payload.plHdr.payloadLength, 0);
+		if (ret) {
+			LOG_ERR("payload_transfer_start failed, code %d", ret);
+			report_failure(accessory, asset, LAST_ERROR_PAYLOAD_TRANSFER_START_FAILED,
+				       ret);
+			return;
+		}
+	}
+
+	if (accessory->write_paused_asset == asset) {
+		/* Resuming requests the payload data when no request is outstanding. */
+		accessory->write_paused_asset = NULL;
+		status = uarpPlatformAccessoryPayloadRequestDataResume(&accessory->accessory,
+									asset);
+	} else {
+		status = uarpPlatformAccessoryPayloadRequestDataWithCookie(&accessory->accessory,
+									   asset, cookie);
 	}
 
-	status = uarpPlatformAccessoryPayloadRequestData(&accessory->accessory, asset);
 	if (status != kUARPStatusSuccess) {
 		LOG_ERR("uarpPlatformAccessoryPayloadRequestData failed, status 0x%04X", status);
 		report_failure(accessory, asset, LAST_ERROR_PAYLOAD_REQUEST_DATA_FAILED, status);
@@ -815,11 +1307,21 @@ static void payload_meta_data_complete(void *accessory_delegate, void *asset_del
 	LOG_INF("Payload transfer started!");
 }
 
+static void payload_write_space_wait(struct fmna_uarp_accessory *accessory)
+{
+	if (fmna_uarp_flash_space_request(accessory->options.payloadWindowLength)) {
+		/* The flash thread released a buffer in the meantime. */
+		accessory->process_request();
+	}
+}
+
 static void payload_data(void *accessory_delegate, void *asset_delegate,
 			 uint8_t *buffer, uint32_t buffer_length, uint32_t offset,
 			 uint8_t *asset_state, uint32_t asset_state_length)
 {
 	int ret;
+	uint32_t status;
+	bool write_blocked;
 	struct fmna_uarp_accessory *accessory = (struct fmna_uarp_accessory *) accessory_delegate;
 	struct uarpPlatformAsset *asset = (struct uarpPlatformAsset *) asset_delegate;
 
@@ -834,10 +1336,115 @@ static void payload_data(void *accessory_delegate, void *asset_delegate,
 
 	ret = payload_transfer_write(accessory, buffer, buffer_length);
 
+	write_blocked = (ret == -EAGAIN);
+	if (write_blocked) {
+		ret = 0;
+	}
+
 	if (ret) {
 		LOG_ERR("Image write error, code %d", ret);
 		report_failure(accessory, asset, LAST_ERROR_PAYLOAD_WRITE_FAILED, ret);
+		return;
+	}
+
+	if (IS_ENABLED(CONFIG_FMNA_UARP_RESUME) && !accessory->compressed &&
+	    (offset + buffer_length < asset->payload.plHdr.payloadLength) &&
+	    ((offset + buffer_length) % CONFIG_FMNA_UARP_RESUME_CHECKPOINT_INTERVAL == 0)) {
+		__ASSERT_NO_MSG(asset_state_length == sizeof(struct uarpPlatformAssetCookie));
+
+		checkpoint_save(accessory, (struct uarpPlatformAssetCookie *)asset_state,
+				offset + buffer_length);
+	}
+
+	if (!IS_ENABLED(CONFIG_FMNA_UARP_FLASH_ASYNC) ||
+	    (offset + buffer_length == asset->payload.plHdr.payloadLength)) {
+		return;
+	}
+
+	if (write_blocked) {
+		/* The decompressed data did not fit into the flash buffers. The rest
+		 * of the chunk is decoded once the flash thread releases a buffer.
+		 */
+		payload_write_space_wait(accessory);
+	} else if (fmna_uarp_flash_space_request(accessory->options.payloadWindowLength)) {
+		return;
 	}
+
+	/* The next payload window does not fit into the flash buffers either.
+	 * Stop requesting data until the flash thread releases a buffer.
+	 */
+	status = uarpPlatformAccessoryPayloadRequestDataPause(&accessory->accessory, asset);
+	if (status != kUARPStatusSuccess) {
+		LOG_ERR("uarpPlatformAccessoryPayloadRequestDataPause failed, status 0x%04X",
+			status);
+		report_failure(accessory, asset, LAST_ERROR_PAYLOAD_REQUEST_DATA_FAILED, status);
+		return;
+	}
+
+	LOG_DBG("Payload data requests paused until the flash buffer is released");
+	accessory->write_paused_asset = asset;
+}
+
+static void payload_write_process(struct fmna_uarp_accessory *accessory)
+{
+	int ret;
+	uint32_t status;
+	struct uarpPlatformAsset *asset = accessory->asset;
+
+	if ((accessory->state != ASSET_ACTIVE) || !payload_transfer_is_busy(accessory)) {
+		return;
+	}
+
+	ret = fmna_uarp_flash_error_get();
+	if (ret) {
+		LOG_ERR("Image write error, code %d", ret);
+		report_failure(accessory, asset, LAST_ERROR_PAYLOAD_WRITE_FAILED, ret);
+		return;
+	}
+
+	if (accessory->write_paused_asset != asset) {
+		return;
+	}
+
+	if (IS_ENABLED(CONFIG_FMNA_UARP_COMPRESSION) && accessory->compressed) {
+		ret = fmna_uarp_decompress_resume();
+		if (ret == -EAGAIN) {
+			payload_write_space_wait(accessory);
+			return;
+		}
+
+		if (ret) {
+			LOG_ERR("Image write error, code %d", ret);
+			report_failure(accessory, asset, LAST_ERROR_PAYLOAD_WRITE_FAILED, ret);
+			return;
+		}
+	}
+
+	if (!fmna_uarp_flash_space_request(accessory->options.payloadWindowLength)) {
+		return;
+	}
+
+	LOG_DBG("Payload data requests resumed");
+	accessory->write_paused_asset = NULL;
+
+	status = uarpPlatformAccessoryPayloadRequestDataResume(&accessory->accessory, asset);
+	if (status != kUARPStatusSuccess) {
+		LOG_ERR("uarpPlatformAccessoryPayloadRequestDataResume failed, status 0x%04X",
+			status);
+		report_failure(accessory, asset, LAST_ERROR_PAYLOAD_REQUEST_DATA_FAILED, status);
+	}
+}
+
+void fmna_uarp_process(void)
+{
+	if (IS_ENABLED(CONFIG_FMNA_UARP_FLASH_ASYNC)) {
+		payload_write_process(&accessory);
+	}
+}
+
+static void flash_notify(void)
+{
+	accessory.process_request();
 }
 
 static void reboot_work_handler(struct k_work *work)
@@ -1131,21 +1738,31 @@ int fmna_uarp_img_confirm(void)
 	return ret;
 }
 
-bool fmna_uarp_init(fmna_uarp_send_message_fn send_message_callback)
+bool fmna_uarp_init(fmna_uarp_send_message_fn send_message_callback,
+		    fmna_uarp_process_request_fn process_request_callback)
 {
 	uint32_t status;
-	struct uarpPlatformOptionsObj options;
 	struct uarpPlatformAccessoryCallbacks callbacks;
 
 	__ASSERT(send_message_callback, "NULL parameter");
+	__ASSERT(process_request_callback, "NULL parameter");
 
 	LOG_INF("Initializing FMNA UARP");
 
-	options.maxTxPayloadLength = CONFIG_FMNA_UARP_TX_MSG_PAYLOAD_SIZE;
-	options.maxRxPayloadLength = CONFIG_FMNA_UARP_RX_MSG_PAYLOAD_SIZE;
-	options.payloadWindowLength = CONFIG_FMNA_UARP_PAYLOAD_WINDOW_SIZE;
+	accessory.options.maxTxPayloadLength = CONFIG_FMNA_UARP_TX_MSG_PAYLOAD_SIZE;
+	accessory.options.maxRxPayloadLength = CONFIG_FMNA_UARP_RX_MSG_PAYLOAD_SIZE;
+	accessory.options.payloadWindowLength = CONFIG_FMNA_UARP_PAYLOAD_WINDOW_SIZE;
 
 	accessory.send_message = send_message_callback;
+	accessory.process_request = process_request_callback;
+
+	if (IS_ENABLED(CONFIG_FMNA_UARP_RESUME)) {
+		checkpoint_load(&accessory);
+	}
+
+	if (IS_ENABLED(CONFIG_FMNA_UARP_FLASH_ASYNC)) {
+		fmna_uarp_flash_init(flash_notify);
+	}
 
 	callbacks.fRequestBuffer = request_buffer;
 	callbacks.fReturnBuffer = return_buffer;
@@ -1176,8 +1793,8 @@ bool fmna_uarp_init(fmna_uarp_send_message_fn send_message_callback)
 	callbacks.fStagedFirmwareVersion = query_staged_firmware_version;
 	callbacks.fLastError = query_last_error;
 
-	status = uarpPlatformAccessoryInit(&accessory.accessory, &options, &callbacks, NULL, NULL,
-					   (void *) &accessory);
+	status = uarpPlatformAccessoryInit(&accessory.accessory, &accessory.options, &callbacks,
+					   NULL, NULL, (void *) &accessory);
 
 	if (status != kUARPStatusSuccess) {
 		LOG_ERR("uarpPlatformControllerAdd failed, status 0x%04X", status);
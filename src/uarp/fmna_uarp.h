@@ -11,11 +11,24 @@
 
 #include <zephyr/net_buf.h>
 
+/* Queue the message for the transmission. The transport sends the queued messages in order
+ * and calls fmna_uarp_send_message_complete() for each of them in the same order. Up to
+ * CONFIG_FMNA_UARP_TX_QUEUE_SIZE messages can be queued at the same time.
+ */
 typedef uint32_t (*fmna_uarp_send_message_fn)(struct net_buf_simple *buf);
 
-bool fmna_uarp_init(fmna_uarp_send_message_fn send_message_callback);
+/* Request a call to fmna_uarp_process() from the UARP context. Can be called from any thread. */
+typedef void (*fmna_uarp_process_request_fn)(void);
+
+bool fmna_uarp_init(fmna_uarp_send_message_fn send_message_callback,
+		    fmna_uarp_process_request_fn process_request_callback);
+
+void fmna_uarp_process(void);
 
-void fmna_uarp_controller_add(void);
+/* Add the controller. The rx_chunk_size is the number of the message bytes carried by a single
+ * write of the controller, which depends on the ATT MTU of the connection.
+ */
+void fmna_uarp_controller_add(uint16_t rx_chunk_size);
 
 void fmna_uarp_controller_remove(void);
 
@@ -25,4 +38,9 @@ void fmna_uarp_send_message_complete(void);
 
 int fmna_uarp_img_confirm(void);
 
+/* Get the highest number of bytes allocated at the same time from the UARP message, asset and
+ * payload window pools.
+ */
+size_t fmna_uarp_mem_peak_get(void);
+
 #endif /* FMNA_UARP_H_ */
@@ -0,0 +1,359 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-4-Clause
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/byteorder.h>
+
+#include <zephyr/logging/log.h>
+#define LOG_MODULE_NAME fmna_uarp
+
+#include "fmna_uarp_decompress.h"
+
+LOG_MODULE_DECLARE(LOG_MODULE_NAME, CONFIG_FMNA_UARP_LOG_LEVEL);
+
+/* Compression TLV value: algorithm, window size, lookahead size, reserved
+ * byte and the big-endian decompressed size.
+ */
+#define PARAMS_LENGTH            8
+#define ALGORITHM_HEATSHRINK     1
+#define WINDOW_SZ2_MIN           4
+#define WINDOW_SZ2_MAX           CONFIG_FMNA_UARP_COMPRESSION_WINDOW_SZ2_MAX
+#define LOOKAHEAD_SZ2_MIN        3
+
+#define WINDOW_SIZE BIT(WINDOW_SZ2_MAX)
+#define WINDOW_MASK (WINDOW_SIZE - 1)
+
+/* The heatshrink stream is a sequence of MSB-first bit fields. A tag bit of 1
+ * is followed by an 8-bit literal, a tag bit of 0 by a back-reference with the
+ * window_sz2-bit distance and the lookahead_sz2-bit length, both minus one.
+ */
+enum decoder_state {
+	STATE_TAG,
+	STATE_LITERAL,
+	STATE_INDEX,
+	STATE_COUNT,
+};
+
+/* The window doubles as the output buffer. It is passed to the sink when it
+ * fills up and at the end of every compressed chunk. If the sink cannot take
+ * it, the decoding stops until fmna_uarp_decompress_resume is called.
+ */
+static uint8_t window[WINDOW_SIZE];
+
+/* Compressed input not decoded yet because the sink was full. */
+static uint8_t input[CONFIG_FMNA_UARP_PAYLOAD_WINDOW_SIZE];
+
+static struct {
+	struct fmna_uarp_decompress_params params;
+	fmna_uarp_decompress_sink_fn sink;
+	enum decoder_state state;
+	uint32_t bits;
+	uint8_t bit_count;
+	uint16_t index;
+	/* Number of decompressed bytes. */
+	uint32_t head;
+	/* Number of decompressed bytes passed to the sink. */
+	uint32_t flushed;
+	/* The buffered bits wait for the space in the window. */
+	bool suspended;
+	/* The sink returned less than it was given. */
+	bool blocked;
+	uint16_t input_offset;
+	uint16_t input_len;
+} decoder;
+
+int fmna_uarp_decompress_params_parse(const uint8_t *value, size_t length,
+				      struct fmna_uarp_decompress_params *params)
+{
+	__ASSERT(value, "NULL parameter");
+	__ASSERT(params, "NULL parameter");
+
+	if (length != PARAMS_LENGTH) {
+		return -EINVAL;
+	}
+
+	if (value[0] != ALGORITHM_HEATSHRINK) {
+		LOG_ERR("Unsupported compression algorithm %u", value[0]);
+		return -ENOTSUP;
+	}
+
+	params->window_sz2 = value[1];
+	params->lookahead_sz2 = value[2];
+	params->size = sys_get_be32(&value[4]);
+
+	if ((params->window_sz2 < WINDOW_SZ2_MIN) || (params->window_sz2 > WINDOW_SZ2_MAX) ||
+	    (params->lookahead_sz2 < LOOKAHEAD_SZ2_MIN) ||
+	    (params->lookahead_sz2 >= params->window_sz2)) {
+		LOG_ERR("Unsupported compression window %u, lookahead %u",
+			params->window_sz2, params->lookahead_sz2);
+		return -ENOTSUP;
+	}
+
+	return 0;
+}
+
+void fmna_uarp_decompress_start(const struct fmna_uarp_decompress_params *params,
+				fmna_uarp_decompress_sink_fn sink)
+{
+	__ASSERT(params, "NULL parameter");
+	__ASSERT(sink, "NULL parameter");
+
+	memset(&decoder, 0, sizeof(decoder));
+	decoder.params = *params;
+	decoder.sink = sink;
+	decoder.state = STATE_TAG;
+}
+
+static int flush(void)
+{
+	int ret;
+	size_t start;
+	size_t len;
+
+	while (decoder.flushed < decoder.head) {
+		start = decoder.flushed & WINDOW_MASK;
+		len = MIN(decoder.head - decoder.flushed, WINDOW_SIZE - start);
+
+		ret = decoder.sink(&window[start], len);
+		if (ret < 0) {
+			return ret;
+		}
+
+		decoder.flushed += ret;
+		if (ret < len) {
+			return -EAGAIN;
+		}
+	}
+
+	return 0;
+}
+
+static bool space_available(void)
+{
+	/* Room for the longest output of a single literal or back-reference. */
+	return (WINDOW_SIZE - (decoder.head - decoder.flushed)) >=
+	       BIT(decoder.params.lookahead_sz2);
+}
+
+static int space_reserve(void)
+{
+	int err;
+
+	if (space_available()) {
+		return 0;
+	}
+
+	err = flush();
+	if ((err == -EAGAIN) && space_available()) {
+		return 0;
+	}
+
+	return err;
+}
+
+static int emit(uint8_t byte)
+{
+	if (decoder.head == decoder.params.size) {
+		LOG_ERR("Decompressed data exceeds the payload size");
+		return -EBADMSG;
+	}
+
+	__ASSERT_NO_MSG(decoder.head - decoder.flushed < WINDOW_SIZE);
+
+	window[decoder.head & WINDOW_MASK] = byte;
+	decoder.head++;
+
+	return 0;
+}
+
+static int backref_copy(uint16_t index, uint16_t count)
+{
+	int err;
+
+	if (index > decoder.head) {
+		LOG_ERR("Back-reference before the start of the payload");
+		return -EBADMSG;
+	}
+
+	while (count-- > 0) {
+		err = emit(window[(decoder.head - index) & WINDOW_MASK]);
+		if (err) {
+			return err;
+		}
+	}
+
+	return 0;
+}
+
+static bool bits_get(uint8_t count, uint16_t *value)
+{
+	if (decoder.bit_count < count) {
+		return false;
+	}
+
+	decoder.bit_count -= count;
+	*value = (decoder.bits >> decoder.bit_count) & (BIT(count) - 1);
+
+	return true;
+}
+
+/* Decode the buffered bits. Returns -EAGAIN if the sink cannot take the output. */
+static int bits_decode(void)
+{
+	int err;
+	uint16_t value;
+
+	while (true) {
+		switch (decoder.state) {
+		case STATE_TAG:
+			err = space_reserve();
+			if (err) {
+				return err;
+			}
+
+			if (!bits_get(1, &value)) {
+				return 0;
+			}
+
+			decoder.state = value ? STATE_LITERAL : STATE_INDEX;
+			break;
+
+		case STATE_LITERAL:
+			if (!bits_get(8, &value)) {
+				return 0;
+			}
+
+			err = emit(value);
+			if (err) {
+				return err;
+			}
+
+			decoder.state = STATE_TAG;
+			break;
+
+		case STATE_INDEX:
+			if (!bits_get(decoder.params.window_sz2, &value)) {
+				return 0;
+			}
+
+			decoder.index = value + 1;
+			decoder.state = STATE_COUNT;
+			break;
+
+		case STATE_COUNT:
+			if (!bits_get(decoder.params.lookahead_sz2, &value)) {
+				return 0;
+			}
+
+			err = backref_copy(decoder.index, value + 1);
+			if (err) {
+				return err;
+			}
+
+			decoder.state = STATE_TAG;
+			break;
+		}
+	}
+}
+
+static int input_decode(const uint8_t *data, size_t len, size_t *consumed)
+{
+	int err;
+
+	*consumed = 0;
+
+	if (decoder.suspended) {
+		err = bits_decode();
+		if (err) {
+			return err;
+		}
+
+		decoder.suspended = false;
+	}
+
+	while (*consumed < len) {
+		decoder.bits = (decoder.bits << 8) | data[*consumed];
+		decoder.bit_count += 8;
+		(*consumed)++;
+
+		err = bits_decode();
+		if (err) {
+			decoder.suspended = (err == -EAGAIN);
+			return err;
+		}
+	}
+
+	return flush();
+}
+
+int fmna_uarp_decompress_write(const uint8_t *chunk, size_t chunk_size)
+{
+	int err;
+	size_t consumed;
+
+	__ASSERT_NO_MSG(decoder.sink);
+
+	if (decoder.blocked) {
+		return -EBUSY;
+	}
+
+	err = input_decode(chunk, chunk_size, &consumed);
+	if (err == -EAGAIN) {
+		/* Keep the rest of the chunk until the sink has space again. */
+		if (chunk_size - consumed > sizeof(input)) {
+			return -ENOMEM;
+		}
+
+		memcpy(input, &chunk[consumed], chunk_size - consumed);
+		decoder.input_offset = 0;
+		decoder.input_len = chunk_size - consumed;
+		decoder.blocked = true;
+	}
+
+	return err;
+}
+
+int fmna_uarp_decompress_resume(void)
+{
+	int err;
+	size_t consumed;
+
+	__ASSERT_NO_MSG(decoder.sink);
+
+	err = input_decode(&input[decoder.input_offset], decoder.input_len, &consumed);
+
+	decoder.input_offset += consumed;
+	decoder.input_len -= consumed;
+	decoder.blocked = (err == -EAGAIN);
+
+	return err;
+}
+
+int fmna_uarp_decompress_finish(void)
+{
+	int err;
+
+	__ASSERT_NO_MSG(decoder.sink);
+
+	err = fmna_uarp_decompress_resume();
+	if (err == -EAGAIN) {
+		return err;
+	}
+
+	decoder.sink = NULL;
+	if (err) {
+		return err;
+	}
+
+	/* The trailing bits of the last byte are zero padding. */
+	if (decoder.head != decoder.params.size) {
+		LOG_ERR("Decompressed size %u does not match the payload size %u",
+			decoder.head, decoder.params.size);
+		return -EBADMSG;
+	}
+
+	return 0;
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-4-Clause
+ */
+
+#ifndef FMNA_UARP_DECOMPRESS_H_
+#define FMNA_UARP_DECOMPRESS_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <zephyr/kernel.h>
+
+/** Compression parameters received in the payload metadata. */
+struct fmna_uarp_decompress_params {
+	/** Base-2 logarithm of the back-reference window size. */
+	uint8_t window_sz2;
+	/** Base-2 logarithm of the maximum back-reference length. */
+	uint8_t lookahead_sz2;
+	/** Size of the decompressed payload. */
+	uint32_t size;
+};
+
+/** Callback that receives the decompressed data.
+ *
+ * @return Number of bytes taken, which is less than @p len if the sink is
+ *         full, or negative error code.
+ */
+typedef int (*fmna_uarp_decompress_sink_fn)(const uint8_t *data, size_t len);
+
+/** Parse the compression parameters from the payload metadata TLV value.
+ *
+ * @param value TLV value.
+ * @param length TLV value length.
+ * @param params Parsed compression parameters.
+ *
+ * @return 0 on success, -EINVAL if the TLV is malformed or -ENOTSUP if the
+ *         compression is not supported.
+ */
+int fmna_uarp_decompress_params_parse(const uint8_t *value, size_t length,
+				      struct fmna_uarp_decompress_params *params);
+
+/** Start decompressing a payload.
+ *
+ * @param params Compression parameters.
+ * @param sink Callback that receives the decompressed data.
+ */
+void fmna_uarp_decompress_start(const struct fmna_uarp_decompress_params *params,
+				fmna_uarp_decompress_sink_fn sink);
+
+/** Decompress the chunk of the compressed payload.
+ *
+ * If the sink is full, the rest of the chunk is kept and the function returns
+ * -EAGAIN. The decoding continues with @ref fmna_uarp_decompress_resume.
+ *
+ * @param chunk Pointer to the chunk's data.
+ * @param chunk_size Size of the chunk.
+ *
+ * @return 0 on success, -EAGAIN if the sink is full, -EBUSY if the previous
+ *         chunk is not decompressed yet, -ENOMEM if the rest of the chunk does
+ *         not fit the input buffer, -EBADMSG if the compressed data is
+ *         corrupted or the error code returned by the sink.
+ */
+int fmna_uarp_decompress_write(const uint8_t *chunk, size_t chunk_size);
+
+/** Continue decompressing the chunk after the sink returned less than it was given.
+ *
+ * @return 0 if the chunk is decompressed and passed to the sink, -EAGAIN if
+ *         the sink is full again, otherwise negative error code.
+ */
+int fmna_uarp_decompress_resume(void);
+
+/** Pass the remaining decompressed data to the sink and check the payload size.
+ *
+ * @return 0 on success, -EAGAIN if the sink is full, otherwise negative error
+ *         code.
+ */
+int fmna_uarp_decompress_finish(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* FMNA_UARP_DECOMPRESS_H_ */
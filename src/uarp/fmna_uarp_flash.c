@@ -0,0 +1,251 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-4-Clause
+ */
+
+#include <zephyr/kernel.h>
+
+#include <zephyr/logging/log.h>
+#define LOG_MODULE_NAME fmna_uarp
+
+#include "fmna_uarp_flash.h"
+
+LOG_MODULE_DECLARE(LOG_MODULE_NAME, CONFIG_FMNA_UARP_LOG_LEVEL);
+
+#define BUF_SIZE  CONFIG_FMNA_UARP_FLASH_BUF_SIZE
+#define BUF_COUNT CONFIG_FMNA_UARP_FLASH_BUF_COUNT
+
+/* A single payload window must always fit into an empty buffer. */
+BUILD_ASSERT(BUF_SIZE >= CONFIG_FMNA_UARP_PAYLOAD_WINDOW_SIZE);
+
+enum stage_flag {
+	STAGE_FLAG_SPACE_REQUESTED,
+	STAGE_FLAG_ABORTED,
+
+	STAGE_FLAG_COUNT,
+};
+
+struct flash_buf {
+	void *fifo_reserved;
+	size_t len;
+	uint8_t data[BUF_SIZE];
+};
+
+static struct {
+	const struct fmna_uarp_writer *writer;
+	fmna_uarp_flash_notify_fn notify;
+	/* Buffer filled in the UARP context, not yet passed to the flash thread. */
+	struct flash_buf *fill_buf;
+	atomic_t err;
+	ATOMIC_DEFINE(flags, STAGE_FLAG_COUNT);
+} stage;
+
+/* Marks the end of the queued buffers. It is never allocated from the slab. */
+static struct {
+	void *fifo_reserved;
+} barrier;
+
+K_MEM_SLAB_DEFINE_STATIC(flash_buf_slab, sizeof(struct flash_buf), BUF_COUNT, 4);
+static K_FIFO_DEFINE(flash_buf_fifo);
+static K_SEM_DEFINE(barrier_sem, 0, 1);
+
+void fmna_uarp_flash_init(fmna_uarp_flash_notify_fn notify_callback)
+{
+	__ASSERT(notify_callback, "NULL parameter");
+
+	stage.notify = notify_callback;
+}
+
+int fmna_uarp_flash_start(const struct fmna_uarp_writer *writer, size_t payload_size,
+			  size_t offset)
+{
+	int err;
+
+	__ASSERT(writer, "NULL parameter");
+	__ASSERT_NO_MSG(!stage.writer);
+
+	atomic_set(&stage.err, 0);
+	atomic_clear(stage.flags);
+
+	if (offset > 0) {
+		err = fmna_uarp_writer_transfer_resume(writer, payload_size, offset);
+	} else {
+		err = fmna_uarp_writer_transfer_start(writer, payload_size);
+	}
+
+	if (!err) {
+		stage.writer = writer;
+	}
+
+	return err;
+}
+
+int fmna_uarp_flash_write(const uint8_t *chunk, size_t chunk_size)
+{
+	int err;
+	size_t len;
+
+	__ASSERT_NO_MSG(stage.writer);
+
+	err = atomic_get(&stage.err);
+	if (err) {
+		return err;
+	}
+
+	while (chunk_size > 0) {
+		if (!stage.fill_buf) {
+			if (k_mem_slab_alloc(&flash_buf_slab, (void **)&stage.fill_buf,
+					     K_NO_WAIT)) {
+				LOG_ERR("No free flash buffer");
+				return -ENOBUFS;
+			}
+
+			stage.fill_buf->len = 0;
+		}
+
+		len = MIN(chunk_size, BUF_SIZE - stage.fill_buf->len);
+		memcpy(&stage.fill_buf->data[stage.fill_buf->len], chunk, len);
+		stage.fill_buf->len += len;
+		chunk += len;
+		chunk_size -= len;
+
+		if (stage.fill_buf->len == BUF_SIZE) {
+			k_fifo_put(&flash_buf_fifo, stage.fill_buf);
+			stage.fill_buf = NULL;
+		}
+	}
+
+	return 0;
+}
+
+size_t fmna_uarp_flash_space_get(void)
+{
+	size_t space;
+
+	space = k_mem_slab_num_free_get(&flash_buf_slab) * BUF_SIZE;
+	if (stage.fill_buf) {
+		space += BUF_SIZE - stage.fill_buf->len;
+	}
+
+	return space;
+}
+
+static bool space_available(size_t window_size)
+{
+	return fmna_uarp_flash_space_get() >= window_size;
+}
+
+bool fmna_uarp_flash_space_request(size_t window_size)
+{
+	__ASSERT_NO_MSG(window_size <= BUF_SIZE);
+
+	if (space_available(window_size)) {
+		return true;
+	}
+
+	atomic_set_bit(stage.flags, STAGE_FLAG_SPACE_REQUESTED);
+
+	/* The flash thread could release a buffer before the request was set. */
+	if (space_available(window_size)) {
+		atomic_clear_bit(stage.flags, STAGE_FLAG_SPACE_REQUESTED);
+		return true;
+	}
+
+	return false;
+}
+
+static void barrier_wait(void)
+{
+	k_fifo_put(&flash_buf_fifo, &barrier);
+	k_sem_take(&barrier_sem, K_FOREVER);
+}
+
+int fmna_uarp_flash_sync(void)
+{
+	__ASSERT_NO_MSG(stage.writer);
+
+	barrier_wait();
+
+	return atomic_get(&stage.err);
+}
+
+int fmna_uarp_flash_error_get(void)
+{
+	return atomic_get(&stage.err);
+}
+
+int fmna_uarp_flash_finish(bool success)
+{
+	int err;
+	int ret;
+
+	__ASSERT_NO_MSG(stage.writer);
+
+	if (!success) {
+		atomic_set_bit(stage.flags, STAGE_FLAG_ABORTED);
+	}
+
+	if (stage.fill_buf) {
+		if (success) {
+			k_fifo_put(&flash_buf_fifo, stage.fill_buf);
+		} else {
+			k_mem_slab_free(&flash_buf_slab, stage.fill_buf);
+		}
+		stage.fill_buf = NULL;
+	}
+
+	barrier_wait();
+
+	err = atomic_get(&stage.err);
+	if (err) {
+		success = false;
+	}
+
+	ret = fmna_uarp_writer_transfer_finish(stage.writer, success);
+	stage.writer = NULL;
+
+	return err ? err : ret;
+}
+
+static void buf_write(struct flash_buf *buf)
+{
+	int err;
+
+	if (atomic_test_bit(stage.flags, STAGE_FLAG_ABORTED) || atomic_get(&stage.err)) {
+		return;
+	}
+
+	err = fmna_uarp_writer_transfer_write(stage.writer, buf->data, buf->len);
+	if (err) {
+		LOG_ERR("fmna_uarp_writer_transfer_write returned error: %d", err);
+		atomic_set(&stage.err, err);
+		stage.notify();
+	}
+}
+
+static void flash_thread_entry_point(void *arg0, void *arg1, void *arg2)
+{
+	void *buf;
+
+	while (true) {
+		buf = k_fifo_get(&flash_buf_fifo, K_FOREVER);
+		if (buf == (void *)&barrier) {
+			k_sem_give(&barrier_sem);
+			continue;
+		}
+
+		buf_write(buf);
+		k_mem_slab_free(&flash_buf_slab, buf);
+
+		if (atomic_test_and_clear_bit(stage.flags, STAGE_FLAG_SPACE_REQUESTED)) {
+			stage.notify();
+		}
+	}
+}
+
+K_THREAD_DEFINE(fmna_uarp_flash_thread, CONFIG_FMNA_UARP_FLASH_THREAD_STACK_SIZE,
+		flash_thread_entry_point, NULL, NULL, NULL,
+		CONFIG_FMNA_UARP_FLASH_THREAD_PRIORITY < CONFIG_NUM_PREEMPT_PRIORITIES ?
+			CONFIG_FMNA_UARP_FLASH_THREAD_PRIORITY : CONFIG_NUM_PREEMPT_PRIORITIES - 1,
+		0, 0);
@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-4-Clause
+ */
+
+#ifndef FMNA_UARP_FLASH_H_
+#define FMNA_UARP_FLASH_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <zephyr/kernel.h>
+
+#include "fmna_uarp_writer.h"
+
+/** Callback called from the flash thread when a buffer previously requested with
+ *  @ref fmna_uarp_flash_space_request becomes available or when a write fails.
+ */
+typedef void (*fmna_uarp_flash_notify_fn)(void);
+
+/** Initialize the flash stage.
+ *
+ * @param notify_callback Callback called from the flash thread.
+ */
+void fmna_uarp_flash_init(fmna_uarp_flash_notify_fn notify_callback);
+
+/** Start the payload transfer with the given writer.
+ *
+ * The writer is prepared synchronously in the caller context.
+ *
+ * @param writer UARP payload writer structure.
+ * @param payload_size Payload size.
+ * @param offset Offset of the first written byte. A non-zero offset resumes
+ *               an interrupted transfer.
+ *
+ * @return 0 on success, otherwise negative error code.
+ */
+int fmna_uarp_flash_start(const struct fmna_uarp_writer *writer, size_t payload_size,
+			  size_t offset);
+
+/** Copy the payload chunk to the flash stage buffers.
+ *
+ * Full buffers are written by the flash thread. The function never blocks.
+ *
+ * @param chunk Pointer to the chunk's data.
+ * @param chunk_size Size of the chunk.
+ *
+ * @return 0 on success, -ENOBUFS if the buffers are full or the error code
+ *         of a failed write done by the flash thread.
+ */
+int fmna_uarp_flash_write(const uint8_t *chunk, size_t chunk_size);
+
+/** Get the number of bytes that can be written without blocking.
+ *
+ * @return Free space in the flash stage buffers.
+ */
+size_t fmna_uarp_flash_space_get(void);
+
+/** Check if the next payload window fits into the flash stage buffers.
+ *
+ * If it does not fit, the notify callback is called once a buffer is released.
+ *
+ * @param window_size Size of the payload window, must not exceed the flash buffer size.
+ *
+ * @return true if the next payload window can be written, false otherwise.
+ */
+bool fmna_uarp_flash_space_request(size_t window_size);
+
+/** Wait until the flash thread writes all full buffers.
+ *
+ * The data in the partially filled buffer is not written.
+ *
+ * @return 0 on success, otherwise negative error code.
+ */
+int fmna_uarp_flash_sync(void);
+
+/** Get the error code of a failed write done by the flash thread.
+ *
+ * @return 0 if all writes succeeded, otherwise negative error code.
+ */
+int fmna_uarp_flash_error_get(void);
+
+/** Wait until the flash thread writes the buffered data and complete the transfer.
+ *
+ * If the transfer is not successful, the buffered data is discarded.
+ *
+ * @param success Indicates that the UARP payload has been successfully processed.
+ *
+ * @return 0 on success, otherwise negative error code.
+ */
+int fmna_uarp_flash_finish(bool success);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* FMNA_UARP_FLASH_H_ */
@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-4-Clause
+ */
+
+#include <string.h>
+
+#include "fmna_uarp_pool.h"
+
+void *fmna_uarp_pool_alloc(struct fmna_uarp_pool *pool, size_t size)
+{
+	k_spinlock_key_t key;
+	uint8_t *block = NULL;
+
+	__ASSERT(pool, "NULL parameter");
+
+	if (size > pool->block_size) {
+		return NULL;
+	}
+
+	for (size_t i = 0; i < pool->block_count; i++) {
+		if (!atomic_test_and_set_bit(pool->allocated, i)) {
+			block = &pool->buf[i * pool->block_size];
+			break;
+		}
+	}
+
+	key = k_spin_lock(&pool->lock);
+
+	if (block) {
+		pool->stats.used++;
+		pool->stats.high_water = MAX(pool->stats.high_water, pool->stats.used);
+	} else {
+		pool->stats.failures++;
+	}
+
+	k_spin_unlock(&pool->lock, key);
+
+	if (block) {
+		memset(block, 0, pool->block_size);
+	}
+
+	return block;
+}
+
+void fmna_uarp_pool_free(struct fmna_uarp_pool *pool, void *block)
+{
+	k_spinlock_key_t key;
+	size_t i;
+
+	__ASSERT(pool, "NULL parameter");
+	__ASSERT(fmna_uarp_pool_owns(pool, block), "Block does not belong to the pool");
+
+	i = ((uint8_t *)block - pool->buf) / pool->block_size;
+
+	key = k_spin_lock(&pool->lock);
+	pool->stats.used--;
+	k_spin_unlock(&pool->lock, key);
+
+	atomic_clear_bit(pool->allocated, i);
+}
+
+bool fmna_uarp_pool_owns(const struct fmna_uarp_pool *pool, const void *ptr)
+{
+	const uint8_t *p = ptr;
+
+	return (p >= pool->buf) && (p < &pool->buf[pool->block_count * pool->block_size]) &&
+	       (((p - pool->buf) % pool->block_size) == 0);
+}
+
+void fmna_uarp_pool_stats_get(struct fmna_uarp_pool *pool, struct fmna_uarp_pool_stats *stats)
+{
+	k_spinlock_key_t key;
+
+	__ASSERT(pool, "NULL parameter");
+	__ASSERT(stats, "NULL parameter");
+
+	key = k_spin_lock(&pool->lock);
+	*stats = pool->stats;
+	k_spin_unlock(&pool->lock, key);
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-4-Clause
+ */
+
+#ifndef FMNA_UARP_POOL_H_
+#define FMNA_UARP_POOL_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+
+#define FMNA_UARP_POOL_BLOCK_ALIGN 8
+
+struct fmna_uarp_pool_stats {
+	/* Number of blocks currently allocated. */
+	uint32_t used;
+	/* Highest number of blocks allocated at the same time. */
+	uint32_t high_water;
+	/* Number of allocations that failed because the pool was empty. */
+	uint32_t failures;
+};
+
+/* Fixed-size block pool. Use @ref FMNA_UARP_POOL_DEFINE to define it. */
+struct fmna_uarp_pool {
+	uint8_t *buf;
+	size_t block_size;
+	size_t block_count;
+	atomic_t *allocated;
+	struct k_spinlock lock;
+	struct fmna_uarp_pool_stats stats;
+};
+
+/** Statically define a pool of blocks.
+ *
+ * @param _name Name of the pool.
+ * @param _block_size Size of a single block.
+ * @param _block_count Number of blocks.
+ */
+#define FMNA_UARP_POOL_DEFINE(_name, _block_size, _block_count)				\
+	static uint8_t _name##_buf[(_block_count) *						\
+				   ROUND_UP(_block_size, FMNA_UARP_POOL_BLOCK_ALIGN)]		\
+		__aligned(FMNA_UARP_POOL_BLOCK_ALIGN);						\
+	static ATOMIC_DEFINE(_name##_allocated, _block_count);				\
+	static struct fmna_uarp_pool _name = {							\
+		.buf = _name##_buf,								\
+		.block_size = ROUND_UP(_block_size, FMNA_UARP_POOL_BLOCK_ALIGN),		\
+		.block_count = (_block_count),							\
+		.allocated = _name##_allocated,							\
+	}
+
+/** Allocate a zeroed block from the pool. The function never blocks and can be
+ *  called from any thread.
+ *
+ * @param pool Pool of blocks.
+ * @param size Requested size, must not exceed the pool block size.
+ *
+ * @return Pointer to the block or NULL if the pool is empty.
+ */
+void *fmna_uarp_pool_alloc(struct fmna_uarp_pool *pool, size_t size);
+
+/** Return the block to the pool.
+ *
+ * @param pool Pool of blocks.
+ * @param block Block allocated from the pool.
+ */
+void fmna_uarp_pool_free(struct fmna_uarp_pool *pool, void *block);
+
+/** Check if the pointer points to a block of the pool.
+ *
+ * @param pool Pool of blocks.
+ * @param ptr Checked pointer.
+ *
+ * @return true if the pointer belongs to the pool, false otherwise.
+ */
+bool fmna_uarp_pool_owns(const struct fmna_uarp_pool *pool, const void *ptr);
+
+/** Get the usage statistics of the pool.
+ *
+ * @param pool Pool of blocks.
+ * @param stats Statistics structure to be filled.
+ */
+void fmna_uarp_pool_stats_get(struct fmna_uarp_pool *pool, struct fmna_uarp_pool_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* FMNA_UARP_POOL_H_ */
@@ -12,6 +12,7 @@
 #include <zephyr/bluetooth/conn.h>
 #include <zephyr/bluetooth/uuid.h>
 #include <zephyr/bluetooth/gatt.h>
+#include <zephyr/bluetooth/l2cap.h>
 #include <zephyr/net_buf.h>
 
 #include <zephyr/logging/log.h>
@@ -23,7 +24,9 @@
 #include "fmna_gatt_pkt_manager.h"
 
 #include "fmna_conn.h"
+#include "fmna_conn_param.h"
 #include "fmna_uarp.h"
+#include "fmna_uarp_pool.h"
 
 LOG_MODULE_DECLARE(LOG_MODULE_NAME, CONFIG_FMNA_UARP_LOG_LEVEL);
 
@@ -33,12 +36,21 @@ LOG_MODULE_DECLARE(LOG_MODULE_NAME, CONFIG_FMNA_UARP_LOG_LEVEL);
 #define UARP_SVC_DATA_CP_CHAR_INDEX 2
 #define UARP_SVC_DATA_CP_MIN_WRITE_LENGTH 2
 #define MAX_RX_MESSAGE_SIZE (sizeof(union UARPMessages) + CONFIG_FMNA_UARP_RX_MSG_PAYLOAD_SIZE)
+/* A single write carries one chunk of the message and fits into the ATT MTU. */
+#define BT_ATT_WRITE_HEADER_LEN 3
+#define MAX_RX_WRITE_SIZE \
+	MIN(FMNA_GATT_PKT_HEADER_LEN + MAX_RX_MESSAGE_SIZE, BT_L2CAP_RX_MTU - BT_ATT_WRITE_HEADER_LEN)
+#define RX_EVENT_BLOCK_SIZE \
+	MAX(sizeof(struct rx_event), offsetof(struct rx_event, write_data.buf) + MAX_RX_WRITE_SIZE)
+#define TX_IND_COUNT CONFIG_FMNA_UARP_TX_INDICATION_COUNT
 
 enum rx_event_id
 {
 	RX_EVENT_DISCONNECT,
 	RX_EVENT_INDICATION_ACK,
 	RX_EVENT_WRITE,
+	RX_EVENT_PROCESS,
+	RX_EVENT_SEND,
 };
 
 struct rx_event {
@@ -49,6 +61,7 @@ struct rx_event {
 	{
 		struct
 		{
+			uint8_t ind_idx;
 			uint8_t err;
 		} indication_ack_data;
 		struct
@@ -59,11 +72,53 @@ struct rx_event {
 	};
 };
 
+/* RX events are allocated from a fixed pool to keep the heap off the per-packet path. */
+FMNA_UARP_POOL_DEFINE(rx_event_pool, RX_EVENT_BLOCK_SIZE, CONFIG_FMNA_UARP_RX_EVENT_COUNT);
+
+struct tx_ind {
+	struct bt_gatt_indicate_params params;
+	/* The last chunk of its message. */
+	bool is_final;
+	/* The chunk of a message that has already been dropped. */
+	bool is_dropped;
+	bool is_confirmed;
+	uint8_t err;
+};
+
+/* Outgoing messages in the send order. The messages are passed to the Bluetooth host
+ * in chunks, and up to TX_IND_COUNT chunks wait for the confirmation at the same time.
+ * The host sends the queued indications in order, so the next chunk leaves as soon as
+ * the previous one is confirmed instead of after the round trip through the UARP context.
+ */
+static struct {
+	struct net_buf_simple *msgs[CONFIG_FMNA_UARP_TX_QUEUE_SIZE];
+	uint8_t msg_head;
+	uint8_t msg_count;
+	/* Number of messages from the head with all chunks passed to the host. */
+	uint8_t msg_passed;
+	struct tx_ind inds[TX_IND_COUNT];
+	uint8_t ind_head;
+	uint8_t ind_count;
+} tx;
+
 static struct bt_conn *active_conn = NULL;
-static struct net_buf_simple *sending_buf = NULL;
 static K_FIFO_DEFINE(rx_buf_fifo);
 
-static bool submit_event_indication_ack(struct bt_conn *conn, uint8_t err);
+/* The process event is statically allocated as it is submitted from other threads. */
+static struct rx_event process_event = {
+	.id = RX_EVENT_PROCESS,
+};
+static atomic_t process_event_pending;
+
+/* The send event defers the transmission of a queued message out of the UARPDK call. */
+static struct rx_event send_event = {
+	.id = RX_EVENT_SEND,
+};
+static atomic_t send_event_pending;
+
+static void submit_event_process(void);
+static void submit_event_send(void);
+static bool submit_event_indication_ack(struct bt_conn *conn, uint8_t ind_idx, uint8_t err);
 static bool submit_event_write(struct bt_conn *conn, const uint8_t *buf, uint16_t len);
 
 static ssize_t data_cp_write(struct bt_conn *conn,
@@ -129,6 +184,10 @@ static ssize_t data_cp_write(struct bt_conn *conn,
 		return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
 	}
 
+	if (IS_ENABLED(CONFIG_FMNA_CONN_PARAM)) {
+		fmna_conn_param_activity(conn);
+	}
+
 	if (submit_event_write(conn, buf, len)) {
 		return len;
 	} else {
@@ -140,20 +199,22 @@ static void indication_ack_cb(struct bt_conn *conn,
 				   struct bt_gatt_indicate_params *params,
 				   uint8_t err)
 {
+	struct tx_ind *ind = CONTAINER_OF(params, struct tx_ind, params);
+
 	LOG_DBG("Received UARP CP indication ACK with status: 0x%04X", err);
-	submit_event_indication_ack(conn, err);
+	submit_event_indication_ack(conn, ind - tx.inds, err);
 }
 
 static uint32_t uarp_send_message(struct net_buf_simple *buf)
 {
-	uint8_t err = 0;
-
-	if (sending_buf) {
-		return kUARPStatusProcessingIncomplete;
+	if (tx.msg_count == ARRAY_SIZE(tx.msgs)) {
+		return kUARPStatusNoResources;
 	}
 
-	sending_buf = buf;
-	submit_event_indication_ack(active_conn, err);
+	tx.msgs[(tx.msg_head + tx.msg_count) % ARRAY_SIZE(tx.msgs)] = buf;
+	tx.msg_count++;
+
+	submit_event_send();
 	return kUARPStatusSuccess;
 }
 
@@ -162,7 +223,7 @@ static bool uarp_init(void)
 	static bool initialized = false;
 
 	if (!initialized) {
-		if (fmna_uarp_init(uarp_send_message)) {
+		if (fmna_uarp_init(uarp_send_message, submit_event_process)) {
 			initialized = true;
 		} else {
 			LOG_ERR("fmna_uarp_init: Initialization failed");
@@ -178,42 +239,164 @@ static void handle_disconnect(struct bt_conn *conn)
 		return;
 	}
 
-	sending_buf = NULL;
+	memset(&tx, 0, sizeof(tx));
 	fmna_uarp_controller_remove();
 	active_conn = NULL;
+
+	if (IS_ENABLED(CONFIG_FMNA_UARP_LOG_LEVEL_DBG)) {
+		struct fmna_uarp_pool_stats stats;
+
+		fmna_uarp_pool_stats_get(&rx_event_pool, &stats);
+		LOG_DBG("UARP RX event pool: used %u, high water %u, failures %u",
+			stats.used, stats.high_water, stats.failures);
+	}
 }
 
-static void handle_indication_ack(struct bt_conn *conn, uint8_t err)
+static void tx_msg_complete(void)
 {
-	int result;
-	static struct bt_gatt_indicate_params indicate_params;
+	tx.msg_head = (tx.msg_head + 1) % ARRAY_SIZE(tx.msgs);
+	tx.msg_count--;
+
+	fmna_uarp_send_message_complete();
+}
+
+static void tx_pump(void)
+{
+	int err;
 	uint8_t *chunk;
 	uint16_t chunk_len;
+	struct net_buf_simple *buf;
+	struct tx_ind *ind;
+
+	while (active_conn && (tx.ind_count < TX_IND_COUNT) && (tx.msg_passed < tx.msg_count)) {
+		buf = tx.msgs[(tx.msg_head + tx.msg_passed) % ARRAY_SIZE(tx.msgs)];
+
+		chunk = fmna_gatt_pkt_manager_chunk_prepare(active_conn, buf, &chunk_len);
+		if (chunk) {
+			ind = &tx.inds[(tx.ind_head + tx.ind_count) % TX_IND_COUNT];
+			ind->is_final = (buf->len == 0);
+			ind->is_dropped = false;
+			ind->is_confirmed = false;
+			ind->err = 0;
+
+			memset(&ind->params, 0, sizeof(ind->params));
+			ind->params.attr = &fmn_uarp_svc.attrs[UARP_SVC_DATA_CP_CHAR_INDEX];
+			ind->params.func = indication_ack_cb;
+			ind->params.data = chunk;
+			ind->params.len = chunk_len;
+#if CONFIG_BT_EATT
+			/* The chunks must arrive in order, so they cannot be spread over
+			 * the Enhanced ATT bearers.
+			 */
+			ind->params.chan_opt = BT_ATT_CHAN_OPT_UNENHANCED_ONLY;
+#endif
 
-	if (conn != active_conn || !sending_buf) {
-		return;
+			err = bt_gatt_indicate(active_conn, &ind->params);
+			if (!err) {
+				tx.ind_count++;
+				if (ind->is_final) {
+					tx.msg_passed++;
+				}
+				continue;
+			}
+
+			LOG_DBG("bt_gatt_indicate returned error: %d", err);
+		} else {
+			err = -EINVAL;
+		}
+
+		if (tx.ind_count > 0) {
+			/* Retry the chunk once the next confirmation releases the host
+			 * resources. The chunk header is pushed again on the retry.
+			 */
+			if (chunk) {
+				net_buf_simple_push(buf, chunk_len);
+				net_buf_simple_pull(buf, FMNA_GATT_PKT_HEADER_LEN);
+			}
+			return;
+		}
+
+		/* No chunk is outstanding, so the failed message is the head of the queue. */
+		LOG_ERR("UARP message dropped, err %d", err);
+		tx_msg_complete();
 	}
+}
 
-	chunk = fmna_gatt_pkt_manager_chunk_prepare(conn, sending_buf, &chunk_len);
+static bool tx_ind_is_outstanding(uint8_t ind_idx)
+{
+	return ((ind_idx + TX_IND_COUNT - tx.ind_head) % TX_IND_COUNT) < tx.ind_count;
+}
 
-	if (!chunk || err) {
-		sending_buf = NULL;
-		fmna_uarp_send_message_complete();
-		return;
+static void tx_msg_drop(void)
+{
+	struct tx_ind *ind;
+
+	/* The remaining chunks of the head message are not sent. The chunks already
+	 * passed to the host are retired without the completion.
+	 */
+	for (uint8_t i = 0; i < tx.ind_count; i++) {
+		ind = &tx.inds[(tx.ind_head + i) % TX_IND_COUNT];
+		ind->is_dropped = true;
+		if (ind->is_final) {
+			ind->is_final = false;
+			tx.msg_passed--;
+			break;
+		}
+	}
+
+	tx_msg_complete();
+}
+
+static void tx_ind_retire(void)
+{
+	struct tx_ind *ind;
+
+	/* The chunks are retired in the send order, so the head message is the
+	 * message of the retired chunk.
+	 */
+	while (tx.ind_count > 0) {
+		ind = &tx.inds[tx.ind_head];
+		if (!ind->is_confirmed) {
+			break;
+		}
+
+		tx.ind_head = (tx.ind_head + 1) % TX_IND_COUNT;
+		tx.ind_count--;
+
+		if (ind->is_dropped) {
+			continue;
+		}
+
+		if (ind->err) {
+			LOG_ERR("UARP indication failed, err 0x%02X, message dropped", ind->err);
+			if (ind->is_final) {
+				tx.msg_passed--;
+				tx_msg_complete();
+			} else {
+				tx_msg_drop();
+			}
+		} else if (ind->is_final) {
+			tx.msg_passed--;
+			tx_msg_complete();
+		}
 	}
+}
 
-	memset(&indicate_params, 0, sizeof(indicate_params));
-	indicate_params.attr = &fmn_uarp_svc.attrs[UARP_SVC_DATA_CP_CHAR_INDEX];
-	indicate_params.func = indication_ack_cb;
-	indicate_params.data = chunk;
-	indicate_params.len = chunk_len;
-
-	result = bt_gatt_indicate(active_conn, &indicate_params);
-	if (result) {
-		LOG_ERR("bt_gatt_indicate returned error: %d", err);
-		sending_buf = NULL;
-		fmna_uarp_send_message_complete();
+static void handle_indication_ack(struct bt_conn *conn, uint8_t ind_idx, uint8_t err)
+{
+	struct tx_ind *ind;
+
+	if ((conn != active_conn) || (ind_idx >= TX_IND_COUNT) ||
+	    !tx_ind_is_outstanding(ind_idx)) {
+		return;
 	}
+
+	ind = &tx.inds[ind_idx];
+	ind->is_confirmed = true;
+	ind->err = err;
+
+	tx_ind_retire();
+	tx_pump();
 }
 
 static void handle_write(struct bt_conn *conn, uint8_t *buf, uint16_t len)
@@ -234,7 +417,8 @@ static void handle_write(struct bt_conn *conn, uint8_t *buf, uint16_t len)
 			LOG_INF("Active UARP connection is 0x%08X", (int)conn);
 
 			active_conn = conn;
-			fmna_uarp_controller_add();
+			fmna_uarp_controller_add(bt_gatt_get_mtu(conn) - BT_ATT_WRITE_HEADER_LEN -
+						 FMNA_GATT_PKT_HEADER_LEN);
 			net_buf_simple_reset(&rx_buf);
 		} else {
 			LOG_ERR("UARP is already active on connection 0x%08X", (int)conn);
@@ -259,14 +443,27 @@ static void handle_write(struct bt_conn *conn, uint8_t *buf, uint16_t len)
 
 static void handle_rx_event(struct rx_event *event)
 {
+	if (event->id == RX_EVENT_PROCESS) {
+		atomic_clear(&process_event_pending);
+		fmna_uarp_process();
+		return;
+	}
+
+	if (event->id == RX_EVENT_SEND) {
+		atomic_clear(&send_event_pending);
+		tx_pump();
+		return;
+	}
+
 	if (event->id == RX_EVENT_DISCONNECT) {
 		handle_disconnect(event->conn);
 	} else if (event->id == RX_EVENT_INDICATION_ACK) {
-		handle_indication_ack(event->conn, event->indication_ack_data.err);
+		handle_indication_ack(event->conn, event->indication_ack_data.ind_idx,
+				      event->indication_ack_data.err);
 	} else {
 		handle_write(event->conn, event->write_data.buf, event->write_data.len);
 	}
-	k_free(event);
+	fmna_uarp_pool_free(&rx_event_pool, event);
 }
 
 #ifdef CONFIG_FMNA_UARP_DEDICATED_THREAD
@@ -321,8 +518,9 @@ static bool submit_event_disconnect(struct bt_conn *conn)
 {
 	struct rx_event *event;
 
-	event = k_malloc(sizeof(struct rx_event));
+	event = fmna_uarp_pool_alloc(&rx_event_pool, sizeof(struct rx_event));
 	if (event == NULL) {
+		LOG_ERR("No free UARP RX event");
 		return false;
 	}
 
@@ -337,17 +535,45 @@ static bool submit_event_disconnect(struct bt_conn *conn)
 	return true;
 }
 
-static bool submit_event_indication_ack(struct bt_conn *conn, uint8_t err)
+static void submit_event_process(void)
+{
+	if (!atomic_cas(&process_event_pending, 0, 1)) {
+		return;
+	}
+
+	k_fifo_put(&rx_buf_fifo, &process_event);
+
+#ifndef CONFIG_FMNA_UARP_DEDICATED_THREAD
+	k_work_submit(&rx_work);
+#endif
+}
+
+static void submit_event_send(void)
+{
+	if (!atomic_cas(&send_event_pending, 0, 1)) {
+		return;
+	}
+
+	k_fifo_put(&rx_buf_fifo, &send_event);
+
+#ifndef CONFIG_FMNA_UARP_DEDICATED_THREAD
+	k_work_submit(&rx_work);
+#endif
+}
+
+static bool submit_event_indication_ack(struct bt_conn *conn, uint8_t ind_idx, uint8_t err)
 {
 	struct rx_event *event;
 
-	event = k_malloc(sizeof(struct rx_event));
+	event = fmna_uarp_pool_alloc(&rx_event_pool, sizeof(struct rx_event));
 	if (event == NULL) {
+		LOG_ERR("No free UARP RX event");
 		return false;
 	}
 
 	event->id = RX_EVENT_INDICATION_ACK;
 	event->conn = conn;
+	event->indication_ack_data.ind_idx = ind_idx;
 	event->indication_ack_data.err = err;
 
 	k_fifo_put(&rx_buf_fifo, event);
@@ -362,8 +588,9 @@ static bool submit_event_write(struct bt_conn *conn, const uint8_t *buf, uint16_
 {
 	struct rx_event *event;
 
-	event = k_malloc(offsetof(struct rx_event, write_data.buf) + len);
+	event = fmna_uarp_pool_alloc(&rx_event_pool, offsetof(struct rx_event, write_data.buf) + len);
 	if (!event) {
+		LOG_ERR("No free UARP RX event for write of length %u", len);
 		return false;
 	}
 
@@ -12,16 +12,87 @@ LOG_MODULE_DECLARE(fmna_uarp_payload);
 #include "fmna_uarp_payload.h"
 #include "fmna_uarp_writer.h"
 #include "fmna_uarp_writer_mcuboot.h"
+#include "fmna_uarp_writer_delta.h"
 
 #include <pm_config.h>
 
-/** In swap mode, we are writing primary slot candidate image to the second slot.
- *  MCUboot bootloader will then move it to the primary slot.
+/** In swap and overwrite-only modes, we are writing primary slot candidate image to the
+ *  second slot. MCUboot bootloader will then move it to the primary slot.
  */
 #define TARGET_RUNNING_FA_ID	PM_MCUBOOT_PRIMARY_ID
 #define TARGET_WRITE_FA_ID	PM_MCUBOOT_SECONDARY_ID
 #define TARGET_4CC_TAG		CONFIG_FMNA_UARP_PAYLOAD_MCUBOOT_APP_S0_4CC_TAG
 
+/** In direct-XIP mode, the image is executed from the slot it is written to. The primary
+ *  and secondary slot images are written directly to their slots while the device runs
+ *  from the other slot.
+ */
+#define TARGET_S0_WRITE_FA_ID	PM_MCUBOOT_PRIMARY_ID
+#define TARGET_S0_RUNNING_FA_ID	PM_MCUBOOT_SECONDARY_ID
+#define TARGET_S1_WRITE_FA_ID	PM_MCUBOOT_SECONDARY_ID
+#define TARGET_S1_RUNNING_FA_ID	PM_MCUBOOT_PRIMARY_ID
+#define TARGET_S1_4CC_TAG	CONFIG_FMNA_UARP_PAYLOAD_MCUBOOT_APP_S1_4CC_TAG
+
+/** The delta payload is a patch against the image in the primary slot. The reconstructed
+ *  image is written to the second slot by the same MCUboot writer as the full image.
+ */
+#define DELTA_SOURCE_FA_ID	PM_MCUBOOT_PRIMARY_ID
+#define DELTA_4CC_TAG		CONFIG_FMNA_UARP_PAYLOAD_MCUBOOT_APP_DELTA_4CC_TAG
+
+#if CONFIG_FMNA_UARP_WRITER_MCUBOOT_DIRECT_XIP
+static bool slot_accept(const struct fmna_uarp_payload_header *curr_header, uint8_t write_fa_id)
+{
+	if (fmna_uarp_writer_mcuboot_slot_is_running(write_fa_id)) {
+		LOG_INF("Skipping MCUboot image payload with tag: \"%s\" for the running slot",
+			curr_header->tag_4cc);
+		return false;
+	}
+
+	LOG_INF("Accepting MCUboot image payload with tag: \"%s\","
+		" version: %d.%d.%d+%d",
+		curr_header->tag_4cc,
+		curr_header->version.major,
+		curr_header->version.minor,
+		curr_header->version.release,
+		curr_header->version.build);
+
+	return true;
+}
+
+static bool s0_accept(const struct fmna_uarp_payload_header *curr_header)
+{
+	return slot_accept(curr_header, TARGET_S0_WRITE_FA_ID);
+}
+
+static bool s1_accept(const struct fmna_uarp_payload_header *curr_header)
+{
+	return slot_accept(curr_header, TARGET_S1_WRITE_FA_ID);
+}
+
+static const struct fmna_uarp_payload_cb s0_cbs = {
+	.accept = s0_accept,
+};
+
+static const struct fmna_uarp_payload_cb s1_cbs = {
+	.accept = s1_accept,
+};
+
+FMNA_UARP_WRITER_MCUBOOT_DEF(payload_app_mcuboot_s0_writer,
+			     TARGET_S0_WRITE_FA_ID,
+			     TARGET_S0_RUNNING_FA_ID);
+FMNA_UARP_PAYLOAD_REGISTER(payload_app_primary_slot,
+			   TARGET_4CC_TAG,
+			   &payload_app_mcuboot_s0_writer,
+			   &s0_cbs);
+
+FMNA_UARP_WRITER_MCUBOOT_DEF(payload_app_mcuboot_s1_writer,
+			     TARGET_S1_WRITE_FA_ID,
+			     TARGET_S1_RUNNING_FA_ID);
+FMNA_UARP_PAYLOAD_REGISTER(payload_app_secondary_slot,
+			   TARGET_S1_4CC_TAG,
+			   &payload_app_mcuboot_s1_writer,
+			   &s1_cbs);
+#else
 static bool accept(const struct fmna_uarp_payload_header *curr_header)
 {
 	ARG_UNUSED(curr_header);
@@ -46,3 +117,14 @@ FMNA_UARP_PAYLOAD_REGISTER(payload_app_primary_slot,
 			   TARGET_4CC_TAG,
 			   &payload_app_mcuboot_writer,
 			   &cbs);
+#endif
+
+#if CONFIG_FMNA_UARP_PAYLOAD_MCUBOOT_APP_DELTA
+FMNA_UARP_WRITER_DELTA_DEF(payload_app_delta_writer,
+			   &payload_app_mcuboot_writer,
+			   DELTA_SOURCE_FA_ID);
+FMNA_UARP_PAYLOAD_REGISTER(payload_app_primary_slot_delta,
+			   DELTA_4CC_TAG,
+			   &payload_app_delta_writer,
+			   &cbs);
+#endif
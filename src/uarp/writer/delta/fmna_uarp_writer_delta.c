@@ -0,0 +1,380 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-4-Clause
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/storage/flash_map.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/crc.h>
+
+#include "fmna_uarp_writer.h"
+#include "fmna_uarp_writer_delta.h"
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(fmna_uarp_writer_delta, CONFIG_FMNA_UARP_WRITER_DELTA_LOG_LEVEL);
+
+/* The patch starts with a header: magic, version, three reserved bytes, the source
+ * image size, the CRC-32 of the source image and the target image size. It is
+ * followed by a sequence of entries. Each entry consists of a control field: the
+ * diff length, the extra length and the signed source seek, followed by the diff
+ * bytes and the extra bytes. The diff bytes are added to the source image bytes,
+ * the extra bytes are copied to the target image as they are. All fields are
+ * big-endian.
+ */
+#define PATCH_MAGIC		0x464D4450 /* "FMDP" */
+#define PATCH_VERSION		1
+#define PATCH_HEADER_LEN	20
+#define PATCH_CONTROL_LEN	12
+
+enum patch_state {
+	STATE_HEADER,
+	STATE_CONTROL,
+	STATE_DIFF,
+	STATE_EXTRA,
+};
+
+static atomic_t in_progress = ATOMIC_INIT(false);
+
+static uint8_t buf[CONFIG_FMNA_UARP_WRITER_DELTA_BUF_SIZE] __aligned(4);
+
+static struct {
+	const struct fmna_uarp_writer_delta_ctx *ctx;
+	const struct flash_area *source_fap;
+	bool target_started;
+	enum patch_state state;
+	uint8_t field[PATCH_HEADER_LEN];
+	size_t field_len;
+	uint32_t source_size;
+	uint32_t target_size;
+	uint32_t source_offset;
+	uint32_t target_offset;
+	/* Source offset after the current entry is applied. */
+	uint32_t source_next;
+	uint32_t diff_len;
+	uint32_t extra_len;
+} patch;
+
+static int source_crc_check(uint32_t expected_crc)
+{
+	int err;
+	uint32_t crc = 0;
+	size_t len;
+
+	for (uint32_t offset = 0; offset < patch.source_size; offset += len) {
+		len = MIN(patch.source_size - offset, sizeof(buf));
+
+		err = flash_area_read(patch.source_fap, offset, buf, len);
+		if (err) {
+			LOG_ERR("flash_area_read failed, err %d", err);
+			return err;
+		}
+
+		crc = crc32_ieee_update(crc, buf, len);
+	}
+
+	if (crc != expected_crc) {
+		LOG_ERR("Source image does not match the patch: CRC 0x%08x, expected 0x%08x",
+			crc, expected_crc);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static int header_parse(void)
+{
+	int err;
+	uint32_t source_crc;
+
+	if (sys_get_be32(&patch.field[0]) != PATCH_MAGIC) {
+		LOG_ERR("Invalid patch magic");
+		return -EBADMSG;
+	}
+
+	if (patch.field[4] != PATCH_VERSION) {
+		LOG_ERR("Unsupported patch version %u", patch.field[4]);
+		return -ENOTSUP;
+	}
+
+	patch.source_size = sys_get_be32(&patch.field[8]);
+	source_crc = sys_get_be32(&patch.field[12]);
+	patch.target_size = sys_get_be32(&patch.field[16]);
+
+	if (patch.source_size > patch.source_fap->fa_size) {
+		LOG_ERR("Source image size %u exceeds the source partition", patch.source_size);
+		return -EINVAL;
+	}
+
+	err = source_crc_check(source_crc);
+	if (err) {
+		return err;
+	}
+
+	LOG_INF("Applying patch: source image %u bytes, target image %u bytes",
+		patch.source_size, patch.target_size);
+
+	err = fmna_uarp_writer_transfer_start(patch.ctx->target_writer, patch.target_size);
+	if (err) {
+		LOG_ERR("fmna_uarp_writer_transfer_start failed, err %d", err);
+		return err;
+	}
+
+	patch.target_started = true;
+
+	return 0;
+}
+
+static void entry_next(void)
+{
+	if (patch.diff_len > 0) {
+		patch.state = STATE_DIFF;
+	} else if (patch.extra_len > 0) {
+		patch.state = STATE_EXTRA;
+	} else {
+		patch.source_offset = patch.source_next;
+		patch.state = STATE_CONTROL;
+	}
+}
+
+static int control_parse(void)
+{
+	int64_t source_next;
+
+	patch.diff_len = sys_get_be32(&patch.field[0]);
+	patch.extra_len = sys_get_be32(&patch.field[4]);
+	source_next = (int64_t)patch.source_offset + patch.diff_len +
+		      (int32_t)sys_get_be32(&patch.field[8]);
+
+	if (((uint64_t)patch.target_offset + patch.diff_len + patch.extra_len) >
+	    patch.target_size) {
+		LOG_ERR("Patch entry exceeds the target image");
+		return -EBADMSG;
+	}
+
+	if (((uint64_t)patch.source_offset + patch.diff_len) > patch.source_size) {
+		LOG_ERR("Patch entry exceeds the source image");
+		return -EBADMSG;
+	}
+
+	if ((source_next < 0) || (source_next > patch.source_size)) {
+		LOG_ERR("Patch entry seeks outside the source image");
+		return -EBADMSG;
+	}
+
+	patch.source_next = source_next;
+	entry_next();
+
+	return 0;
+}
+
+static size_t field_fill(const uint8_t *chunk, size_t chunk_size, size_t field_len)
+{
+	size_t len = MIN(chunk_size, field_len - patch.field_len);
+
+	memcpy(&patch.field[patch.field_len], chunk, len);
+	patch.field_len += len;
+
+	return len;
+}
+
+static int diff_apply(const uint8_t *chunk, size_t len)
+{
+	int err;
+
+	err = flash_area_read(patch.source_fap, patch.source_offset, buf, len);
+	if (err) {
+		LOG_ERR("flash_area_read failed, err %d", err);
+		return err;
+	}
+
+	for (size_t i = 0; i < len; i++) {
+		buf[i] += chunk[i];
+	}
+
+	return fmna_uarp_writer_transfer_write(patch.ctx->target_writer, buf, len);
+}
+
+static int patch_process(const uint8_t *chunk, size_t chunk_size)
+{
+	int err;
+	size_t len;
+
+	while (chunk_size > 0) {
+		switch (patch.state) {
+		case STATE_HEADER:
+			len = field_fill(chunk, chunk_size, PATCH_HEADER_LEN);
+			if (patch.field_len == PATCH_HEADER_LEN) {
+				patch.field_len = 0;
+				patch.state = STATE_CONTROL;
+
+				err = header_parse();
+				if (err) {
+					return err;
+				}
+			}
+			break;
+
+		case STATE_CONTROL:
+			len = field_fill(chunk, chunk_size, PATCH_CONTROL_LEN);
+			if (patch.field_len == PATCH_CONTROL_LEN) {
+				patch.field_len = 0;
+
+				err = control_parse();
+				if (err) {
+					return err;
+				}
+			}
+			break;
+
+		case STATE_DIFF:
+			len = MIN(MIN(chunk_size, patch.diff_len), sizeof(buf));
+
+			err = diff_apply(chunk, len);
+			if (err) {
+				return err;
+			}
+
+			patch.diff_len -= len;
+			patch.source_offset += len;
+			patch.target_offset += len;
+			entry_next();
+			break;
+
+		case STATE_EXTRA:
+			len = MIN(chunk_size, patch.extra_len);
+
+			err = fmna_uarp_writer_transfer_write(patch.ctx->target_writer, chunk, len);
+			if (err) {
+				return err;
+			}
+
+			patch.extra_len -= len;
+			patch.target_offset += len;
+			entry_next();
+			break;
+
+		default:
+			__ASSERT_NO_MSG(false);
+			return -EINVAL;
+		}
+
+		chunk += len;
+		chunk_size -= len;
+	}
+
+	return 0;
+}
+
+static int fmna_uarp_writer_delta_transfer_start(void *ctx, size_t payload_size)
+{
+	int err;
+	const struct fmna_uarp_writer_delta_ctx *context = ctx;
+
+	ARG_UNUSED(payload_size);
+
+	if (!context) {
+		LOG_ERR("Invalid context");
+		return -EINVAL;
+	}
+
+	/* Ensure that payload are sequentially processed. */
+	if (!atomic_cas(&in_progress, false, true)) {
+		LOG_ERR("Previous transfer has not been finished");
+		return -EBUSY;
+	}
+
+	memset(&patch, 0, sizeof(patch));
+	patch.ctx = context;
+	patch.state = STATE_HEADER;
+
+	err = flash_area_open(context->source_fa_id, &patch.source_fap);
+	if (err) {
+		LOG_ERR("flash_area_open failed (err %d)", err);
+		atomic_set(&in_progress, false);
+		return err;
+	}
+
+	/* The target writer is started when the patch header with the target
+	 * image size is received.
+	 */
+	return 0;
+}
+
+static int fmna_uarp_writer_delta_transfer_write(void *ctx,
+						 const uint8_t *chunk,
+						 size_t chunk_size)
+{
+	int err;
+
+	ARG_UNUSED(ctx);
+
+	/* Ensure that writer has been started. */
+	if (!atomic_get(&in_progress)) {
+		LOG_ERR("Transfer has not been started");
+		return -EBUSY;
+	}
+
+	err = patch_process(chunk, chunk_size);
+	if (err) {
+		LOG_ERR("patch_process failed, err %d", err);
+		return err;
+	}
+
+	return 0;
+}
+
+static int fmna_uarp_writer_delta_transfer_finish(void *ctx, bool success)
+{
+	int err = 0;
+	int ret = 0;
+
+	ARG_UNUSED(ctx);
+
+	/* Ensure that writer has been started. */
+	if (!atomic_get(&in_progress)) {
+		LOG_ERR("Transfer has not been started");
+		return -EBUSY;
+	}
+
+	if (success && ((patch.state != STATE_CONTROL) || (patch.field_len > 0) ||
+			(patch.target_offset != patch.target_size))) {
+		LOG_ERR("Patch is incomplete: target image %u bytes out of %u",
+			patch.target_offset, patch.target_size);
+		err = -EBADMSG;
+		success = false;
+	}
+
+	if (patch.target_started) {
+		ret = fmna_uarp_writer_transfer_finish(patch.ctx->target_writer, success);
+		if (ret) {
+			LOG_ERR("fmna_uarp_writer_transfer_finish failed, err %d", ret);
+		}
+	}
+
+	flash_area_close(patch.source_fap);
+	atomic_set(&in_progress, false);
+
+	return err ? err : ret;
+}
+
+static int fmna_uarp_writer_delta_image_confirm(void *ctx)
+{
+	const struct fmna_uarp_writer_delta_ctx *context = ctx;
+
+	if (!context) {
+		LOG_ERR("Invalid context");
+		return -EINVAL;
+	}
+
+	return fmna_uarp_writer_image_confirm(context->target_writer);
+}
+
+/* The patch decoder state is not stored, so interrupted transfers are restarted. */
+FMNA_UARP_WRITER_API_DEF(fmna_uarp_writer_delta_api,
+			 fmna_uarp_writer_delta_transfer_start,
+			 fmna_uarp_writer_delta_transfer_write,
+			 fmna_uarp_writer_delta_transfer_finish,
+			 fmna_uarp_writer_delta_image_confirm,
+			 NULL);
@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-4-Clause
+ */
+
+#ifndef FMNA_UARP_WRITER_DELTA_H_
+#define FMNA_UARP_WRITER_DELTA_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <zephyr/kernel.h>
+
+#include "fmna_uarp_writer.h"
+
+/**
+ * @defgroup fmna_uarp_writer_delta Delta FMNA UARP payload writer API
+ * @brief Delta FMNA UARP payload writer API
+ *
+ * The delta writer receives a patch generated by the ncsfmntools superbinary
+ * command against the image stored in the source flash area. It reconstructs
+ * the new image from the source image and the patch, and passes it to the
+ * target writer.
+ *
+ * @{
+ */
+
+/** Define the delta FMNA UARP payload writer instance.
+ *
+ *  @param _name FMNA UARP payload writer structure name.
+ *  @param _target_writer Pointer to the FMNA UARP payload writer structure instance
+ *         that stores the reconstructed image.
+ *  @param _source_fa_id Flash area ID of the partition containing the image
+ *         that the patch was generated against.
+ */
+#define FMNA_UARP_WRITER_DELTA_DEF(_name, _target_writer, _source_fa_id)      \
+	BUILD_ASSERT(_target_writer != NULL);                                 \
+	FMNA_UARP_WRITER_DEF(_name,                                           \
+			     fmna_uarp_writer_delta_api,                      \
+			     (&(struct fmna_uarp_writer_delta_ctx){           \
+				.target_writer = (_target_writer),            \
+				.source_fa_id = (_source_fa_id),              \
+				}))
+
+/** Delta FMNA UARP payload writer configuration data structure. */
+struct fmna_uarp_writer_delta_ctx {
+	/** Writer of the reconstructed image. */
+	const struct fmna_uarp_writer *target_writer;
+
+	/** Source flash partition ID. */
+	uint8_t source_fa_id;
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @}
+ */
+
+#endif /* FMNA_UARP_WRITER_DELTA_H_ */
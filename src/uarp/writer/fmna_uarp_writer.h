@@ -28,12 +28,15 @@ extern "C" {
  * @param _transfer_finish FMNA UARP payload writer API @ref transfer_finish function
  * 			   implementation.
  * @param _image_confirm FMNA UARP payload writer API @ref image_confirm function implementation.
+ * @param _transfer_resume FMNA UARP payload writer API @ref transfer_resume function
+ *			   implementation. Can be NULL if the writer cannot resume transfers.
  */
 #define FMNA_UARP_WRITER_API_DEF(_name, \
 				 _transfer_start, 	\
 				 _transfer_write, 	\
 				 _transfer_finish, 	\
-				 _image_confirm)	\
+				 _image_confirm,	\
+				 _transfer_resume)	\
 	BUILD_ASSERT(_transfer_start != NULL);		\
 	BUILD_ASSERT(_transfer_write != NULL);		\
 	BUILD_ASSERT(_transfer_finish != NULL);		\
@@ -43,6 +46,7 @@ extern "C" {
 		.transfer_write = _transfer_write,	\
 		.transfer_finish = _transfer_finish,	\
 		.image_confirm = _image_confirm,	\
+		.transfer_resume = _transfer_resume,	\
 	}
 
 /** Helper macro to define the writer structure.
@@ -107,6 +111,20 @@ struct fmna_uarp_writer_api {
 	 * @return 0 on success, otherwise negative error code.
 	 */
 	int (*image_confirm)(void *ctx);
+
+	/**
+	 * @brief Prepare the writer to continue an interrupted transfer of the UARP payload.
+	 *
+	 * The payload bytes before the offset are already stored by a previous transfer.
+	 * The next written chunk starts at the offset.
+	 *
+	 * @param ctx Payload writer-specific context.
+	 * @param payload_size Payload size.
+	 * @param offset Offset of the first byte that is written.
+	 *
+	 * @return 0 on success, otherwise negative error code.
+	 */
+	int (*transfer_resume)(void *ctx, size_t payload_size, size_t offset);
 };
 
 /** @brief UARP payload writer structure. */
@@ -181,6 +199,28 @@ static inline int fmna_uarp_writer_image_confirm(const struct fmna_uarp_writer *
 	return api->image_confirm(writer->ctx);
 }
 
+/** Prepare the writer to continue an interrupted transfer of the UARP payload.
+ *
+ * @param writer UARP payload writer structure.
+ * @param payload_size Payload size.
+ * @param offset Offset of the first byte that is written.
+ *
+ * @return 0 on success, -ENOTSUP if the writer cannot resume transfers,
+ *         otherwise negative error code.
+ */
+static inline int fmna_uarp_writer_transfer_resume(const struct fmna_uarp_writer *writer,
+						   size_t payload_size,
+						   size_t offset)
+{
+	const struct fmna_uarp_writer_api *api = writer->api;
+
+	if (!api->transfer_resume) {
+		return -ENOTSUP;
+	}
+
+	return api->transfer_resume(writer->ctx, payload_size, offset);
+}
+
 #ifdef __cplusplus
 }
 #endif
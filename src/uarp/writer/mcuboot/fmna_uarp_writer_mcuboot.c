@@ -5,6 +5,7 @@
  */
 
 #include <zephyr/kernel.h>
+#include <zephyr/drivers/flash.h>
 #include <zephyr/storage/flash_map.h>
 
 #include <bootutil/bootutil_public.h>
@@ -54,10 +55,88 @@ static bool is_confirmed_mcuboot_image(uint8_t fa)
 	return state.image_ok == BOOT_FLAG_SET;
 }
 
+bool fmna_uarp_writer_mcuboot_slot_is_running(uint8_t fa_id)
+{
+	int err;
+	const struct flash_area *fap;
+	uintptr_t start;
+	uintptr_t end;
+	uintptr_t addr = (uintptr_t)fmna_uarp_writer_mcuboot_slot_is_running;
+
+	err = flash_area_open(fa_id, &fap);
+	if (err) {
+		LOG_ERR("flash_area_open failed (err %d)", err);
+		return false;
+	}
+
+	/* The slot executes this code if it contains the address of this function. */
+	start = CONFIG_FLASH_BASE_ADDRESS + fap->fa_off;
+	end = start + fap->fa_size;
+	flash_area_close(fap);
+
+	return (addr >= start) && (addr < end);
+}
+
+static uint8_t running_slot_get(const struct fmna_uarp_writer_mcuboot_ctx *context)
+{
+	/* Direct-XIP mode:
+	 *   The image runs from the slot it was written to, so the running
+	 *   slot changes with each update. The writer instance only knows the
+	 *   slot pair.
+	 */
+	if (IS_ENABLED(CONFIG_FMNA_UARP_WRITER_MCUBOOT_DIRECT_XIP) &&
+	    fmna_uarp_writer_mcuboot_slot_is_running(context->write_fa_id)) {
+		return context->write_fa_id;
+	}
+
+	return context->running_fa_id;
+}
+
+static int trailer_erase(uint8_t fa)
+{
+	int err;
+	const struct flash_area *fap;
+	struct flash_pages_info info;
+
+	err = flash_area_open(fa, &fap);
+	if (err) {
+		LOG_ERR("flash_area_open failed (err %d)", err);
+		return err;
+	}
+
+	/* The image trailer is located in the last page of the slot. */
+	err = flash_get_page_info_by_offs(flash_area_get_device(fap),
+					  fap->fa_off + fap->fa_size - 1,
+					  &info);
+	if (err) {
+		LOG_ERR("flash_get_page_info_by_offs failed, err %d", err);
+	} else {
+		err = flash_area_erase(fap, info.start_offset - fap->fa_off, info.size);
+		if (err) {
+			LOG_ERR("flash_area_erase failed, err %d", err);
+		}
+	}
+
+	flash_area_close(fap);
+
+	return err;
+}
+
 static int test_mcuboot_image(uint8_t fa)
 {
 	int err;
 	const struct flash_area *fap;
+	/* Overwrite-only mode:
+	 *   The previous image is overwritten and cannot be restored, so the
+	 *   upgrade is requested as permanent.
+	 * Direct-XIP mode without revert:
+	 *   MCUboot boots the valid image with the highest version and never
+	 *   reverts it.
+	 * Direct-XIP mode with revert:
+	 *   The image is tested and must be confirmed like in the swap mode.
+	 */
+	bool permanent = IS_ENABLED(CONFIG_MCUBOOT_BOOTLOADER_MODE_OVERWRITE_ONLY) ||
+			 IS_ENABLED(CONFIG_MCUBOOT_BOOTLOADER_MODE_DIRECT_XIP);
 
 	err = flash_area_open(fa, &fap);
 	if (err) {
@@ -65,7 +144,7 @@ static int test_mcuboot_image(uint8_t fa)
 		return err;
 	}
 
-	err = boot_set_next(fap, false, false);
+	err = boot_set_next(fap, false, permanent);
 	if (err) {
 		LOG_ERR("boot_set_next failed (err %d)", err);
 	}
@@ -96,16 +175,22 @@ static int confirm_mcuboot_image(uint8_t fa)
 	return err;
 }
 
-static int fmna_uarp_writer_mcuboot_transfer_start(void *ctx, size_t payload_size)
+static int transfer_begin(const struct fmna_uarp_writer_mcuboot_ctx *context,
+			  size_t payload_size,
+			  size_t offset)
 {
 	int err;
-	const struct fmna_uarp_writer_mcuboot_ctx *context = ctx;
 
 	if (!context) {
 		LOG_ERR("Invalid context");
 		return -EINVAL;
 	}
 
+	if (running_slot_get(context) == context->write_fa_id) {
+		LOG_ERR("Cannot write to the currently running MCUboot slot");
+		return -EINVAL;
+	}
+
 	if (!is_confirmed_mcuboot_image(context->running_fa_id)) {
 		LOG_ERR("Currently running MCUboot image has not been confirmed");
 		return -EINVAL;
@@ -119,13 +204,29 @@ static int fmna_uarp_writer_mcuboot_transfer_start(void *ctx, size_t payload_siz
 		return -EBUSY;
 	}
 
-	err = fmna_uarp_writer_util_nvm_start(&nvm_util_ctx,
-					      context->write_fa_id,
-					      buf,
-					      ARRAY_SIZE(buf),
-					      payload_size);
+	/* Direct-XIP mode:
+	 *   The write slot holds the previous image together with its trailer.
+	 *   Invalidate the trailer before the image is overwritten, so the new
+	 *   image does not inherit the magic and the confirmation of the
+	 *   previous one.
+	 */
+	if (IS_ENABLED(CONFIG_FMNA_UARP_WRITER_MCUBOOT_DIRECT_XIP) && (offset == 0)) {
+		err = trailer_erase(context->write_fa_id);
+		if (err) {
+			LOG_ERR("trailer_erase failed, err %d", err);
+			atomic_set(&in_progress, false);
+			return err;
+		}
+	}
+
+	err = fmna_uarp_writer_util_nvm_resume(&nvm_util_ctx,
+					       context->write_fa_id,
+					       buf,
+					       ARRAY_SIZE(buf),
+					       payload_size,
+					       offset);
 	if (err) {
-		LOG_ERR("fmna_uarp_writer_util_nvm_start failed, err %d", err);
+		LOG_ERR("fmna_uarp_writer_util_nvm_resume failed, err %d", err);
 		atomic_set(&in_progress, false);
 		return err;
 	}
@@ -133,6 +234,16 @@ static int fmna_uarp_writer_mcuboot_transfer_start(void *ctx, size_t payload_siz
 	return 0;
 }
 
+static int fmna_uarp_writer_mcuboot_transfer_start(void *ctx, size_t payload_size)
+{
+	return transfer_begin(ctx, payload_size, 0);
+}
+
+static int fmna_uarp_writer_mcuboot_transfer_resume(void *ctx, size_t payload_size, size_t offset)
+{
+	return transfer_begin(ctx, payload_size, offset);
+}
+
 static int fmna_uarp_writer_mcuboot_transfer_write(void *ctx,
 						   const uint8_t *chunk,
 						   size_t chunk_size)
@@ -197,7 +308,7 @@ static int fmna_uarp_writer_mcuboot_image_confirm(void *ctx)
 		return -EINVAL;
 	}
 
-	err = confirm_mcuboot_image(context->running_fa_id);
+	err = confirm_mcuboot_image(running_slot_get(context));
 	if (err) {
 		LOG_ERR("confirm_mcuboot_image failed, err %d", err);
 	}
@@ -209,4 +320,5 @@ FMNA_UARP_WRITER_API_DEF(fmna_uarp_writer_mcuboot_api,
 			 fmna_uarp_writer_mcuboot_transfer_start,
 			 fmna_uarp_writer_mcuboot_transfer_write,
 			 fmna_uarp_writer_mcuboot_transfer_finish,
-			 fmna_uarp_writer_mcuboot_image_confirm);
+			 fmna_uarp_writer_mcuboot_image_confirm,
+			 fmna_uarp_writer_mcuboot_transfer_resume);
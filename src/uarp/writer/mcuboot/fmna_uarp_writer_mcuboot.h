@@ -19,10 +19,21 @@ extern "C" {
  * @defgroup fmna_uarp_writer_mcuboot MCUboot-specific FMNA UARP payload writer API
  * @brief MCUboot-specific FMNA UARP payload writer API
  *
+ * The writer follows the MCUboot mode of the application. In the swap modes,
+ * the new image is marked for a test and must be confirmed after the reboot.
+ * In the overwrite-only mode, the new image is marked as permanent. In the
+ * direct-XIP modes, the new image is booted from the slot it was written to,
+ * so the running slot is determined at runtime.
+ *
  * @{
  */
 
 /** Define the MCUboot-specific FMNA UARP payload writer instance.
+ *
+ *  In the direct-XIP modes, the image is linked for one of the slots. Define
+ *  a writer instance for each slot with the other slot as the running one.
+ *  The instance refuses to write to the slot from which the device is
+ *  currently running.
  *
  *  @param _name FMNA UARP payload writer structure name.
  *  @param _write_fa_id Write flash area ID of the image partition.
@@ -49,6 +60,14 @@ struct fmna_uarp_writer_mcuboot_ctx {
 	uint8_t running_fa_id;
 };
 
+/** Check if the device is currently running from the image partition.
+ *
+ *  @param fa_id Flash area ID of the image partition.
+ *
+ *  @return true if the partition contains the running code, otherwise false.
+ */
+bool fmna_uarp_writer_mcuboot_slot_is_running(uint8_t fa_id);
+
 #ifdef __cplusplus
 }
 #endif
@@ -5,6 +5,7 @@
  */
 
 #include <zephyr/kernel.h>
+#include <zephyr/drivers/flash.h>
 #include <zephyr/storage/flash_map.h>
 
 #include <dfu/dfu_target_stream.h>
@@ -17,10 +18,257 @@ LOG_MODULE_REGISTER(fmna_uarp_writer_util_nvm, CONFIG_FMNA_UARP_WRITER_UTIL_NVM_
 BUILD_ASSERT(!IS_ENABLED(DFU_TARGET_STREAM_SAVE_PROGRESS),
 	     "FMNA UARP does not support DFU target progress saving.");
 
+#if CONFIG_FMNA_UARP_WRITER_UTIL_NVM_PRE_ERASE
+/* The eraser runs ahead of the writes. It erases the flash area pages that
+ * cover the payload one by one and publishes the erased size, so the writes
+ * only wait when they overtake the eraser.
+ */
+static struct {
+	const struct flash_area *fap;
+	size_t start;
+	size_t size;
+	atomic_t erased;
+	atomic_t err;
+	atomic_t cancel;
+} eraser;
+
+static K_SEM_DEFINE(erase_start_sem, 0, 1);
+static K_SEM_DEFINE(erase_progress_sem, 0, 1);
+static K_SEM_DEFINE(erase_idle_sem, 1, 1);
+
+static int page_erase(const struct flash_area *fap, size_t offset, size_t *page_size)
+{
+	int err;
+	struct flash_pages_info info;
+
+	err = flash_get_page_info_by_offs(flash_area_get_device(fap), fap->fa_off + offset, &info);
+	if (err) {
+		LOG_ERR("flash_get_page_info_by_offs failed, err %d", err);
+		return err;
+	}
+
+	err = flash_area_erase(fap, offset, info.size);
+	if (err) {
+		LOG_ERR("flash_area_erase failed, err %d", err);
+		return err;
+	}
+
+	*page_size = info.size;
+
+	return 0;
+}
+
+static void erase_thread_entry_point(void *arg0, void *arg1, void *arg2)
+{
+	int err;
+	size_t offset;
+	size_t page_size;
+
+	while (true) {
+		k_sem_take(&erase_start_sem, K_FOREVER);
+
+		offset = eraser.start;
+		while ((offset < eraser.size) && !atomic_get(&eraser.cancel)) {
+			err = page_erase(eraser.fap, offset, &page_size);
+			if (err) {
+				atomic_set(&eraser.err, err);
+				break;
+			}
+
+			offset += page_size;
+			atomic_set(&eraser.erased, offset);
+			k_sem_give(&erase_progress_sem);
+		}
+
+		LOG_DBG("Pre-erase stopped at offset 0x%zx", offset);
+
+		/* Wake up the writer also when the erase failed or was cancelled. */
+		k_sem_give(&erase_progress_sem);
+		k_sem_give(&erase_idle_sem);
+	}
+}
+
+K_THREAD_DEFINE(fmna_uarp_erase_thread,
+		CONFIG_FMNA_UARP_WRITER_UTIL_NVM_ERASE_THREAD_STACK_SIZE,
+		erase_thread_entry_point, NULL, NULL, NULL,
+		CONFIG_FMNA_UARP_WRITER_UTIL_NVM_ERASE_THREAD_PRIORITY <
+			CONFIG_NUM_PREEMPT_PRIORITIES ?
+			CONFIG_FMNA_UARP_WRITER_UTIL_NVM_ERASE_THREAD_PRIORITY :
+			CONFIG_NUM_PREEMPT_PRIORITIES - 1,
+		0, 0);
+
+static void pre_erase_start(const struct flash_area *fap, size_t start, size_t size)
+{
+	k_sem_take(&erase_idle_sem, K_FOREVER);
+
+	eraser.fap = fap;
+	eraser.start = start;
+	eraser.size = size;
+	atomic_set(&eraser.erased, start);
+	atomic_set(&eraser.err, 0);
+	atomic_set(&eraser.cancel, false);
+	k_sem_reset(&erase_progress_sem);
+
+	k_sem_give(&erase_start_sem);
+}
+
+static void pre_erase_stop(void)
+{
+	atomic_set(&eraser.cancel, true);
+
+	k_sem_take(&erase_idle_sem, K_FOREVER);
+	k_sem_give(&erase_idle_sem);
+}
+
+static int pre_erase_wait(size_t end)
+{
+	int err;
+
+	while ((size_t)atomic_get(&eraser.erased) < end) {
+		err = atomic_get(&eraser.err);
+		if (err) {
+			return err;
+		}
+
+		if (atomic_get(&eraser.cancel)) {
+			return -ECANCELED;
+		}
+
+		k_sem_take(&erase_progress_sem, K_FOREVER);
+	}
+
+	return 0;
+}
+
+static int buf_flush(struct fmna_uarp_writer_util_nvm_ctx *ctx, size_t len)
+{
+	int err;
+
+	err = pre_erase_wait(ctx->offset + len);
+	if (err) {
+		LOG_ERR("Pre-erase failed, err %d", err);
+		return err;
+	}
+
+	err = flash_area_write(ctx->fap, ctx->offset, ctx->buf, len);
+	if (err) {
+		LOG_ERR("flash_area_write failed, err %d", err);
+		return err;
+	}
+
+	ctx->offset += len;
+	ctx->buf_used = 0;
+
+	return 0;
+}
+
+static int init_util_nvm(struct fmna_uarp_writer_util_nvm_ctx *ctx,
+			 uint8_t *buf,
+			 size_t buf_len,
+			 size_t payload_size,
+			 size_t offset)
+{
+	int err;
+	struct flash_pages_info info;
+
+	if (payload_size > ctx->fap->fa_size) {
+		LOG_ERR("Payload too big for flash area, payload_size %zu, fa_size %zu",
+			payload_size, ctx->fap->fa_size);
+		return -EFBIG;
+	}
+
+	if (buf_len % flash_area_align(ctx->fap)) {
+		LOG_ERR("Buffer length %zu not aligned to the flash write block size", buf_len);
+		return -EINVAL;
+	}
+
+	if (offset > 0) {
+		/* The data after the offset could be partially written before the
+		 * interruption, so the resumed transfer must start on a page boundary
+		 * that the eraser can erase again.
+		 */
+		err = flash_get_page_info_by_offs(flash_area_get_device(ctx->fap),
+						  ctx->fap->fa_off + offset, &info);
+		if (err) {
+			LOG_ERR("flash_get_page_info_by_offs failed, err %d", err);
+			return err;
+		}
+
+		if ((offset > payload_size) || (offset % buf_len) ||
+		    (info.start_offset != ctx->fap->fa_off + offset)) {
+			LOG_ERR("Cannot resume the transfer at offset 0x%zx", offset);
+			return -EINVAL;
+		}
+	}
+
+	ctx->buf = buf;
+	ctx->buf_len = buf_len;
+	ctx->buf_used = 0;
+	ctx->offset = offset;
+
+	pre_erase_start(ctx->fap, offset, payload_size);
+
+	return 0;
+}
+
+static int write_util_nvm(struct fmna_uarp_writer_util_nvm_ctx *ctx,
+			  const uint8_t *chunk,
+			  size_t chunk_size)
+{
+	int err;
+	size_t len;
+
+	while (chunk_size > 0) {
+		len = MIN(chunk_size, ctx->buf_len - ctx->buf_used);
+		memcpy(&ctx->buf[ctx->buf_used], chunk, len);
+		ctx->buf_used += len;
+		chunk += len;
+		chunk_size -= len;
+
+		if (ctx->buf_used == ctx->buf_len) {
+			err = buf_flush(ctx, ctx->buf_len);
+			if (err) {
+				return err;
+			}
+		}
+	}
+
+	return 0;
+}
+
+static int finish_util_nvm(struct fmna_uarp_writer_util_nvm_ctx *ctx, bool success)
+{
+	int err = 0;
+	int ret;
+	size_t len;
+	size_t page_size;
+
+	if (success && (ctx->buf_used > 0)) {
+		len = ROUND_UP(ctx->buf_used, flash_area_align(ctx->fap));
+		memset(&ctx->buf[ctx->buf_used], flash_area_erased_val(ctx->fap),
+		       len - ctx->buf_used);
+
+		err = buf_flush(ctx, len);
+	}
+
+	pre_erase_stop();
+
+	if ((!success || err) && (ctx->offset > 0)) {
+		/* Invalidate the partially written image by erasing its header. */
+		ret = page_erase(ctx->fap, 0, &page_size);
+		if (ret && !err) {
+			err = ret;
+		}
+	}
+
+	return err;
+}
+#else
 static int init_util_nvm(struct fmna_uarp_writer_util_nvm_ctx *ctx,
 			 uint8_t *buf,
 			 size_t buf_len,
-			 size_t payload_size)
+			 size_t payload_size,
+			 size_t offset)
 {
 	int err;
 	struct dfu_target_stream_init init = {
@@ -39,6 +287,11 @@ static int init_util_nvm(struct fmna_uarp_writer_util_nvm_ctx *ctx,
 		return -EFBIG;
 	}
 
+	if (offset > 0) {
+		/* The stream erases the pages lazily and cannot continue a transfer. */
+		return -ENOTSUP;
+	}
+
 	err = dfu_target_stream_init(&init);
 	if (err) {
 		LOG_ERR("dfu_target_stream_init failed, err %d", err);
@@ -48,11 +301,54 @@ static int init_util_nvm(struct fmna_uarp_writer_util_nvm_ctx *ctx,
 	return 0;
 }
 
+static int write_util_nvm(struct fmna_uarp_writer_util_nvm_ctx *ctx,
+			  const uint8_t *chunk,
+			  size_t chunk_size)
+{
+	int err;
+
+	err = dfu_target_stream_write(chunk, chunk_size);
+	if (err) {
+		LOG_ERR("dfu_target_stream_write failed, err %d", err);
+		return err;
+	}
+
+	return 0;
+}
+
+static int finish_util_nvm(struct fmna_uarp_writer_util_nvm_ctx *ctx, bool success)
+{
+	int err;
+
+	if (success) {
+		err = dfu_target_stream_done(true);
+	} else {
+		err = dfu_target_stream_reset();
+	}
+
+	if (err) {
+		LOG_ERR("dfu_target_stream_%s failed, err %d", (success ? "done" : "reset"), err);
+	}
+
+	return err;
+}
+#endif /* CONFIG_FMNA_UARP_WRITER_UTIL_NVM_PRE_ERASE */
+
 int fmna_uarp_writer_util_nvm_start(struct fmna_uarp_writer_util_nvm_ctx *ctx,
 				    uint8_t fa_id,
 				    uint8_t *buf,
 				    size_t buf_len,
 				    size_t payload_size)
+{
+	return fmna_uarp_writer_util_nvm_resume(ctx, fa_id, buf, buf_len, payload_size, 0);
+}
+
+int fmna_uarp_writer_util_nvm_resume(struct fmna_uarp_writer_util_nvm_ctx *ctx,
+				     uint8_t fa_id,
+				     uint8_t *buf,
+				     size_t buf_len,
+				     size_t payload_size,
+				     size_t offset)
 {
 	int err;
 
@@ -68,7 +364,7 @@ int fmna_uarp_writer_util_nvm_start(struct fmna_uarp_writer_util_nvm_ctx *ctx,
 		return err;
 	}
 
-	err = init_util_nvm(ctx, buf, buf_len, payload_size);
+	err = init_util_nvm(ctx, buf, buf_len, payload_size, offset);
 	if (err) {
 		flash_area_close(ctx->fap);
 		ctx->fap = NULL;
@@ -82,15 +378,7 @@ int fmna_uarp_writer_util_nvm_write(struct fmna_uarp_writer_util_nvm_ctx *ctx,
 				    const uint8_t *chunk,
 				    size_t chunk_size)
 {
-	int err;
-
-	err = dfu_target_stream_write(chunk, chunk_size);
-	if (err) {
-		LOG_ERR("dfu_target_stream_write failed, err %d", err);
-		return err;
-	}
-
-	return 0;
+	return write_util_nvm(ctx, chunk, chunk_size);
 }
 
 int fmna_uarp_writer_util_nvm_finish(struct fmna_uarp_writer_util_nvm_ctx *ctx, bool success)
@@ -101,15 +389,7 @@ int fmna_uarp_writer_util_nvm_finish(struct fmna_uarp_writer_util_nvm_ctx *ctx,
 		return -EINVAL;
 	}
 
-	if (success) {
-		err = dfu_target_stream_done(true);
-	} else {
-		err = dfu_target_stream_reset();
-	}
-
-	if (err) {
-		LOG_ERR("dfu_target_stream_%s failed, err %d", (success ? "done" : "reset"), err);
-	}
+	err = finish_util_nvm(ctx, success);
 
 	__ASSERT_NO_MSG(ctx->fap != NULL);
 	flash_area_close(ctx->fap);
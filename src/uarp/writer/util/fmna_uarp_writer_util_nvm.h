@@ -23,6 +23,12 @@ extern "C" {
 
 struct fmna_uarp_writer_util_nvm_ctx {
 	const struct flash_area *fap;
+#if CONFIG_FMNA_UARP_WRITER_UTIL_NVM_PRE_ERASE
+	uint8_t *buf;
+	size_t buf_len;
+	size_t buf_used;
+	size_t offset;
+#endif
 };
 
 int fmna_uarp_writer_util_nvm_start(struct fmna_uarp_writer_util_nvm_ctx *ctx,
@@ -30,6 +36,12 @@ int fmna_uarp_writer_util_nvm_start(struct fmna_uarp_writer_util_nvm_ctx *ctx,
 				    uint8_t *buf,
 				    size_t buf_len,
 				    size_t payload_size);
+int fmna_uarp_writer_util_nvm_resume(struct fmna_uarp_writer_util_nvm_ctx *ctx,
+				     uint8_t fa_id,
+				     uint8_t *buf,
+				     size_t buf_len,
+				     size_t payload_size,
+				     size_t offset);
 int fmna_uarp_writer_util_nvm_write(struct fmna_uarp_writer_util_nvm_ctx *ctx,
 				    const uint8_t *chunk,
 				    size_t chunk_size);
@@ -0,0 +1,272 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-4-Clause
+ */
+
+#include <zephyr/ztest.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/logging/log.h>
+
+#include "fmna_uarp_decompress.h"
+#include "vectors.h"
+
+/* The decoder logs to the UARP module. */
+LOG_MODULE_REGISTER(fmna_uarp, CONFIG_FMNA_UARP_LOG_LEVEL);
+
+/* The UARP module passes at most one payload window to the decoder at once. */
+#define CHUNK_SIZE_MAX		CONFIG_FMNA_UARP_PAYLOAD_WINDOW_SIZE
+/* Zero selects the pseudo-random chunk sizes. */
+#define CHUNK_SIZE_RANDOM	0
+
+static const struct test_vector *vector;
+static size_t output_len;
+static uint32_t rand_state;
+
+/* The sink takes at most sink_space bytes if sink_limited is set. */
+static bool sink_limited;
+static size_t sink_space;
+
+static int sink(const uint8_t *data, size_t len)
+{
+	if (sink_limited) {
+		len = MIN(len, sink_space);
+		sink_space -= len;
+	}
+
+	zassert_true(output_len + len <= vector->data_len, "%s: output overflow",
+		     vector->name);
+	zassert_mem_equal(data, &vector->data[output_len], len, "%s: invalid output at %zu",
+			  vector->name, output_len);
+	output_len += len;
+
+	return len;
+}
+
+static void decompress_start(const struct test_vector *test_vector, uint32_t size)
+{
+	struct fmna_uarp_decompress_params params = {
+		.window_sz2 = test_vector->window_sz2,
+		.lookahead_sz2 = test_vector->lookahead_sz2,
+		.size = size,
+	};
+
+	vector = test_vector;
+	output_len = 0;
+
+	fmna_uarp_decompress_start(&params, sink);
+}
+
+static size_t chunk_size_get(size_t chunk_size)
+{
+	if (chunk_size == CHUNK_SIZE_RANDOM) {
+		rand_state = rand_state * 1103515245 + 12345;
+		return ((rand_state >> 16) % CHUNK_SIZE_MAX) + 1;
+	}
+
+	return chunk_size;
+}
+
+static void vector_decompress(const struct test_vector *test_vector, size_t chunk_size)
+{
+	int err;
+	size_t len;
+
+	decompress_start(test_vector, test_vector->data_len);
+
+	for (size_t offset = 0; offset < test_vector->compressed_len; offset += len) {
+		len = chunk_size_get(chunk_size);
+		len = MIN(len, test_vector->compressed_len - offset);
+
+		err = fmna_uarp_decompress_write(&test_vector->compressed[offset], len);
+		zassert_ok(err, "%s: fmna_uarp_decompress_write failed at %zu",
+			   test_vector->name, offset);
+	}
+
+	err = fmna_uarp_decompress_finish();
+	zassert_ok(err, "%s: fmna_uarp_decompress_finish failed", test_vector->name);
+	zassert_equal(output_len, test_vector->data_len, "%s: invalid output length",
+		      test_vector->name);
+}
+
+static void vectors_decompress(size_t chunk_size)
+{
+	for (size_t i = 0; i < test_vector_count; i++) {
+		vector_decompress(&test_vectors[i], chunk_size);
+	}
+}
+
+static void before_each(void *fixture)
+{
+	rand_state = 1;
+	sink_limited = false;
+	sink_space = 0;
+}
+
+ZTEST(suite_fmna_uarp_decompress, test_decompress_window_chunks)
+{
+	vectors_decompress(CHUNK_SIZE_MAX);
+}
+
+ZTEST(suite_fmna_uarp_decompress, test_decompress_byte_by_byte)
+{
+	vectors_decompress(1);
+}
+
+ZTEST(suite_fmna_uarp_decompress, test_decompress_odd_chunks)
+{
+	/* The chunk boundaries fall inside the literals and the back-references. */
+	vectors_decompress(7);
+	vectors_decompress(61);
+	vectors_decompress(251);
+}
+
+ZTEST(suite_fmna_uarp_decompress, test_decompress_random_chunks)
+{
+	vectors_decompress(CHUNK_SIZE_RANDOM);
+}
+
+ZTEST(suite_fmna_uarp_decompress, test_decompress_max_window)
+{
+	size_t count = 0;
+
+	for (size_t i = 0; i < test_vector_count; i++) {
+		if (test_vectors[i].window_sz2 != CONFIG_FMNA_UARP_COMPRESSION_WINDOW_SZ2_MAX) {
+			continue;
+		}
+
+		vector_decompress(&test_vectors[i], 1);
+		vector_decompress(&test_vectors[i], CHUNK_SIZE_RANDOM);
+		count++;
+	}
+
+	zassert_true(count > 0, "No test vector with the maximum window");
+}
+
+ZTEST(suite_fmna_uarp_decompress, test_decompress_sink_full)
+{
+	int err;
+	size_t len;
+	size_t blocked_count = 0;
+	const struct test_vector *test_vector;
+
+	sink_limited = true;
+
+	for (size_t i = 0; i < test_vector_count; i++) {
+		test_vector = &test_vectors[i];
+		decompress_start(test_vector, test_vector->data_len);
+
+		for (size_t offset = 0; offset < test_vector->compressed_len; offset += len) {
+			len = chunk_size_get(CHUNK_SIZE_RANDOM);
+			len = MIN(len, test_vector->compressed_len - offset);
+
+			/* Like the flash buffers, the sink has space for the chunk size. */
+			sink_space = len;
+
+			err = fmna_uarp_decompress_write(&test_vector->compressed[offset], len);
+			if (err != -EAGAIN) {
+				zassert_ok(err, "%s: fmna_uarp_decompress_write failed at %zu",
+					   test_vector->name, offset);
+				continue;
+			}
+
+			blocked_count++;
+
+			err = fmna_uarp_decompress_write(&test_vector->compressed[offset], len);
+			zassert_equal(err, -EBUSY, "%s: write accepted while blocked",
+				      test_vector->name);
+
+			err = fmna_uarp_decompress_resume();
+			zassert_equal(err, -EAGAIN, "%s: resumed without the sink space",
+				      test_vector->name);
+
+			do {
+				sink_space = chunk_size_get(CHUNK_SIZE_RANDOM);
+				err = fmna_uarp_decompress_resume();
+			} while (err == -EAGAIN);
+
+			zassert_ok(err, "%s: fmna_uarp_decompress_resume failed",
+				   test_vector->name);
+		}
+
+		sink_space = 0;
+		while ((err = fmna_uarp_decompress_finish()) == -EAGAIN) {
+			sink_space = chunk_size_get(CHUNK_SIZE_RANDOM);
+		}
+
+		zassert_ok(err, "%s: fmna_uarp_decompress_finish failed", test_vector->name);
+		zassert_equal(output_len, test_vector->data_len, "%s: invalid output length",
+			      test_vector->name);
+	}
+
+	zassert_true(blocked_count > 0, "The decompressed data never filled the sink");
+}
+
+ZTEST(suite_fmna_uarp_decompress, test_decompress_size_mismatch)
+{
+	int err;
+	const struct test_vector *test_vector = &test_vectors[0];
+
+	decompress_start(test_vector, test_vector->data_len - 1);
+	err = fmna_uarp_decompress_write(test_vector->compressed, test_vector->compressed_len);
+	zassert_equal(err, -EBADMSG, "Data beyond the payload size accepted");
+
+	decompress_start(test_vector, test_vector->data_len + 1);
+	err = fmna_uarp_decompress_write(test_vector->compressed, test_vector->compressed_len);
+	zassert_ok(err, "fmna_uarp_decompress_write failed");
+
+	err = fmna_uarp_decompress_finish();
+	zassert_equal(err, -EBADMSG, "Truncated payload accepted");
+}
+
+ZTEST(suite_fmna_uarp_decompress, test_decompress_backref_before_start)
+{
+	int err;
+	/* A back-reference with the distance of one at the payload start. */
+	static const uint8_t compressed[] = {0x00, 0x00};
+	const struct test_vector test_vector = {
+		.name = "backref",
+		.window_sz2 = 4,
+		.lookahead_sz2 = 3,
+		.data = NULL,
+		.data_len = 16,
+	};
+
+	decompress_start(&test_vector, test_vector.data_len);
+	err = fmna_uarp_decompress_write(compressed, sizeof(compressed));
+	zassert_equal(err, -EBADMSG, "Back-reference before the payload start accepted");
+}
+
+ZTEST(suite_fmna_uarp_decompress, test_params_parse)
+{
+	int err;
+	uint8_t value[] = {1, CONFIG_FMNA_UARP_COMPRESSION_WINDOW_SZ2_MAX, 3, 0, 0, 0, 0, 0};
+	struct fmna_uarp_decompress_params params;
+
+	sys_put_be32(100000, &value[4]);
+	err = fmna_uarp_decompress_params_parse(value, sizeof(value), &params);
+	zassert_ok(err, "fmna_uarp_decompress_params_parse failed");
+	zassert_equal(params.window_sz2, CONFIG_FMNA_UARP_COMPRESSION_WINDOW_SZ2_MAX,
+		      "Invalid window size");
+	zassert_equal(params.lookahead_sz2, 3, "Invalid lookahead size");
+	zassert_equal(params.size, 100000, "Invalid decompressed size");
+
+	err = fmna_uarp_decompress_params_parse(value, sizeof(value) - 1, &params);
+	zassert_equal(err, -EINVAL, "Malformed parameters accepted");
+
+	value[0] = 2;
+	err = fmna_uarp_decompress_params_parse(value, sizeof(value), &params);
+	zassert_equal(err, -ENOTSUP, "Unknown algorithm accepted");
+
+	value[0] = 1;
+	value[1] = CONFIG_FMNA_UARP_COMPRESSION_WINDOW_SZ2_MAX + 1;
+	err = fmna_uarp_decompress_params_parse(value, sizeof(value), &params);
+	zassert_equal(err, -ENOTSUP, "Window larger than the decoder buffer accepted");
+
+	value[1] = 4;
+	value[2] = 4;
+	err = fmna_uarp_decompress_params_parse(value, sizeof(value), &params);
+	zassert_equal(err, -ENOTSUP, "Lookahead not smaller than the window accepted");
+}
+
+ZTEST_SUITE(suite_fmna_uarp_decompress, NULL, NULL, before_each, NULL, NULL);
@@ -0,0 +1,26 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-4-Clause
+ */
+
+#ifndef VECTORS_H_
+#define VECTORS_H_
+
+#include <zephyr/kernel.h>
+
+/* Data compressed by the heatshrink encoder of the ncsfmntools package. */
+struct test_vector {
+	const char *name;
+	uint8_t window_sz2;
+	uint8_t lookahead_sz2;
+	const uint8_t *data;
+	size_t data_len;
+	const uint8_t *compressed;
+	size_t compressed_len;
+};
+
+extern const struct test_vector test_vectors[];
+extern const size_t test_vector_count;
+
+#endif /* VECTORS_H_ */
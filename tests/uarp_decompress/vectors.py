@@ -0,0 +1,105 @@
+#
+# Copyright (c) 2024 Nordic Semiconductor
+#
+# SPDX-License-Identifier: LicenseRef-Nordic-4-Clause
+#
+
+'''Generates the decompression test vectors with the ncsfmntools heatshrink encoder.'''
+
+import argparse
+import os
+import sys
+
+sys.path.insert(0, os.path.join(os.path.dirname(__file__), '..', '..', 'tools',
+                                'ncsfmntools', 'scripts'))
+
+import heatshrink  # noqa: E402
+
+WORDS = [b'find', b'my', b'network', b'accessory', b'firmware', b'update', b'asset',
+         b'payload', b'controller', b'window', b'the', b'a', b'of', b'and', b'to']
+
+
+class Lcg:
+    '''Deterministic generator, independent of the Python version.'''
+    def __init__(self, seed):
+        self.state = seed
+
+    def next(self):
+        self.state = (self.state * 1103515245 + 12345) & 0x7FFFFFFF
+        return self.state >> 8
+
+
+def text(size, seed):
+    rng = Lcg(seed)
+    out = bytearray()
+    while len(out) < size:
+        out += WORDS[rng.next() % len(WORDS)] + b' '
+    return bytes(out[:size])
+
+
+def noise(size, seed):
+    rng = Lcg(seed)
+    return bytes(rng.next() & 0xFF for _ in range(size))
+
+
+def vectors(window_sz2_max):
+    '''Yields (name, window_sz2, lookahead_sz2, data) tuples.'''
+    window = 1 << window_sz2_max
+    mid_sz2 = min(8, window_sz2_max)
+    lookahead_sz2 = min(4, window_sz2_max - 1)
+
+    yield 'text_min_window', 4, 3, text(3000, 1)
+    yield 'text_mid_window', mid_sz2, lookahead_sz2, text(6000, 2)
+    yield 'noise', mid_sz2, lookahead_sz2, noise(2000, 3)
+    yield 'zeros', 4, 3, bytes(3000)
+    yield 'text_max_window', window_sz2_max, lookahead_sz2, text(2 * window + 100, 4)
+    # Back-references at the largest distance of the window.
+    block = noise(window, 5)
+    yield 'far_max_window', window_sz2_max, lookahead_sz2, block + block + block[:100]
+    # Back-references of the largest length.
+    yield 'zeros_max_lookahead', window_sz2_max, window_sz2_max - 1, bytes(3 * window)
+
+
+def c_array(name, data):
+    lines = [f'static const uint8_t {name}[] = {{']
+    for i in range(0, len(data), 16):
+        lines.append('\t' + ' '.join(f'0x{b:02x},' for b in data[i:i + 16]))
+    lines.append('};')
+    return '\n'.join(lines)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('--window-sz2-max', type=int, required=True)
+    parser.add_argument('--output', required=True)
+    args = parser.parse_args()
+
+    arrays = []
+    entries = []
+    for name, window_sz2, lookahead_sz2, data in vectors(args.window_sz2_max):
+        compressed = heatshrink.compress(data, window_sz2, lookahead_sz2)
+        assert heatshrink.decompress(compressed, window_sz2, lookahead_sz2) == data
+
+        arrays.append(c_array(f'{name}_data', data))
+        arrays.append(c_array(f'{name}_compressed', compressed))
+        entries.append(f'\t{{\n'
+                       f'\t\t.name = "{name}",\n'
+                       f'\t\t.window_sz2 = {window_sz2},\n'
+                       f'\t\t.lookahead_sz2 = {lookahead_sz2},\n'
+                       f'\t\t.data = {name}_data,\n'
+                       f'\t\t.data_len = sizeof({name}_data),\n'
+                       f'\t\t.compressed = {name}_compressed,\n'
+                       f'\t\t.compressed_len = sizeof({name}_compressed),\n'
+                       f'\t}},')
+
+    with open(args.output, 'w') as f:
+        f.write('/* Generated by vectors.py. Do not edit. */\n\n')
+        f.write('#include "vectors.h"\n\n')
+        f.write('\n\n'.join(arrays))
+        f.write('\n\nconst struct test_vector test_vectors[] = {\n')
+        f.write('\n'.join(entries))
+        f.write('\n};\n\nconst size_t test_vector_count = ARRAY_SIZE(test_vectors);\n')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,261 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-4-Clause
+ */
+
+#include <zephyr/ztest.h>
+#include <zephyr/storage/flash_map.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/crc.h>
+
+#include "fmna_uarp_writer.h"
+#include "fmna_uarp_writer_delta.h"
+
+/* The source image is stored in the flash simulator partition. */
+#define SOURCE_FA_ID	FIXED_PARTITION_ID(slot0_partition)
+#define SOURCE_SIZE	256
+
+#define PATCH_HEADER_LEN	20
+#define PATCH_CONTROL_LEN	12
+
+static uint8_t source[SOURCE_SIZE];
+static uint32_t source_crc;
+
+static uint8_t patch[2 * SOURCE_SIZE];
+static size_t patch_len;
+
+static uint8_t target[2 * SOURCE_SIZE];
+static size_t target_len;
+static size_t target_size;
+static bool target_started;
+static int target_success;
+
+static int target_transfer_start(void *ctx, size_t payload_size)
+{
+	target_started = true;
+	target_size = payload_size;
+
+	return 0;
+}
+
+static int target_transfer_write(void *ctx, const uint8_t *chunk, size_t chunk_size)
+{
+	zassert_true(target_started, "Target writer has not been started");
+	zassert_true(target_len + chunk_size <= target_size, "Target image overflow");
+
+	memcpy(&target[target_len], chunk, chunk_size);
+	target_len += chunk_size;
+
+	return 0;
+}
+
+static int target_transfer_finish(void *ctx, bool success)
+{
+	target_success = success;
+
+	return 0;
+}
+
+static int target_image_confirm(void *ctx)
+{
+	return 0;
+}
+
+FMNA_UARP_WRITER_API_DEF(target_writer_api,
+			 target_transfer_start,
+			 target_transfer_write,
+			 target_transfer_finish,
+			 target_image_confirm,
+			 NULL);
+FMNA_UARP_WRITER_DEF(target_writer, target_writer_api, NULL);
+FMNA_UARP_WRITER_DELTA_DEF(delta_writer, &target_writer, SOURCE_FA_ID);
+
+static void patch_header(uint32_t crc, uint32_t size)
+{
+	memset(patch, 0, PATCH_HEADER_LEN);
+	memcpy(patch, "FMDP", 4);
+	patch[4] = 1;
+	sys_put_be32(SOURCE_SIZE, &patch[8]);
+	sys_put_be32(crc, &patch[12]);
+	sys_put_be32(size, &patch[16]);
+	patch_len = PATCH_HEADER_LEN;
+}
+
+static void patch_entry(uint32_t diff_len, uint32_t extra_len, const uint8_t *extra,
+			int32_t seek)
+{
+	sys_put_be32(diff_len, &patch[patch_len]);
+	sys_put_be32(extra_len, &patch[patch_len + 4]);
+	sys_put_be32(seek, &patch[patch_len + 8]);
+	patch_len += PATCH_CONTROL_LEN;
+
+	memset(&patch[patch_len], 0, diff_len);
+	patch_len += diff_len;
+
+	if (extra_len > 0) {
+		memcpy(&patch[patch_len], extra, extra_len);
+		patch_len += extra_len;
+	}
+}
+
+/* Target image: source[0..100) with byte 10 incremented, eight new bytes
+ * and source[120..170).
+ */
+static size_t patch_create(uint8_t *expected)
+{
+	static const uint8_t extra[] = "NEWBYTES";
+	size_t len = 0;
+
+	patch_header(source_crc, 100 + 8 + 50);
+	patch_entry(100, 8, extra, 20);
+	patch[PATCH_HEADER_LEN + PATCH_CONTROL_LEN + 10] = 1;
+	patch_entry(50, 0, NULL, 0);
+
+	memcpy(&expected[len], source, 100);
+	expected[10]++;
+	len += 100;
+	memcpy(&expected[len], extra, 8);
+	len += 8;
+	memcpy(&expected[len], &source[120], 50);
+	len += 50;
+
+	return len;
+}
+
+static int patch_write(size_t len, size_t chunk_size)
+{
+	int err;
+	size_t chunk_len;
+
+	for (size_t offset = 0; offset < len; offset += chunk_len) {
+		chunk_len = MIN(chunk_size, len - offset);
+
+		err = fmna_uarp_writer_transfer_write(&delta_writer, &patch[offset], chunk_len);
+		if (err) {
+			return err;
+		}
+	}
+
+	return 0;
+}
+
+static void *suite_setup(void)
+{
+	int err;
+	const struct flash_area *fap;
+
+	for (size_t i = 0; i < sizeof(source); i++) {
+		source[i] = (i * 7) + 3;
+	}
+	source_crc = crc32_ieee(source, sizeof(source));
+
+	err = flash_area_open(SOURCE_FA_ID, &fap);
+	zassert_ok(err, "flash_area_open failed");
+
+	err = flash_area_erase(fap, 0, fap->fa_size);
+	zassert_ok(err, "flash_area_erase failed");
+
+	err = flash_area_write(fap, 0, source, sizeof(source));
+	zassert_ok(err, "flash_area_write failed");
+
+	flash_area_close(fap);
+
+	return NULL;
+}
+
+static void before_each(void *fixture)
+{
+	target_len = 0;
+	target_size = 0;
+	target_started = false;
+	target_success = -1;
+}
+
+static void patch_apply(size_t chunk_size)
+{
+	int err;
+	uint8_t expected[sizeof(target)];
+	size_t expected_len = patch_create(expected);
+
+	err = fmna_uarp_writer_transfer_start(&delta_writer, patch_len);
+	zassert_ok(err, "fmna_uarp_writer_transfer_start failed");
+
+	err = patch_write(patch_len, chunk_size);
+	zassert_ok(err, "Patch write failed");
+
+	err = fmna_uarp_writer_transfer_finish(&delta_writer, true);
+	zassert_ok(err, "fmna_uarp_writer_transfer_finish failed");
+
+	zassert_equal(target_size, expected_len, "Invalid target image size");
+	zassert_equal(target_success, true, "Target writer has not been finished");
+	zassert_equal(target_len, expected_len, "Invalid target image length");
+	zassert_mem_equal(target, expected, expected_len, "Invalid target image");
+}
+
+ZTEST(suite_fmna_uarp_delta, test_patch_apply)
+{
+	patch_apply(sizeof(patch));
+}
+
+ZTEST(suite_fmna_uarp_delta, test_patch_apply_byte_by_byte)
+{
+	patch_apply(1);
+}
+
+ZTEST(suite_fmna_uarp_delta, test_source_mismatch)
+{
+	int err;
+	uint8_t expected[sizeof(target)];
+
+	patch_create(expected);
+	sys_put_be32(source_crc ^ 1, &patch[12]);
+
+	err = fmna_uarp_writer_transfer_start(&delta_writer, patch_len);
+	zassert_ok(err, "fmna_uarp_writer_transfer_start failed");
+
+	err = patch_write(patch_len, sizeof(patch));
+	zassert_equal(err, -EINVAL, "Patch for a different source image accepted");
+
+	err = fmna_uarp_writer_transfer_finish(&delta_writer, false);
+	zassert_ok(err, "fmna_uarp_writer_transfer_finish failed");
+	zassert_false(target_started, "Target writer started for a different source image");
+}
+
+ZTEST(suite_fmna_uarp_delta, test_patch_truncated)
+{
+	int err;
+	uint8_t expected[sizeof(target)];
+
+	patch_create(expected);
+
+	err = fmna_uarp_writer_transfer_start(&delta_writer, patch_len);
+	zassert_ok(err, "fmna_uarp_writer_transfer_start failed");
+
+	err = patch_write(patch_len - 1, sizeof(patch));
+	zassert_ok(err, "Patch write failed");
+
+	err = fmna_uarp_writer_transfer_finish(&delta_writer, true);
+	zassert_equal(err, -EBADMSG, "Truncated patch accepted");
+	zassert_equal(target_success, false, "Target image not invalidated");
+}
+
+ZTEST(suite_fmna_uarp_delta, test_seek_outside_source)
+{
+	int err;
+
+	patch_header(source_crc, 16);
+	patch_entry(8, 0, NULL, -100);
+	patch_entry(8, 0, NULL, 0);
+
+	err = fmna_uarp_writer_transfer_start(&delta_writer, patch_len);
+	zassert_ok(err, "fmna_uarp_writer_transfer_start failed");
+
+	err = patch_write(patch_len, sizeof(patch));
+	zassert_equal(err, -EBADMSG, "Seek outside the source image accepted");
+
+	err = fmna_uarp_writer_transfer_finish(&delta_writer, false);
+	zassert_ok(err, "fmna_uarp_writer_transfer_finish failed");
+}
+
+ZTEST_SUITE(suite_fmna_uarp_delta, NULL, suite_setup, before_each, NULL, NULL);
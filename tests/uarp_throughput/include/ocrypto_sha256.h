@@ -0,0 +1,43 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-4-Clause
+ */
+
+#ifndef OCRYPTO_SHA256_H_
+#define OCRYPTO_SHA256_H_
+
+/* Minimal replacement of the nrfxlib ocrypto SHA-256 API, which is not
+ * available for native_sim. Only the functions used by the UARP module
+ * are provided.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define ocrypto_sha256_BYTES 32
+
+typedef struct {
+	uint32_t h[8];
+	uint8_t buffer[64];
+	size_t length;
+	uint64_t total;
+} ocrypto_sha256_ctx;
+
+void ocrypto_sha256_init(ocrypto_sha256_ctx *ctx);
+
+void ocrypto_sha256_update(ocrypto_sha256_ctx *ctx, const uint8_t *in, size_t in_len);
+
+void ocrypto_sha256_final(ocrypto_sha256_ctx *ctx, uint8_t r[ocrypto_sha256_BYTES]);
+
+void ocrypto_sha256(uint8_t r[ocrypto_sha256_BYTES], const uint8_t *in, size_t in_len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* OCRYPTO_SHA256_H_ */
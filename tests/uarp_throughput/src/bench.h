@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-4-Clause
+ */
+
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#include <zephyr/kernel.h>
+#include <zephyr/storage/flash_map.h>
+
+/* Partition that stores the received payload. */
+#define BENCH_WRITE_FA_ID FIXED_PARTITION_ID(slot1_partition)
+
+#define BENCH_PAYLOAD_TAG "FWUP"
+
+/* Model of the Bluetooth LE link between the controller and the accessory. */
+struct bench_link {
+	/* Negotiated ATT MTU. */
+	uint16_t mtu;
+	/* Time needed to transfer a single ATT write or indication together
+	 * with its response or confirmation.
+	 */
+	uint32_t packet_time_us;
+};
+
+struct bench_result {
+	/* Time from the SuperBinary offer to the upload complete notification. */
+	uint64_t transfer_us;
+	/* Number of the payload data requests sent by the accessory. */
+	uint32_t data_requests;
+	/* Largest number of bytes requested by a single payload data request. */
+	uint16_t max_request;
+	/* Number of the ATT packets in both directions. */
+	uint32_t packets;
+	/* Number of the SuperBinary bytes sent in the payload data responses. */
+	uint32_t data_bytes;
+	/* Asset processing flags reported by the accessory. */
+	uint16_t processing_flags;
+};
+
+/** Run a single update session with the simulated controller.
+ *
+ * The controller synchronizes with the accessory, offers the SuperBinary and
+ * responds to the data requests until the accessory reports the end of the
+ * asset processing.
+ *
+ * @param link Link model.
+ * @param super_binary SuperBinary offered to the accessory.
+ * @param super_binary_len Length of the SuperBinary.
+ * @param result Session result.
+ *
+ * @return 0 on success, otherwise negative error code.
+ */
+int bench_controller_run(const struct bench_link *link, const uint8_t *super_binary,
+			 size_t super_binary_len, struct bench_result *result);
+
+/** Stop the next sessions at the first data request for the offset or beyond it.
+ *
+ * The request is left unanswered and bench_controller_run returns -ECANCELED.
+ *
+ * @param offset SuperBinary offset. Zero runs the sessions to the end.
+ */
+void bench_controller_cut_set(size_t offset);
+
+/** Rescind the SuperBinary of the stopped session and wait for the acknowledgment.
+ *
+ * Runs in the calling thread with the link model and the result of the stopped session.
+ */
+int bench_controller_rescind(void);
+
+/** Pass a message sent by the accessory to the controller. Called from the UARP context. */
+void bench_controller_message_received(const uint8_t *data, uint16_t len);
+
+/** Set the ATT MTU of the next connection. The accessory is connected with the first write. */
+void bench_transport_connect(uint16_t mtu);
+
+/** Write a message from the controller to the accessory. */
+int bench_transport_write(const uint8_t *data, uint16_t len);
+
+/** Confirm the reception of the message sent by the accessory. */
+int bench_transport_send_complete(void);
+
+/** Disconnect the controller and wait until the UARP context removes it. */
+void bench_transport_disconnect(void);
+
+/** Initialize the UARP module again with the next write, like after an accessory reset.
+ *
+ * The controller must be disconnected.
+ */
+void bench_transport_reset(void);
+
+/** Lose the accessory power. The flash and the stored checkpoint do not change
+ * until the power is restored.
+ */
+void bench_power_cut(void);
+
+/** Restore the accessory power. */
+void bench_power_restore(void);
+
+/** Check if the accessory power is lost. */
+bool bench_power_is_lost(void);
+
+/** Get the CPU time consumed by the native simulator process. Runs in the runner context. */
+uint64_t bench_host_cpu_time_ns(void);
+
+#endif /* BENCH_H_ */
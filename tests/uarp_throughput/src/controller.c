@@ -0,0 +1,313 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-4-Clause
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/byteorder.h>
+
+#include "CoreUARPProtocolDefines.h"
+
+#include "bench.h"
+
+/* Simulated UARP controller. It follows the message flow of the reference
+ * controller in tests/uarp_update. The controller thread also models the
+ * link: each message takes the packet time for every ATT packet needed to
+ * carry it, in the same way for the writes and for the indications.
+ */
+
+#define ATT_HEADER_LEN		3
+#define GATT_PKT_HEADER_LEN	1
+#define ASSET_ID		1
+#define PROTOCOL_VERSION	1
+#define RESPONSE_TIMEOUT	K_SECONDS(30)
+#define STACK_SIZE		4096
+
+#define MAX_RX_MESSAGE_SIZE (sizeof(union UARPMessages) + CONFIG_FMNA_UARP_TX_MSG_PAYLOAD_SIZE)
+#define MAX_TX_MESSAGE_SIZE (sizeof(union UARPMessages) + CONFIG_FMNA_UARP_RX_MSG_PAYLOAD_SIZE)
+
+static struct {
+	const struct bench_link *link;
+	const uint8_t *super_binary;
+	size_t super_binary_len;
+	struct bench_result *result;
+	size_t cut_offset;
+	uint16_t tx_msg_id;
+	/* Message sent by the accessory and not yet confirmed. */
+	uint8_t inbox[MAX_RX_MESSAGE_SIZE];
+	uint16_t inbox_len;
+	uint8_t rx_buf[MAX_RX_MESSAGE_SIZE];
+	uint8_t tx_buf[MAX_TX_MESSAGE_SIZE];
+	int err;
+} controller;
+
+static K_SEM_DEFINE(inbox_sem, 0, 1);
+static K_SEM_DEFINE(start_sem, 0, 1);
+static K_SEM_DEFINE(done_sem, 0, 1);
+
+static void link_transfer(uint16_t len)
+{
+	uint32_t packets = DIV_ROUND_UP(len, controller.link->mtu - ATT_HEADER_LEN -
+					     GATT_PKT_HEADER_LEN);
+
+	controller.result->packets += packets;
+	k_sleep(K_USEC(packets * controller.link->packet_time_us));
+}
+
+static int msg_send(uint16_t msg_type, uint16_t payload_len)
+{
+	struct UARPMsgHeader *hdr = (struct UARPMsgHeader *)controller.tx_buf;
+	uint16_t len = sizeof(*hdr) + payload_len;
+
+	hdr->msgType = sys_cpu_to_be16(msg_type);
+	hdr->msgPayloadLength = sys_cpu_to_be16(payload_len);
+	hdr->msgID = sys_cpu_to_be16(controller.tx_msg_id++);
+
+	link_transfer(len);
+
+	return bench_transport_write(controller.tx_buf, len);
+}
+
+static int msg_recv(uint16_t *msg_type)
+{
+	int err;
+	const struct UARPMsgHeader *hdr = (const struct UARPMsgHeader *)controller.rx_buf;
+
+	err = k_sem_take(&inbox_sem, RESPONSE_TIMEOUT);
+	if (err) {
+		return -ETIMEDOUT;
+	}
+
+	link_transfer(controller.inbox_len);
+
+	memcpy(controller.rx_buf, controller.inbox, controller.inbox_len);
+
+	err = bench_transport_send_complete();
+	if (err) {
+		return err;
+	}
+
+	*msg_type = sys_be16_to_cpu(hdr->msgType);
+
+	return 0;
+}
+
+static int msg_wait(uint16_t expected_type)
+{
+	int err;
+	uint16_t msg_type;
+
+	do {
+		err = msg_recv(&msg_type);
+		if (err) {
+			return err;
+		}
+	} while (msg_type != expected_type);
+
+	return 0;
+}
+
+static int sync_send(void)
+{
+	bench_transport_connect(controller.link->mtu);
+	controller.tx_msg_id = 1;
+
+	return msg_send(kUARPMsgSync, 0);
+}
+
+static int version_discover(void)
+{
+	int err;
+	struct UARPMsgVersionDiscoveryRequest *msg =
+		(struct UARPMsgVersionDiscoveryRequest *)controller.tx_buf;
+
+	msg->protocolVersionController = sys_cpu_to_be16(PROTOCOL_VERSION);
+
+	err = msg_send(kUARPMsgVersionDiscoveryRequest,
+		       sizeof(*msg) - sizeof(struct UARPMsgHeader));
+	if (err) {
+		return err;
+	}
+
+	return msg_wait(kUARPMsgVersionDiscoveryResponse);
+}
+
+static int asset_offer(void)
+{
+	int err;
+	const struct UARPSuperBinaryHeader *sb_hdr =
+		(const struct UARPSuperBinaryHeader *)controller.super_binary;
+	struct UARPMsgAssetAvailableNotification *msg =
+		(struct UARPMsgAssetAvailableNotification *)controller.tx_buf;
+
+	msg->assetTag = 0;
+	msg->assetFlags = sys_cpu_to_be16(kUARPAssetFlagsAssetTypeSuperBinary);
+	msg->assetID = sys_cpu_to_be16(ASSET_ID);
+	msg->assetVersion = sb_hdr->superBinaryVersion;
+	msg->assetLength = sys_cpu_to_be32(controller.super_binary_len);
+	msg->assetNumPayloads = sys_cpu_to_be16(sys_be32_to_cpu(sb_hdr->payloadHeadersLength) /
+						sizeof(struct UARPPayloadHeader));
+
+	err = msg_send(kUARPMsgAssetAvailableNotification,
+		       sizeof(*msg) - sizeof(struct UARPMsgHeader));
+	if (err) {
+		return err;
+	}
+
+	return msg_wait(kUARPMsgAssetAvailableNotificationAck);
+}
+
+static int data_respond(void)
+{
+	const struct UARPMsgAssetDataRequest *req =
+		(const struct UARPMsgAssetDataRequest *)controller.rx_buf;
+	struct UARPMsgAssetDataResponse *rsp = (struct UARPMsgAssetDataResponse *)controller.tx_buf;
+	uint32_t offset = sys_be32_to_cpu(req->dataOffset);
+	uint16_t requested = sys_be16_to_cpu(req->numBytesRequested);
+	uint16_t responded = 0;
+	uint16_t status = kUARPStatusSuccess;
+
+	if (requested > CONFIG_FMNA_UARP_RX_MSG_PAYLOAD_SIZE) {
+		return -EMSGSIZE;
+	}
+
+	if ((controller.cut_offset > 0) && (offset >= controller.cut_offset)) {
+		return -ECANCELED;
+	}
+
+	if (offset <= controller.super_binary_len) {
+		responded = MIN(requested, controller.super_binary_len - offset);
+		memcpy(&controller.tx_buf[sizeof(*rsp)], &controller.super_binary[offset],
+		       responded);
+	} else {
+		status = kUARPStatusInvalidDataRequestOffset;
+	}
+
+	rsp->status = sys_cpu_to_be16(status);
+	rsp->assetID = req->assetID;
+	rsp->dataOffset = req->dataOffset;
+	rsp->numBytesRequested = req->numBytesRequested;
+	rsp->numBytesResponded = sys_cpu_to_be16(responded);
+
+	controller.result->data_requests++;
+	controller.result->max_request = MAX(controller.result->max_request, requested);
+	controller.result->data_bytes += responded;
+
+	return msg_send(kUARPMsgAssetDataResponse,
+			sizeof(*rsp) - sizeof(struct UARPMsgHeader) + responded);
+}
+
+static int asset_process(void)
+{
+	int err;
+	uint16_t msg_type;
+	int64_t start = k_uptime_ticks();
+	const struct UARPMsgAssetProcessingNotification *notification =
+		(const struct UARPMsgAssetProcessingNotification *)controller.rx_buf;
+
+	err = asset_offer();
+	if (err) {
+		return err;
+	}
+
+	while (true) {
+		err = msg_recv(&msg_type);
+		if (err) {
+			return err;
+		}
+
+		if (msg_type == kUARPMsgAssetDataRequest) {
+			err = data_respond();
+			if (err) {
+				return err;
+			}
+		} else if (msg_type == kUARPMsgAssetProcessingNotification) {
+			break;
+		}
+	}
+
+	controller.result->transfer_us = k_ticks_to_us_floor64(k_uptime_ticks() - start);
+	controller.result->processing_flags =
+		sys_be16_to_cpu(notification->assetProcessingFlags);
+
+	return 0;
+}
+
+static int session_run(void)
+{
+	int err;
+
+	err = sync_send();
+	if (err) {
+		return err;
+	}
+
+	err = version_discover();
+	if (err) {
+		return err;
+	}
+
+	return asset_process();
+}
+
+static void controller_thread_entry_point(void *arg0, void *arg1, void *arg2)
+{
+	while (true) {
+		k_sem_take(&start_sem, K_FOREVER);
+		controller.err = session_run();
+		k_sem_give(&done_sem);
+	}
+}
+
+K_THREAD_DEFINE(bench_controller_thread, STACK_SIZE,
+		controller_thread_entry_point, NULL, NULL, NULL,
+		CONFIG_UARP_THROUGHPUT_CONTROLLER_PRIORITY, 0, 0);
+
+void bench_controller_cut_set(size_t offset)
+{
+	controller.cut_offset = offset;
+}
+
+int bench_controller_rescind(void)
+{
+	int err;
+	struct UARPMsgAssetRescindedNotification *msg =
+		(struct UARPMsgAssetRescindedNotification *)controller.tx_buf;
+
+	msg->assetID = sys_cpu_to_be16(ASSET_ID);
+
+	err = msg_send(kUARPMsgAssetRescindedNotification,
+		       sizeof(*msg) - sizeof(struct UARPMsgHeader));
+	if (err) {
+		return err;
+	}
+
+	return msg_wait(kUARPMsgAssetRescindedNotificationAck);
+}
+
+void bench_controller_message_received(const uint8_t *data, uint16_t len)
+{
+	__ASSERT_NO_MSG(len <= sizeof(controller.inbox));
+
+	memcpy(controller.inbox, data, len);
+	controller.inbox_len = len;
+	k_sem_give(&inbox_sem);
+}
+
+int bench_controller_run(const struct bench_link *link, const uint8_t *super_binary,
+			 size_t super_binary_len, struct bench_result *result)
+{
+	memset(result, 0, sizeof(*result));
+
+	controller.link = link;
+	controller.super_binary = super_binary;
+	controller.super_binary_len = super_binary_len;
+	controller.result = result;
+	k_sem_reset(&inbox_sem);
+
+	k_sem_give(&start_sem);
+	k_sem_take(&done_sem, K_FOREVER);
+
+	return controller.err;
+}
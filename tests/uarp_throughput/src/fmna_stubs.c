@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-4-Clause
+ */
+
+#include <string.h>
+
+#include "fmna_serial_number.h"
+#include "fmna_storage.h"
+#include "fmna_version.h"
+
+#include "bench.h"
+
+/* The FMN modules used by the UARP module. The checkpoint is kept in RAM, so
+ * the checkpoint writes do not contribute to the measured time and the
+ * checkpoint survives the simulated accessory reset. While the power is lost,
+ * the checkpoint does not change.
+ */
+
+static struct {
+	uint8_t data[256];
+	size_t len;
+} checkpoint;
+
+static bool power_lost;
+
+void bench_power_cut(void)
+{
+	power_lost = true;
+}
+
+void bench_power_restore(void)
+{
+	power_lost = false;
+}
+
+bool bench_power_is_lost(void)
+{
+	return power_lost;
+}
+
+int fmna_serial_number_get(uint8_t serial_number[FMNA_SERIAL_NUMBER_BLEN])
+{
+	memcpy(serial_number, "0123456789ABCDEF", FMNA_SERIAL_NUMBER_BLEN);
+
+	return 0;
+}
+
+int fmna_version_fw_get(struct fmna_version *ver)
+{
+	memset(ver, 0, sizeof(*ver));
+	ver->major = 1;
+
+	return 0;
+}
+
+int fmna_storage_uarp_checkpoint_store(const uint8_t *data, size_t len)
+{
+	if (len > sizeof(checkpoint.data)) {
+		return -ENOMEM;
+	}
+
+	if (!power_lost) {
+		memcpy(checkpoint.data, data, len);
+		checkpoint.len = len;
+	}
+
+	return 0;
+}
+
+int fmna_storage_uarp_checkpoint_load(uint8_t *data, size_t len)
+{
+	if (checkpoint.len == 0) {
+		return -ENOENT;
+	}
+
+	if (checkpoint.len != len) {
+		return -EINVAL;
+	}
+
+	memcpy(data, checkpoint.data, len);
+
+	return 0;
+}
+
+int fmna_storage_uarp_checkpoint_delete(void)
+{
+	if (!power_lost) {
+		checkpoint.len = 0;
+	}
+
+	return 0;
+}
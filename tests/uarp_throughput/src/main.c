@@ -0,0 +1,367 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-4-Clause
+ */
+
+#include <inttypes.h>
+
+#include <zephyr/ztest.h>
+#include <zephyr/storage/flash_map.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/sys_heap.h>
+
+#include <ocrypto_sha256.h>
+
+#include "CoreUARPProtocolDefines.h"
+
+#include "fmna_uarp.h"
+
+#include "bench.h"
+
+#define PAYLOAD_SIZE		CONFIG_UARP_THROUGHPUT_PAYLOAD_SIZE
+#define TLV_TYPE_SHA2		0xF4CE36FEuL
+#define TLV_TYPE_COMPRESSION	0xF4CE36FDuL
+#define SHA2_TLV_LEN		(sizeof(struct UARPTLVHeader) + ocrypto_sha256_BYTES)
+#define HEADERS_LEN		(sizeof(struct UARPSuperBinaryHeader) + \
+				 sizeof(struct UARPPayloadHeader))
+
+#if CONFIG_FMNA_UARP_COMPRESSION
+#define COMPRESSION_TLV_LEN	(sizeof(struct UARPTLVHeader) + 8)
+#define WINDOW_SZ2		CONFIG_FMNA_UARP_COMPRESSION_WINDOW_SZ2_MAX
+#define LOOKAHEAD_SZ2		4
+/* The payload made of literals only. */
+#define PAYLOAD_LEN_MAX		DIV_ROUND_UP(PAYLOAD_SIZE * 9, 8)
+#else
+#define COMPRESSION_TLV_LEN	0
+#define PAYLOAD_LEN_MAX		PAYLOAD_SIZE
+#endif
+
+#define METADATA_LEN		(SHA2_TLV_LEN + COMPRESSION_TLV_LEN)
+#define PAYLOAD_OFFSET		(HEADERS_LEN + METADATA_LEN)
+#define SUPER_BINARY_LEN_MAX	(PAYLOAD_OFFSET + PAYLOAD_LEN_MAX)
+
+/* The active firmware version reported by the accessory is 1.0.0. */
+#define SUPER_BINARY_VERSION	2
+
+extern struct k_heap _system_heap;
+
+static uint8_t super_binary[SUPER_BINARY_LEN_MAX];
+static size_t super_binary_len;
+
+/* Image expected in the flash after the update. */
+static uint8_t image[PAYLOAD_SIZE];
+
+static void version_set(struct UARPVersion *version)
+{
+	memset(version, 0, sizeof(*version));
+	version->major = sys_cpu_to_be32(SUPER_BINARY_VERSION);
+}
+
+static uint32_t rand_next(uint32_t *x)
+{
+	*x ^= *x << 13;
+	*x ^= *x >> 17;
+	*x ^= *x << 5;
+
+	return *x;
+}
+
+#if CONFIG_FMNA_UARP_COMPRESSION
+static struct {
+	uint8_t *out;
+	size_t len;
+	uint32_t bits;
+	uint8_t count;
+} bit_writer;
+
+static void bits_put(uint32_t value, uint8_t count)
+{
+	bit_writer.bits = (bit_writer.bits << count) | (value & (BIT(count) - 1));
+	bit_writer.count += count;
+
+	while (bit_writer.count >= 8) {
+		bit_writer.count -= 8;
+		bit_writer.out[bit_writer.len++] = bit_writer.bits >> bit_writer.count;
+	}
+}
+
+/* Heatshrink stream of random literals and back-references, decoded into the
+ * image at the same time. The image is compressible like a firmware image, so
+ * the decompressed data outgrows the payload window.
+ */
+static size_t payload_create(uint8_t *payload)
+{
+	uint32_t x = 0x12345678;
+	uint32_t r;
+	size_t head = 0;
+	size_t dist;
+	size_t len;
+
+	bit_writer.out = payload;
+	bit_writer.len = 0;
+	bit_writer.bits = 0;
+	bit_writer.count = 0;
+
+	while (head < PAYLOAD_SIZE) {
+		r = rand_next(&x);
+
+		if ((head == 0) || ((r & 0x3) == 0)) {
+			image[head++] = r >> 8;
+			bits_put(1, 1);
+			bits_put(r >> 8, 8);
+			continue;
+		}
+
+		dist = ((r >> 8) % MIN(head, BIT(WINDOW_SZ2))) + 1;
+		len = MIN(((r >> 24) % BIT(LOOKAHEAD_SZ2)) + 1, PAYLOAD_SIZE - head);
+		bits_put(0, 1);
+		bits_put(dist - 1, WINDOW_SZ2);
+		bits_put(len - 1, LOOKAHEAD_SZ2);
+
+		for (size_t i = 0; i < len; i++, head++) {
+			image[head] = image[head - dist];
+		}
+	}
+
+	/* Pad the last byte with zeros. */
+	if (bit_writer.count > 0) {
+		bits_put(0, 8 - bit_writer.count);
+	}
+
+	return bit_writer.len;
+}
+
+static void compression_tlv_set(struct UARPTLVHeader *tlv)
+{
+	uint8_t *value = (uint8_t *)&tlv[1];
+
+	tlv->tlvType = sys_cpu_to_be32(TLV_TYPE_COMPRESSION);
+	tlv->tlvLength = sys_cpu_to_be32(COMPRESSION_TLV_LEN - sizeof(*tlv));
+
+	value[0] = 1;
+	value[1] = WINDOW_SZ2;
+	value[2] = LOOKAHEAD_SZ2;
+	value[3] = 0;
+	sys_put_be32(PAYLOAD_SIZE, &value[4]);
+}
+#else
+static size_t payload_create(uint8_t *payload)
+{
+	uint32_t x = 0x12345678;
+
+	/* Pseudo-random content, so no two windows of the payload are equal. */
+	for (size_t i = 0; i < PAYLOAD_SIZE; i++) {
+		image[i] = rand_next(&x);
+	}
+
+	memcpy(payload, image, PAYLOAD_SIZE);
+
+	return PAYLOAD_SIZE;
+}
+#endif
+
+/* SuperBinary with a single payload in the layout generated by the ncsfmntools
+ * superbinary command: the headers, the payload metadata with the SHA-256 hash
+ * and the payload content. With the CONFIG_FMNA_UARP_COMPRESSION option, the
+ * payload is compressed like by the "superbinary --compress" command.
+ */
+static void super_binary_create(void)
+{
+	struct UARPSuperBinaryHeader *sb_hdr = (struct UARPSuperBinaryHeader *)super_binary;
+	struct UARPPayloadHeader *pl_hdr = (struct UARPPayloadHeader *)&sb_hdr[1];
+	struct UARPTLVHeader *tlv = (struct UARPTLVHeader *)&super_binary[HEADERS_LEN];
+	uint8_t *payload = &super_binary[PAYLOAD_OFFSET];
+	size_t payload_len;
+
+	payload_len = payload_create(payload);
+	super_binary_len = PAYLOAD_OFFSET + payload_len;
+
+	sb_hdr->superBinaryFormatVersion = sys_cpu_to_be32(kUARPSuperBinaryFormatVersion);
+	sb_hdr->superBinaryHeaderLength = sys_cpu_to_be32(sizeof(*sb_hdr));
+	sb_hdr->superBinaryLength = sys_cpu_to_be32(super_binary_len);
+	version_set(&sb_hdr->superBinaryVersion);
+	sb_hdr->superBinaryMetadataOffset = sys_cpu_to_be32(HEADERS_LEN);
+	sb_hdr->superBinaryMetadataLength = 0;
+	sb_hdr->payloadHeadersOffset = sys_cpu_to_be32(sizeof(*sb_hdr));
+	sb_hdr->payloadHeadersLength = sys_cpu_to_be32(sizeof(*pl_hdr));
+
+	pl_hdr->payloadHeaderLength = sys_cpu_to_be32(sizeof(*pl_hdr));
+	memcpy(&pl_hdr->payloadTag, BENCH_PAYLOAD_TAG, sizeof(pl_hdr->payloadTag));
+	version_set(&pl_hdr->payloadVersion);
+	pl_hdr->payloadMetadataOffset = sys_cpu_to_be32(HEADERS_LEN);
+	pl_hdr->payloadMetadataLength = sys_cpu_to_be32(METADATA_LEN);
+	pl_hdr->payloadOffset = sys_cpu_to_be32(PAYLOAD_OFFSET);
+	pl_hdr->payloadLength = sys_cpu_to_be32(payload_len);
+
+	tlv->tlvType = sys_cpu_to_be32(TLV_TYPE_SHA2);
+	tlv->tlvLength = sys_cpu_to_be32(ocrypto_sha256_BYTES);
+	ocrypto_sha256((uint8_t *)&tlv[1], payload, payload_len);
+
+#if CONFIG_FMNA_UARP_COMPRESSION
+	compression_tlv_set((struct UARPTLVHeader *)&super_binary[HEADERS_LEN + SHA2_TLV_LEN]);
+#endif
+}
+
+static void image_verify(void)
+{
+	int err;
+	const struct flash_area *fap;
+	uint8_t buf[256];
+
+	err = flash_area_open(BENCH_WRITE_FA_ID, &fap);
+	zassert_ok(err, "flash_area_open failed");
+
+	for (size_t offset = 0; offset < PAYLOAD_SIZE; offset += sizeof(buf)) {
+		size_t len = MIN(sizeof(buf), PAYLOAD_SIZE - offset);
+
+		err = flash_area_read(fap, offset, buf, len);
+		zassert_ok(err, "flash_area_read failed");
+		zassert_mem_equal(buf, &image[offset], len, "Invalid image at offset %zu", offset);
+	}
+
+	flash_area_close(fap);
+}
+
+static void throughput_measure(uint16_t mtu, uint32_t packet_time_us)
+{
+	int err;
+	uint64_t cpu_ns;
+	uint64_t throughput;
+	struct bench_result result;
+	const struct bench_link link = {
+		.mtu = mtu,
+		.packet_time_us = packet_time_us,
+	};
+
+	cpu_ns = bench_host_cpu_time_ns();
+	err = bench_controller_run(&link, super_binary, super_binary_len, &result);
+	cpu_ns = bench_host_cpu_time_ns() - cpu_ns;
+
+	bench_transport_disconnect();
+
+	zassert_ok(err, "Update session failed, err %d", err);
+	zassert_equal(result.processing_flags, kUARPAssetProcessingFlagsUploadComplete,
+		      "Upload not completed, flags 0x%04x", result.processing_flags);
+
+	image_verify();
+
+	throughput = (uint64_t)PAYLOAD_SIZE * USEC_PER_SEC / MAX(result.transfer_us, 1);
+
+	/* One line per run. Compare the lines from the handler.log files of the
+	 * twister scenarios to compare the configurations.
+	 */
+	TC_PRINT("UARP_THROUGHPUT window=%d rx=%d tx=%d mode=%s mtu=%u packet_us=%u "
+		 "size=%d sent=%zu time_ms=%" PRIu64 " throughput_Bps=%" PRIu64 " "
+		 "cpu_us_per_kB=%" PRIu64 " requests=%u max_request=%u packets=%u\n",
+		 CONFIG_FMNA_UARP_PAYLOAD_WINDOW_SIZE,
+		 CONFIG_FMNA_UARP_RX_MSG_PAYLOAD_SIZE,
+		 CONFIG_FMNA_UARP_TX_MSG_PAYLOAD_SIZE,
+		 IS_ENABLED(CONFIG_FMNA_UARP_DEDICATED_THREAD) ? "thread" : "workqueue",
+		 mtu, packet_time_us, PAYLOAD_SIZE, super_binary_len - PAYLOAD_OFFSET,
+		 result.transfer_us / USEC_PER_MSEC, throughput,
+		 cpu_ns / NSEC_PER_USEC * 1024 / PAYLOAD_SIZE,
+		 result.data_requests, result.max_request, result.packets);
+}
+
+static void *suite_setup(void)
+{
+	uint8_t hash[ocrypto_sha256_BYTES];
+	static const uint8_t expected[ocrypto_sha256_BYTES] = {
+		0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea, 0x41, 0x41, 0x40, 0xde,
+		0x5d, 0xae, 0x22, 0x23, 0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17, 0x7a, 0x9c,
+		0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad,
+	};
+
+	/* The accessory and the controller share the SHA-256 replacement. */
+	ocrypto_sha256(hash, (const uint8_t *)"abc", 3);
+	zassert_mem_equal(hash, expected, sizeof(hash), "Invalid SHA-256 implementation");
+
+	super_binary_create();
+
+	return NULL;
+}
+
+/* The peaks are reported once, as the pool and heap statistics cover all runs. */
+static void suite_teardown(void *fixture)
+{
+	struct sys_memory_stats stats;
+
+	sys_heap_runtime_stats_get(&_system_heap.heap, &stats);
+
+	TC_PRINT("UARP_MEMORY pool_peak_B=%zu heap_peak_B=%zu\n",
+		 fmna_uarp_mem_peak_get(), stats.max_allocated_bytes);
+}
+
+/* The transfer is cut after the first checkpoint, the accessory loses the power
+ * and the controller offers the same SuperBinary again after the reset. The
+ * accessory resumes the transfer from the checkpoint, including the hash state,
+ * and writes the rest of the image after the checkpoint offset.
+ */
+ZTEST(suite_fmna_uarp_throughput, test_transfer_resume)
+{
+#if CONFIG_FMNA_UARP_RESUME && !CONFIG_FMNA_UARP_COMPRESSION
+	int err;
+	struct bench_result result;
+	const struct bench_link link = {
+		.mtu = 247,
+		.packet_time_us = 0,
+	};
+
+	BUILD_ASSERT(PAYLOAD_SIZE > CONFIG_FMNA_UARP_RESUME_CHECKPOINT_INTERVAL,
+		     "No checkpoint in the payload");
+
+	bench_controller_cut_set(PAYLOAD_OFFSET +
+				 (CONFIG_FMNA_UARP_RESUME_CHECKPOINT_INTERVAL + PAYLOAD_SIZE) / 2);
+	err = bench_controller_run(&link, super_binary, super_binary_len, &result);
+	zassert_equal(err, -ECANCELED, "Update session not cut, err %d", err);
+
+	bench_power_cut();
+	err = bench_controller_rescind();
+	bench_transport_disconnect();
+	bench_transport_reset();
+	bench_power_restore();
+	zassert_ok(err, "bench_controller_rescind failed, err %d", err);
+
+	bench_controller_cut_set(0);
+	err = bench_controller_run(&link, super_binary, super_binary_len, &result);
+	bench_transport_disconnect();
+
+	zassert_ok(err, "Update session failed, err %d", err);
+	zassert_equal(result.processing_flags, kUARPAssetProcessingFlagsUploadComplete,
+		      "Upload not completed, flags 0x%04x", result.processing_flags);
+	zassert_true(result.data_bytes <=
+		     super_binary_len - CONFIG_FMNA_UARP_RESUME_CHECKPOINT_INTERVAL,
+		     "Transfer not resumed, %u bytes sent", result.data_bytes);
+
+	image_verify();
+#else
+	ztest_test_skip();
+#endif
+}
+
+/* No link delay: the accessory processing and the flash writes bound the throughput. */
+ZTEST(suite_fmna_uarp_throughput, test_link_unlimited)
+{
+	throughput_measure(247, 0);
+}
+
+/* Default ATT MTU at the 7.5 ms connection interval. */
+ZTEST(suite_fmna_uarp_throughput, test_link_mtu_23)
+{
+	throughput_measure(23, 7500);
+}
+
+/* ATT MTU commonly negotiated by iOS at the 15 ms connection interval. */
+ZTEST(suite_fmna_uarp_throughput, test_link_mtu_185)
+{
+	throughput_measure(185, 15000);
+}
+
+/* Data length extension at the 7.5 ms connection interval. */
+ZTEST(suite_fmna_uarp_throughput, test_link_mtu_247)
+{
+	throughput_measure(247, 7500);
+}
+
+ZTEST_SUITE(suite_fmna_uarp_throughput, NULL, suite_setup, NULL, NULL, suite_teardown);
@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-4-Clause
+ */
+
+#include <string.h>
+
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/util.h>
+
+#include <ocrypto_sha256.h>
+
+/* Straightforward FIPS 180-4 SHA-256, comparable in cost to the software
+ * implementation used on the target.
+ */
+
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static const uint32_t k[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4,
+	0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe,
+	0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f,
+	0x4a7484aa, 0x5cb0a9dc, 0x76f988da, 0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc,
+	0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+	0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070, 0x19a4c116,
+	0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7,
+	0xc67178f2,
+};
+
+static void block_process(uint32_t h[8], const uint8_t *block)
+{
+	uint32_t w[64];
+	uint32_t a, b, c, d, e, f, g, hh, t1, t2;
+
+	for (int i = 0; i < 16; i++) {
+		w[i] = sys_get_be32(&block[i * 4]);
+	}
+
+	for (int i = 16; i < 64; i++) {
+		uint32_t s0 = ROTR(w[i - 15], 7) ^ ROTR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+		uint32_t s1 = ROTR(w[i - 2], 17) ^ ROTR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+
+		w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+	}
+
+	a = h[0];
+	b = h[1];
+	c = h[2];
+	d = h[3];
+	e = h[4];
+	f = h[5];
+	g = h[6];
+	hh = h[7];
+
+	for (int i = 0; i < 64; i++) {
+		t1 = hh + (ROTR(e, 6) ^ ROTR(e, 11) ^ ROTR(e, 25)) + ((e & f) ^ (~e & g)) + k[i] + w[i];
+		t2 = (ROTR(a, 2) ^ ROTR(a, 13) ^ ROTR(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+		hh = g;
+		g = f;
+		f = e;
+		e = d + t1;
+		d = c;
+		c = b;
+		b = a;
+		a = t1 + t2;
+	}
+
+	h[0] += a;
+	h[1] += b;
+	h[2] += c;
+	h[3] += d;
+	h[4] += e;
+	h[5] += f;
+	h[6] += g;
+	h[7] += hh;
+}
+
+void ocrypto_sha256_init(ocrypto_sha256_ctx *ctx)
+{
+	static const uint32_t h0[8] = {
+		0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+		0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+	};
+
+	memcpy(ctx->h, h0, sizeof(ctx->h));
+	ctx->length = 0;
+	ctx->total = 0;
+}
+
+void ocrypto_sha256_update(ocrypto_sha256_ctx *ctx, const uint8_t *in, size_t in_len)
+{
+	size_t len;
+
+	ctx->total += in_len;
+
+	while (in_len > 0) {
+		if ((ctx->length == 0) && (in_len >= sizeof(ctx->buffer))) {
+			block_process(ctx->h, in);
+			len = sizeof(ctx->buffer);
+		} else {
+			len = MIN(in_len, sizeof(ctx->buffer) - ctx->length);
+			memcpy(&ctx->buffer[ctx->length], in, len);
+			ctx->length += len;
+
+			if (ctx->length == sizeof(ctx->buffer)) {
+				block_process(ctx->h, ctx->buffer);
+				ctx->length = 0;
+			}
+		}
+
+		in += len;
+		in_len -= len;
+	}
+}
+
+void ocrypto_sha256_final(ocrypto_sha256_ctx *ctx, uint8_t r[ocrypto_sha256_BYTES])
+{
+	uint64_t bits = ctx->total * 8;
+
+	ctx->buffer[ctx->length++] = 0x80;
+
+	if (ctx->length > (sizeof(ctx->buffer) - sizeof(bits))) {
+		memset(&ctx->buffer[ctx->length], 0, sizeof(ctx->buffer) - ctx->length);
+		block_process(ctx->h, ctx->buffer);
+		ctx->length = 0;
+	}
+
+	memset(&ctx->buffer[ctx->length], 0, sizeof(ctx->buffer) - sizeof(bits) - ctx->length);
+	sys_put_be64(bits, &ctx->buffer[sizeof(ctx->buffer) - sizeof(bits)]);
+	block_process(ctx->h, ctx->buffer);
+
+	for (int i = 0; i < 8; i++) {
+		sys_put_be32(ctx->h[i], &r[i * 4]);
+	}
+}
+
+void ocrypto_sha256(uint8_t r[ocrypto_sha256_BYTES], const uint8_t *in, size_t in_len)
+{
+	ocrypto_sha256_ctx ctx;
+
+	ocrypto_sha256_init(&ctx);
+	ocrypto_sha256_update(&ctx, in, in_len);
+	ocrypto_sha256_final(&ctx, r);
+}
@@ -0,0 +1,265 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-4-Clause
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/net_buf.h>
+
+#include "CoreUARPProtocolDefines.h"
+
+#include "fmna_uarp.h"
+#include "fmna_uarp_pool.h"
+
+#include "bench.h"
+
+/* Replacement of the UARP GATT service. The events are dispatched to the UARP
+ * context in the same way, but the messages are exchanged with the simulated
+ * controller as a whole instead of the GATT packet chunks.
+ */
+
+#define MAX_RX_MESSAGE_SIZE (sizeof(union UARPMessages) + CONFIG_FMNA_UARP_RX_MSG_PAYLOAD_SIZE)
+#define ATT_WRITE_HEADER_LEN 3
+#define GATT_PKT_HEADER_LEN 1
+#define EVENT_BLOCK_SIZE (offsetof(struct event, write_data.buf) + MAX_RX_MESSAGE_SIZE)
+
+enum event_id {
+	EVENT_DISCONNECT,
+	EVENT_SEND_COMPLETE,
+	EVENT_WRITE,
+	EVENT_PROCESS,
+};
+
+struct event {
+	void *fifo_reserved;
+	enum event_id id;
+	struct {
+		uint16_t len;
+		uint8_t buf[];
+	} write_data;
+};
+
+FMNA_UARP_POOL_DEFINE(event_pool, EVENT_BLOCK_SIZE, CONFIG_FMNA_UARP_RX_EVENT_COUNT);
+
+static K_FIFO_DEFINE(event_fifo);
+static K_SEM_DEFINE(disconnect_sem, 0, 1);
+static bool initialized;
+static bool connected;
+static uint16_t link_mtu;
+
+static struct event process_event = {
+	.id = EVENT_PROCESS,
+};
+static atomic_t process_event_pending;
+
+/* Messages queued by the UARP module. The simulated link carries one message at a
+ * time, so the next message is delivered to the controller on the send completion.
+ */
+static struct {
+	struct net_buf_simple *bufs[CONFIG_FMNA_UARP_TX_QUEUE_SIZE];
+	uint8_t head;
+	uint8_t count;
+} tx_queue;
+
+static void event_submit(struct event *event);
+
+static uint32_t send_message(struct net_buf_simple *buf)
+{
+	if (tx_queue.count == ARRAY_SIZE(tx_queue.bufs)) {
+		return kUARPStatusNoResources;
+	}
+
+	tx_queue.bufs[(tx_queue.head + tx_queue.count) % ARRAY_SIZE(tx_queue.bufs)] = buf;
+	tx_queue.count++;
+
+	if (tx_queue.count == 1) {
+		bench_controller_message_received(buf->data, buf->len);
+	}
+
+	return kUARPStatusSuccess;
+}
+
+static void handle_send_complete(void)
+{
+	struct net_buf_simple *next;
+
+	if (tx_queue.count == 0) {
+		return;
+	}
+
+	tx_queue.head = (tx_queue.head + 1) % ARRAY_SIZE(tx_queue.bufs);
+	tx_queue.count--;
+
+	/* Deliver the next message before the completion, which may queue a new one. */
+	if (tx_queue.count > 0) {
+		next = tx_queue.bufs[tx_queue.head];
+		bench_controller_message_received(next->data, next->len);
+	}
+
+	fmna_uarp_send_message_complete();
+}
+
+static void process_request(void)
+{
+	if (!atomic_cas(&process_event_pending, 0, 1)) {
+		return;
+	}
+
+	event_submit(&process_event);
+}
+
+static void handle_write(uint8_t *buf, uint16_t len)
+{
+	struct net_buf_simple rx_buf;
+
+	if (!initialized) {
+		initialized = fmna_uarp_init(send_message, process_request);
+		__ASSERT_NO_MSG(initialized);
+	}
+
+	if (!connected) {
+		connected = true;
+		fmna_uarp_controller_add(link_mtu - ATT_WRITE_HEADER_LEN - GATT_PKT_HEADER_LEN);
+	}
+
+	net_buf_simple_init_with_data(&rx_buf, buf, len);
+	fmna_uarp_recv_message(&rx_buf);
+}
+
+static void handle_disconnect(void)
+{
+	if (connected) {
+		memset(&tx_queue, 0, sizeof(tx_queue));
+		fmna_uarp_controller_remove();
+		connected = false;
+	}
+
+	k_sem_give(&disconnect_sem);
+}
+
+static void handle_event(struct event *event)
+{
+	if (event->id == EVENT_PROCESS) {
+		atomic_clear(&process_event_pending);
+		fmna_uarp_process();
+		return;
+	}
+
+	if (event->id == EVENT_DISCONNECT) {
+		handle_disconnect();
+	} else if (event->id == EVENT_SEND_COMPLETE) {
+		handle_send_complete();
+	} else {
+		handle_write(event->write_data.buf, event->write_data.len);
+	}
+	fmna_uarp_pool_free(&event_pool, event);
+}
+
+#ifdef CONFIG_FMNA_UARP_DEDICATED_THREAD
+static void uarp_thread_entry_point(void *arg0, void *arg1, void *arg2)
+{
+	while (true) {
+		handle_event(k_fifo_get(&event_fifo, K_FOREVER));
+	}
+}
+
+K_THREAD_DEFINE(bench_uarp_thread, CONFIG_FMNA_UARP_THREAD_STACK_SIZE,
+		uarp_thread_entry_point, NULL, NULL, NULL,
+		CONFIG_FMNA_UARP_THREAD_PRIORITY < CONFIG_NUM_PREEMPT_PRIORITIES ?
+			CONFIG_FMNA_UARP_THREAD_PRIORITY : CONFIG_NUM_PREEMPT_PRIORITIES - 1,
+		0, 0);
+#else
+static void event_handler(struct k_work *work)
+{
+	struct event *event;
+
+	while (true) {
+		event = k_fifo_get(&event_fifo, K_NO_WAIT);
+		if (event == NULL) {
+			return;
+		}
+		handle_event(event);
+	}
+}
+
+static K_WORK_DEFINE(event_work, event_handler);
+#endif /* CONFIG_FMNA_UARP_DEDICATED_THREAD */
+
+static void event_submit(struct event *event)
+{
+	k_fifo_put(&event_fifo, event);
+
+#ifndef CONFIG_FMNA_UARP_DEDICATED_THREAD
+	k_work_submit(&event_work);
+#endif
+}
+
+static struct event *event_alloc(enum event_id id, size_t size)
+{
+	struct event *event;
+
+	event = fmna_uarp_pool_alloc(&event_pool, size);
+	if (event) {
+		event->id = id;
+	}
+
+	return event;
+}
+
+void bench_transport_connect(uint16_t mtu)
+{
+	link_mtu = mtu;
+}
+
+int bench_transport_write(const uint8_t *data, uint16_t len)
+{
+	struct event *event;
+
+	if (len > MAX_RX_MESSAGE_SIZE) {
+		return -EMSGSIZE;
+	}
+
+	event = event_alloc(EVENT_WRITE, offsetof(struct event, write_data.buf) + len);
+	if (!event) {
+		return -ENOMEM;
+	}
+
+	event->write_data.len = len;
+	memcpy(event->write_data.buf, data, len);
+	event_submit(event);
+
+	return 0;
+}
+
+int bench_transport_send_complete(void)
+{
+	struct event *event;
+
+	event = event_alloc(EVENT_SEND_COMPLETE, sizeof(*event));
+	if (!event) {
+		return -ENOMEM;
+	}
+
+	event_submit(event);
+
+	return 0;
+}
+
+void bench_transport_disconnect(void)
+{
+	struct event *event;
+
+	event = event_alloc(EVENT_DISCONNECT, sizeof(*event));
+	__ASSERT_NO_MSG(event);
+
+	event_submit(event);
+	k_sem_take(&disconnect_sem, K_FOREVER);
+}
+
+void bench_transport_reset(void)
+{
+	__ASSERT_NO_MSG(!connected);
+
+	initialized = false;
+}
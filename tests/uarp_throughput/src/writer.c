@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2024 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-4-Clause
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/storage/flash_map.h>
+
+#include "fmna_uarp_payload.h"
+#include "fmna_uarp_writer.h"
+#include "fmna_uarp_writer_util_nvm.h"
+
+#include "bench.h"
+
+/* Payload writer that stores the image in the flash simulator partition in
+ * the same way as the MCUboot writer stores it in the secondary slot.
+ */
+
+static struct fmna_uarp_writer_util_nvm_ctx nvm_util_ctx;
+static uint8_t buf[512] __aligned(4);
+
+static int transfer_start(void *ctx, size_t payload_size)
+{
+	return fmna_uarp_writer_util_nvm_start(&nvm_util_ctx, BENCH_WRITE_FA_ID, buf,
+					       ARRAY_SIZE(buf), payload_size);
+}
+
+static int transfer_resume(void *ctx, size_t payload_size, size_t offset)
+{
+	return fmna_uarp_writer_util_nvm_resume(&nvm_util_ctx, BENCH_WRITE_FA_ID, buf,
+						ARRAY_SIZE(buf), payload_size, offset);
+}
+
+static int transfer_write(void *ctx, const uint8_t *chunk, size_t chunk_size)
+{
+	return fmna_uarp_writer_util_nvm_write(&nvm_util_ctx, chunk, chunk_size);
+}
+
+static int transfer_finish(void *ctx, bool success)
+{
+	if (bench_power_is_lost()) {
+		/* The accessory is switched off, so the partially written image stays
+		 * in the flash. The successful finish does not invalidate it.
+		 */
+		success = true;
+	}
+
+	return fmna_uarp_writer_util_nvm_finish(&nvm_util_ctx, success);
+}
+
+static int image_confirm(void *ctx)
+{
+	return 0;
+}
+
+static bool payload_accept(const struct fmna_uarp_payload_header *curr_header)
+{
+	return true;
+}
+
+FMNA_UARP_WRITER_API_DEF(bench_writer_api,
+			 transfer_start,
+			 transfer_write,
+			 transfer_finish,
+			 image_confirm,
+			 transfer_resume);
+FMNA_UARP_WRITER_DEF(bench_writer, bench_writer_api, NULL);
+
+static const struct fmna_uarp_payload_cb bench_payload_cbs = {
+	.accept = payload_accept,
+};
+
+FMNA_UARP_PAYLOAD_REGISTER(bench_payload, BENCH_PAYLOAD_TAG, &bench_writer, &bench_payload_cbs);
@@ -15,11 +15,18 @@ import hashlib
 import xml.etree.ElementTree as ET
 import shutil
 import struct
+from . import heatshrink
+from . import delta
 
 info_file = io.StringIO()
 
 output_superbinary_plist = ''
 payloads_dir = ''
+generated_dir = ''
+delta_sources = {}
+delta_used = set()
+
+COMPRESSION_ALGORITHM_HEATSHRINK = 1
 
 class NS:
     pass
@@ -107,7 +114,7 @@ def compose_superbinary():
         'superbinary', 'compose',
         f'metaDataFilepath={cmd_path(args.metadata)}',
         f'plistFilepath={cmd_path(output_superbinary_plist)}',
-        f'payloadsFilepath={cmd_path(payloads_dir or ".")}',
+        f'payloadsFilepath={cmd_path(generated_dir or payloads_dir or ".")}',
         f'superBinaryFilepath={cmd_path(args.out_uarp)}']
     hash_args = [
         mfigr2,
@@ -215,6 +222,8 @@ def update_payload(payload):
     info.version_item = None
     info.metadata_item = None
     info.hash_item = None
+    info.compression_key = None
+    info.compression_item = None
     info.apply_flags = '[default]'
     # Parse XML and fill up the payload info
     for i in range(0, len(payload), 2):
@@ -245,6 +254,10 @@ def update_payload(payload):
                 if metadata_key == 'sha-2':
                     xml_assert(metadata_value.tag == 'data', 'Expecting string in "SHA-2"')
                     info.hash_item = metadata_value
+                if metadata_key == 'compression':
+                    xml_assert(metadata_value.tag == 'data', 'Expecting data in "Compression"')
+                    info.compression_key = value[j]
+                    info.compression_item = metadata_value
                 if metadata_key == 'apply flags':
                     try:
                         names = {
@@ -284,6 +297,16 @@ def update_payload(payload):
     if file_ver != info.version_item.text and not args.skip_version_checks:
         raise Exception(f'Version "{file_ver}" contained in the MCUBoot image "{info.file}" ' +
                         f'does not match version in the plist file "{info.version_item.text}".')
+    # Create the patch and compress it, the hash is calculated over the final content
+    file_size = len(payload_content)
+    patch = delta_payload(info, payload_content)
+    if patch is not None:
+        payload_content = patch
+    patch_size = len(payload_content)
+    compression = compress_payload(info, payload_content)
+    if compression is not None:
+        payload_content = compression
+    store_generated_payload(info, payload_content)
     # Calculate hash
     sha256 = hashlib.sha256(payload_content)
     sha256_bin = sha256.digest()
@@ -297,11 +320,68 @@ def update_payload(payload):
     iprint(f'        name:        {info.name}')
     iprint(f'        file:        {payload_file}')
     iprint(f'        size:        {kb(len(payload_content))}')
+    if patch is not None:
+        iprint(f'        delta:       {kb(file_size)} -> {kb(patch_size)} ' +
+               f'against {delta_sources[info.fourcc]}')
+    if compression is not None:
+        iprint(f'        compressed:  {kb(patch_size)} -> {kb(len(payload_content))} ' +
+               f'({round(100 * len(payload_content) / patch_size)}%)')
     iprint(f'        SHA-256:     {sha256_hex}')
     iprint(f'        apply flags: {info.apply_flags}')
     return file_ver
 
 
+def delta_payload(info, payload_content):
+    global delta_sources, delta_used
+    if info.fourcc not in delta_sources:
+        return None
+    source_file = delta_sources[info.fourcc]
+    delta_used.add(info.fourcc)
+    source_content = file_io(source_file, 'rb')
+    patch = delta.create(source_content, payload_content)
+    if delta.apply(source_content, patch) != payload_content:
+        raise Exception(f'Patch verification of "{info.file}" failed.')
+    return patch
+
+
+def compress_payload(info, payload_content):
+    global args
+    if not args.compress:
+        # Drop the compression parameters left from the previous run
+        if info.compression_item is not None:
+            info.metadata_item.remove(info.compression_key)
+            info.metadata_item.remove(info.compression_item)
+        return None
+    window_sz2 = args.compress_window
+    lookahead_sz2 = args.compress_lookahead
+    compressed = heatshrink.compress(payload_content, window_sz2, lookahead_sz2)
+    if heatshrink.decompress(compressed, window_sz2, lookahead_sz2) != payload_content:
+        raise Exception(f'Compression verification of "{info.file}" failed.')
+    # Add compression parameters to the XML
+    if info.compression_item is None:
+        ET.SubElement(info.metadata_item, 'key').text = 'Compression'
+        info.compression_item = ET.SubElement(info.metadata_item, 'data')
+    params = struct.pack('>BBBBL', COMPRESSION_ALGORITHM_HEATSHRINK, window_sz2, lookahead_sz2,
+                         0, len(payload_content))
+    info.compression_item.text = base64.b64encode(params).decode("utf-8")
+    return compressed
+
+
+def store_generated_payload(info, payload_content):
+    global generated_dir, args
+    if not args.compress and not delta_sources:
+        return
+    # Write all payload files under the same names to a separate directory
+    if args.out_plist is not None:
+        plist_dir = os.path.dirname(args.out_plist)
+    else:
+        plist_dir = os.path.dirname(args.input)
+    generated_dir = os.path.join(plist_dir, 'generated')
+    generated_file = os.path.join(generated_dir, info.file)
+    os.makedirs(os.path.dirname(generated_file), exist_ok=True)
+    file_io(generated_file, 'wb', payload_content)
+
+
 def update_superbinary():
     global output_superbinary_plist, args
     # Read input
@@ -407,6 +487,32 @@ def cli_protected(cmd, argv):
                         help='Custom path to "mfigr2" tool. By default, "mfigr2" from PATH '
                              'environment variable will be used. Setting it to "skip" will '
                              'only show the commands without executing them.')
+    parser.add_argument('--compress', action='store_true',
+                        help='Compress the payloads with the heatshrink algorithm. The compressed '
+                             'payload files are stored in the "generated" directory next to the '
+                             'output plist file and used to compose the SuperBinary. The metadata '
+                             'plist file must define the "Compression" TLV type. The firmware must '
+                             'be built with the CONFIG_FMNA_UARP_COMPRESSION Kconfig option.')
+    parser.add_argument('--compress-window', metavar='bits', type=int, default=11,
+                        choices=range(4, 15),
+                        help='Base-2 logarithm of the compression window size. It must not exceed '
+                             'the CONFIG_FMNA_UARP_COMPRESSION_WINDOW_SZ2_MAX Kconfig option. '
+                             'Default: 11.')
+    parser.add_argument('--compress-lookahead', metavar='bits', type=int, default=4,
+                        choices=range(3, 14),
+                        help='Base-2 logarithm of the maximum back-reference length. It must be '
+                             'lower than the window size. Default: 4.')
+    parser.add_argument('--delta-source', metavar='4CC:file', type=str, action='append',
+                        default=[],
+                        help='Replace the payload with the given 4CC tag by a patch against the '
+                             'given MCUBoot image of the previous build. The device reconstructs '
+                             'the new image from its running image and the patch. The payload '
+                             'files are stored in the "generated" directory next to the output '
+                             'plist file and used to compose the SuperBinary. Use it together '
+                             'with the "--compress" argument and a "--compress-lookahead" value '
+                             'of 8 to reduce the patch size. The firmware must be built with the '
+                             'CONFIG_FMNA_UARP_PAYLOAD_MCUBOOT_APP_DELTA Kconfig option. Can be '
+                             'provided multiple times.')
     parser.add_argument('--skip-version-checks', action='store_true',
                         help='Does not check if plist versions matches MCUBoot images versions.')
     parser.add_argument('--debug', action='store_true',
@@ -416,11 +522,25 @@ def cli_protected(cmd, argv):
 
     args = parser.parse_args(argv)
 
+    if args.compress and args.compress_lookahead >= args.compress_window:
+        raise Exception('--compress-lookahead must be lower than --compress-window')
+
+    delta_sources.clear()
+    delta_used.clear()
+    for item in args.delta_source:
+        fourcc, sep, source_file = item.partition(':')
+        if not sep or len(fourcc) != 4 or not source_file:
+            raise Exception(f'Invalid --delta-source value "{item}", expecting "4CC:file"')
+        delta_sources[fourcc] = source_file
+
     nothing_done = True
 
     if args.input is not None:
         update_superbinary()
         nothing_done = False
+        for fourcc in delta_sources:
+            if fourcc not in delta_used:
+                raise Exception(f'Cannot find payload "{fourcc}" provided in --delta-source')
 
     if args.metadata is not None:
         create_metadata()
@@ -0,0 +1,140 @@
+#
+# Copyright (c) 2024 Nordic Semiconductor
+#
+# SPDX-License-Identifier: LicenseRef-Nordic-4-Clause
+#
+
+'''Patch generator for the delta UARP payloads.
+
+The patch format is described in the src/uarp/writer/delta/fmna_uarp_writer_delta.c file.
+'''
+
+import struct
+import zlib
+
+PATCH_MAGIC = b'FMDP'
+PATCH_VERSION = 1
+
+# Length of the blocks used to find the matching source regions.
+BLOCK_LEN = 8
+# Minimum length of an exact match that starts a diff region.
+MIN_MATCH = 16
+# Maximum number of the candidate positions checked for each block.
+MATCH_CHAIN_LIMIT = 16
+
+
+def _index(source):
+    index = {}
+    for i in range(0, len(source) - BLOCK_LEN + 1):
+        chain = index.setdefault(source[i:i + BLOCK_LEN], [])
+        if len(chain) < MATCH_CHAIN_LIMIT:
+            chain.append(i)
+    return index
+
+
+def _exact_len(source, s, target, t):
+    length = 0
+    max_len = min(len(source) - s, len(target) - t)
+    while length < max_len and source[s + length] == target[t + length]:
+        length += 1
+    return length
+
+
+def _approx_len(source, s, target, t):
+    '''Extends the match as long as more than half of the bytes are equal.
+
+    The mismatching bytes are encoded as non-zero diff bytes, which is cheaper
+    than starting a new entry for small changes like relocated addresses.
+    '''
+    max_len = min(len(source) - s, len(target) - t)
+    matched = 0
+    best_score = 0
+    best_len = 0
+    for i in range(max_len):
+        if source[s + i] == target[t + i]:
+            matched += 1
+            score = 2 * matched - (i + 1)
+            if score > best_score:
+                best_score = score
+                best_len = i + 1
+        elif 2 * matched - (i + 1) < best_score - 2 * MIN_MATCH:
+            break
+    return best_len
+
+
+def _matches(source, target):
+    '''Returns the list of (target offset, source offset, length) tuples.'''
+    index = _index(source)
+    matches = []
+    t = 0
+    while t + BLOCK_LEN <= len(target):
+        candidates = index.get(target[t:t + BLOCK_LEN], [])
+        # Prefer continuing with the alignment of the previous match
+        if matches:
+            prev_t, prev_s, _ = matches[-1]
+            candidates = [prev_s + t - prev_t] + candidates
+        best_len = 0
+        best_src = 0
+        for s in candidates:
+            length = _exact_len(source, s, target, t) if s < len(source) else 0
+            if length > best_len:
+                best_len = length
+                best_src = s
+        if best_len < MIN_MATCH:
+            t += 1
+            continue
+        length = max(best_len, _approx_len(source, best_src, target, t))
+        matches.append((t, best_src, length))
+        t += length
+    return matches
+
+
+def create(source, target):
+    '''Creates a patch that reconstructs the target image from the source image.'''
+    out = bytearray()
+    out += PATCH_MAGIC
+    out += struct.pack('>B3xLLL', PATCH_VERSION, len(source),
+                       zlib.crc32(source) & 0xFFFFFFFF, len(target))
+    matches = _matches(source, target)
+    # The first entry contains only the target data before the first match
+    entries = [(0, 0, 0)] if not matches or matches[0][0] > 0 else []
+    entries += matches
+    for i, (t, s, length) in enumerate(entries):
+        if i + 1 < len(entries):
+            next_t, next_s, _ = entries[i + 1]
+        else:
+            next_t, next_s = len(target), s + length
+        extra = target[t + length:next_t]
+        seek = next_s - (s + length)
+        out += struct.pack('>LLl', length, len(extra), seek)
+        out += bytes((target[t + j] - source[s + j]) & 0xFF for j in range(length))
+        out += extra
+    return bytes(out)
+
+
+def apply(source, patch):
+    '''Applies the patch to the source image. Used to verify the generator output.'''
+    if patch[0:4] != PATCH_MAGIC:
+        raise Exception('Invalid patch magic')
+    version, source_size, source_crc, target_size = struct.unpack_from('>B3xLLL', patch, 4)
+    if version != PATCH_VERSION:
+        raise Exception(f'Unsupported patch version {version}')
+    if source_size != len(source) or source_crc != zlib.crc32(source) & 0xFFFFFFFF:
+        raise Exception('Source image does not match the patch')
+    target = bytearray()
+    pos = 20
+    s = 0
+    while pos < len(patch):
+        diff_len, extra_len, seek = struct.unpack_from('>LLl', patch, pos)
+        pos += 12
+        for j in range(diff_len):
+            target.append((source[s + j] + patch[pos + j]) & 0xFF)
+        pos += diff_len
+        target += patch[pos:pos + extra_len]
+        pos += extra_len
+        s += diff_len + seek
+        if s < 0 or s > len(source):
+            raise Exception('Patch entry seeks outside the source image')
+    if len(target) != target_size:
+        raise Exception('Invalid target image size')
+    return bytes(target)
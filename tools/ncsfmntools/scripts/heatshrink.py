@@ -0,0 +1,129 @@
+#
+# Copyright (c) 2024 Nordic Semiconductor
+#
+# SPDX-License-Identifier: LicenseRef-Nordic-4-Clause
+#
+
+'''Heatshrink compatible LZSS encoder used for the compressed UARP payloads.'''
+
+# Maximum number of the candidate positions checked for each match.
+MATCH_CHAIN_LIMIT = 32
+
+
+class BitWriter:
+    def __init__(self):
+        self.out = bytearray()
+        self.bits = 0
+        self.count = 0
+
+    def put(self, value, count):
+        self.bits = (self.bits << count) | (value & ((1 << count) - 1))
+        self.count += count
+        while self.count >= 8:
+            self.count -= 8
+            self.out.append((self.bits >> self.count) & 0xFF)
+        self.bits &= (1 << self.count) - 1
+
+    def finish(self):
+        '''Pads the last byte with zeros.'''
+        if self.count > 0:
+            self.out.append((self.bits << (8 - self.count)) & 0xFF)
+            self.bits = 0
+            self.count = 0
+        return bytes(self.out)
+
+
+def compress(data, window_sz2, lookahead_sz2):
+    '''Compresses data to the heatshrink bit stream.
+
+    A literal is encoded as a tag bit of 1 followed by the byte. A back-reference
+    is encoded as a tag bit of 0 followed by the distance minus one on window_sz2
+    bits and the length minus one on lookahead_sz2 bits.
+    '''
+    window = 1 << window_sz2
+    lookahead = 1 << lookahead_sz2
+    # A back-reference must be shorter than the literals it replaces.
+    min_match = (1 + window_sz2 + lookahead_sz2) // 9 + 1
+    key_len = max(min_match, 2)
+
+    writer = BitWriter()
+    chains = {}
+    pos = 0
+
+    def index(start, end):
+        for i in range(start, min(end, len(data) - key_len + 1)):
+            chains.setdefault(data[i:i + key_len], []).append(i)
+
+    while pos < len(data):
+        best_len = 0
+        best_dist = 0
+        max_len = min(lookahead, len(data) - pos)
+        if max_len >= key_len:
+            candidates = chains.get(data[pos:pos + key_len], [])
+            for cand in reversed(candidates[-MATCH_CHAIN_LIMIT:]):
+                dist = pos - cand
+                if dist > window:
+                    break
+                if best_len and data[cand + best_len] != data[pos + best_len]:
+                    continue
+                length = key_len
+                while length < max_len and data[cand + length] == data[pos + length]:
+                    length += 1
+                if length > best_len:
+                    best_len = length
+                    best_dist = dist
+                    if length == max_len:
+                        break
+        if best_len >= min_match:
+            writer.put(0, 1)
+            writer.put(best_dist - 1, window_sz2)
+            writer.put(best_len - 1, lookahead_sz2)
+            index(pos, pos + best_len)
+            pos += best_len
+        else:
+            writer.put(1, 1)
+            writer.put(data[pos], 8)
+            index(pos, pos + 1)
+            pos += 1
+
+    return writer.finish()
+
+
+def decompress(data, window_sz2, lookahead_sz2):
+    '''Decompresses the heatshrink bit stream. Used to verify the encoder output.'''
+    out = bytearray()
+    bits = 0
+    count = 0
+    pos = 0
+
+    def get(n):
+        nonlocal bits, count, pos
+        while count < n:
+            if pos >= len(data):
+                return None
+            bits = (bits << 8) | data[pos]
+            count += 8
+            pos += 1
+        count -= n
+        value = (bits >> count) & ((1 << n) - 1)
+        bits &= (1 << count) - 1
+        return value
+
+    while True:
+        tag = get(1)
+        if tag is None:
+            break
+        if tag:
+            value = get(8)
+            if value is None:
+                break
+            out.append(value)
+        else:
+            dist = get(window_sz2)
+            length = get(lookahead_sz2) if dist is not None else None
+            if length is None:
+                break
+            for _ in range(length + 1):
+                out.append(out[-(dist + 1)])
+
+    return bytes(out)